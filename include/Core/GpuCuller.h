@@ -0,0 +1,129 @@
+#pragma once
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include "Utils/config.h"
+#include "Utils/LinearArena.h"
+#include "Utils/SlotMap.h"
+
+//Forward declarations
+class Devices;
+class BufferManager;
+class MeshManager;
+class ShaderLoader;
+class Material;
+struct DrawItem;
+struct DrawStats;
+
+//Range of command slots sharing a pipeline key(and a material without bindless) -> one indirect draw call
+struct CullBatch {
+	uint32_t first = 0; // first command slot
+	uint32_t count = 0; // slots reserved, the visible count may be lower
+	uint32_t index = 0; // counter slot in the counts buffer
+	const Material* material = nullptr;
+	uint32_t pipelineKey = 0; // packed PipelineKey
+	VkPipeline pipeline = VK_NULL_HANDLE; // resolved by the caller before `recordDraws()`
+};
+
+/**
+	* @class GpuCuller
+	* @brief Frustum culls the frame's draw list in a compute shader that writes the indexed indirect commands.
+	*
+	* The CPU only uploads one candidate per primitive(bounding sphere, geometry range, mesh index), the
+	* dispatch transforms each sphere by its model matrix, tests it against the camera frustum and writes
+	* the command + draw data the indirect pipeline consumes.
+	*
+	* With VK_KHR_draw_indirect_count visible draws are packed per batch and counted with atomics, the
+	* draw count then comes from the GPU as well. Without it(ex. lavapipe) every candidate keeps its slot and
+	* culled ones get instanceCount = 0 -> same draw calls, the culled draws just produce no work.
+*/
+class GpuCuller {
+public:
+	GpuCuller(std::shared_ptr<Devices> devices);
+
+	//False if the compute shader is missing or the pipeline could not be created -> culling stays unavailable
+	bool create(VkDescriptorSetLayout uniformSetLayout, ShaderLoader& shaderLoader, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+
+	//Outside a render pass -> uploads the candidates and dispatches the cull, the batches index into this frame's commands
+	ArenaVector<CullBatch> recordCulling(
+		VkCommandBuffer commandBuffer,
+		uint32_t frameIndex,
+		uint64_t frameNumber,
+		const ArenaVector<DrawItem>& drawList,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		VkDescriptorSet uniformSet,
+		uint32_t uniformOffset,
+		LinearArena& arena,
+		bool bindless
+	);
+
+	//Inside the render pass, with the geometry buffers bound -> binds each batch's pipeline
+	void recordDraws(
+		VkCommandBuffer commandBuffer,
+		const ArenaVector<CullBatch>& batches,
+		VkPipelineLayout graphicsLayout,
+		bool bindless,
+		uint32_t frameIndex,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		DrawStats& stats
+	);
+
+	bool usesDrawCount() const { return drawIndirectCountFunc != nullptr; };
+
+	//Bumped whenever a cull set is rewritten -> command buffers recorded before it bound a stale set
+	uint64_t getDescriptorVersion() const { return descriptorVersion; };
+
+	//Buffers are owned by the buffer manager and go away with it
+	void cleanup();
+
+private:
+	//Mirrors `Candidate` in cull.comp
+	struct CullCandidate {
+		glm::vec4 sphere;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t meshIndex;
+		uint32_t textureSlot;
+		uint32_t batchIndex;
+		uint32_t batchBase;
+		uint32_t pad;
+	};
+
+	struct CullPushConstants {
+		uint32_t candidateCount;
+		uint32_t compact;
+	};
+
+	struct FrameBuffers {
+		BufferHandle candidates{};
+		BufferHandle commands{};
+		BufferHandle drawData{};
+		BufferHandle counts{};
+		uint32_t capacity = 0; // draws
+		uint32_t countCapacity = 0; // batches
+	};
+
+	void ensureCapacity(const std::shared_ptr<BufferManager>& bufferManager, uint32_t frameIndex, uint32_t drawCount, uint32_t batchCount);
+	void writeDescriptors(const std::shared_ptr<BufferManager>& bufferManager, const std::shared_ptr<MeshManager>& meshManager, uint32_t frameIndex);
+
+	static constexpr uint32_t CULL_BINDING_COUNT = 5; // candidates, model matrices, commands, draw data, counts
+
+	std::shared_ptr<Devices> culler_devices;
+
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> cullSets{};
+	//Buffers each set points at -> only written again when one of them changed
+	std::array<std::array<VkBuffer, CULL_BINDING_COUNT>, MAX_FRAMES_IN_FLIGHT> writtenBuffers{};
+	uint64_t descriptorVersion = 0;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	PFN_vkCmdDrawIndexedIndirectCount drawIndirectCountFunc = nullptr; // core or KHR entry point
+
+	std::array<FrameBuffers, MAX_FRAMES_IN_FLIGHT> frameBuffers;
+};
+
+#endif
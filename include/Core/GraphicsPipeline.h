@@ -4,6 +4,8 @@
 //Config and main helpers/universal structs
 #include "Utils/config.h"
 #include "Utils/cstm_types.h"
+#include "Utils/LinearArena.h"
+#include "Utils/DrawSort.h"
 
 //Vulkan Components
 #include "Core/Swapchain.h"
@@ -21,6 +23,31 @@ class BufferManager;
 class Buffer;
 class GUI; 
 class Mesh;
+class Defragmenter;
+class GpuCuller;
+class PipelineCache;
+class ThreadPool;
+
+//One entry of the frame's draw list -> built in the frame arena, so only raw pointers(no shared_ptr copies)
+struct DrawItem {
+	const Primitive* primitive = nullptr;
+	const Material* material = nullptr;
+	PipelineKey pipelineKey;
+	int transformIndex = 0; // model matrix slot -> the parent mesh's, or a mesh instance's
+};
+
+//Per draw data of the indirect path -> an instance rate vertex attribute, the draw's firstInstance selects its entry
+struct DrawData {
+	uint32_t meshIndex = 0;
+	uint32_t textureSlot = 0;
+};
+
+//Where the CPU time of one `drawHeadless()` frame went
+struct FrameTiming {
+	double fenceWaitMs = 0.0; // blocked on the frame's fence -> GPU bound time, all of the rendering on a software driver
+	double cpuMs = 0.0;       // everything after the wait: housekeeping, draw list, recording and submit
+	bool commandBufferReused = false;
+};
 
 class GraphicsPipeline {
 public:
@@ -63,12 +90,33 @@ public:
 		const std::shared_ptr<RenderTargeter>& renderTargeter
 	);
 
+	//Drawing w/o a window -> renders into the render target's headless images, nothing is acquired or presented
+	// -> returns the image index the frame rendered into
+	uint32_t drawHeadless(
+		const std::shared_ptr<DescriptorManager>& descriptorManager,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<GUI>& gui,
+		const std::shared_ptr<RenderTargeter>& renderTargeter,
+		FrameTiming& timing
+	);
+
+	//Copies headless image `imageIndex` into `pixels`(RGBA8, rows top down) once the frame rendering it finished
+	// -> blocks, only valid for an index `drawHeadless()` returned
+	void readbackImage(
+		uint32_t imageIndex,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		const std::shared_ptr<RenderTargeter>& renderTargeter,
+		std::vector<uint8_t>& pixels
+	);
+
 	// REFACTOR THIS FUNCTION INTO THE ABOVE FUNCTIONS,
 	// [NOTE]: DRAW OFFSCREEN WILL BE LARGELY INCOMPLETE FOR NOW
 
 	//Draw with ONLY swapchain
-	void recordFullDraw(
-		VkCommandBuffer commandBuffer,
+	//Records into the command buffer kept for this frame in flight and `imageIndex`, or returns it untouched
+	// if nothing it recorded changed since -> only the UBO/SSBO contents differ between such frames
+	VkCommandBuffer recordFullDraw(
 		uint32_t imageIndex,
 		const std::shared_ptr<DescriptorManager>& descriptorManager,
 		const std::shared_ptr<BufferManager>& bufferManager,
@@ -86,11 +134,60 @@ public:
 		std::shared_ptr<GUI> gui,
 		std::shared_ptr<RenderTargeter> renderTargeter);
 
+	//Expects the geometry buffers to already be bound
 	void drawPrimitive(
 		VkCommandBuffer commandBuffer,
-		const std::shared_ptr<BufferManager>& bufferManager,
-		const std::shared_ptr<Primitive> primitivePtr,
-		bool usePushConstant); 
+		const Primitive& primitive,
+		bool usePushConstant,
+		int transformIndex = -1); // -1 -> parent mesh's slot
+
+	// == Pipeline permutations ==
+	//Pipeline for the key's blend/cull/depth/topology state, built through the pipeline cache on first use
+	// -> compiled on the thread pool if one is set, the default pipeline stands in until it's ready(or if it fails)
+	// -> VK_NULL_HANDLE means skip the draw: only triangle lists have a stand in
+	VkPipeline getPipeline(const PipelineKey& key, bool instanced);
+	//Compiles every permutation from the manifest and the mesh manager's primitives in parallel and waits for them
+	void preparePipelines(const std::shared_ptr<MeshManager>& meshManager);
+	//Workers new permutations are compiled and draw chunks recorded on -> without one both happen inline
+	void setThreadPool(std::shared_ptr<ThreadPool> threadPool) { workerPool = threadPool; };
+	size_t getPendingPipelineCount() const;
+	//Opaque, back face culled, depth tested triangles -> `graphicsPipeline`
+	static PipelineKey getDefaultPipelineKey();
+
+	//Every primitive(and instance of it) to draw this frame grouped by pipeline key, allocated from `arena`
+	ArenaVector<DrawItem> buildDrawList(const std::shared_ptr<MeshManager>& meshManager, LinearArena& arena) const;
+
+	// == Indirect drawing ==
+	//One vkCmdDrawIndexedIndirect per pipeline batch instead of a draw per primitive
+	// -> needs drawIndirectFirstInstance and the indirect shaders, stays off(instanced direct draws) without them
+	void setIndirectDraw(bool enable);
+	bool isIndirectDrawEnabled() const { return indirectDrawEnabled; };
+
+	// == Draw sorting ==
+	//Bind counters of the last recorded frame -> a reused command buffer issues the same draws and binds
+	const DrawStats& getLastDrawStats() const { return drawStats; };
+
+	// == Parallel recording ==
+	//Splits the draw list over the thread pool's workers, each recording a secondary command buffer
+	void setParallelRecording(bool enable) { parallelRecordingEnabled = enable; };
+	bool isParallelRecordingEnabled() const { return parallelRecordingEnabled; };
+
+	// == Command buffer reuse ==
+	//Submits last time's command buffer for a swapchain image when the draws, pipelines, descriptors and buffers it
+	// recorded are unchanged -> on by default, off re-records every frame
+	void setCommandReuse(bool enable) { commandReuseEnabled = enable; };
+	bool isCommandReuseEnabled() const { return commandReuseEnabled; };
+	bool wasLastFrameReused() const { return lastFrameReused; };
+
+	// == CPU culling ==
+	//Drops draws whose bounding sphere is outside the camera frustum before recording, skipped while GPU culling runs
+	void setCpuCulling(bool enable) { cpuCullingEnabled = enable; };
+	bool isCpuCullingEnabled() const { return cpuCullingEnabled; };
+
+	// == GPU culling ==
+	//Frustum culls the draw list in a compute pass that writes the indirect commands, needs indirect drawing
+	void setGpuCulling(bool enable);
+	bool isGpuCullingEnabled() const { return gpuCullingEnabled; };
 
 
 	// Cleanup
@@ -103,6 +200,13 @@ public:
 	VkCommandPool getCommandPool() { return commandPool; };
 
 	uint32_t getCurrentFrame() { return currentFrame; };
+	uint64_t getFrameNumber() const { return frameNumber; };
+
+	//Transient CPU data of the frame being recorded -> reset once that frame's fence has been waited on
+	LinearArena& getFrameArena() { return frameArenas[currentFrame]; };
+
+	//Stepped once per frame while a defragmentation pass is running
+	void setDefragmenter(std::shared_ptr<Defragmenter> defrag) { defragmenter = defrag; };
 
 private:
 	// Injected vulkan core component classes
@@ -112,15 +216,203 @@ private:
 
 	//Injected resource managers
 	std::shared_ptr<DescriptorManager> descriptorManager;
+	std::shared_ptr<Defragmenter> defragmenter;
 
 	uint32_t currentFrame = 0;
+	uint64_t frameNumber = 0; // frames submitted so far, stamps resource usage
+
+	//One per frame in flight, so nothing the GPU might still reference through it is overwritten
+	std::array<LinearArena, MAX_FRAMES_IN_FLIGHT> frameArenas;
+
+	// == Pipeline permutations ==
+	struct PipelineShaders {
+		VkShaderModule vert = VK_NULL_HANDLE;
+		VkShaderModule frag = VK_NULL_HANDLE;
+	};
+
+	//A compiled pipeline, or a future for one still building on `compilePool`
+	struct PipelineEntry {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::future<VkPipeline> pending;
+	};
+
+	VkPipeline createPipelineForKey(const PipelineKey& key, bool instanced);
+	//Adds an entry for the key unless it has one -> `async` hands the build to `compilePool`
+	void requestPipeline(const PipelineKey& key, bool instanced, bool async);
+	VkPipeline getFallbackPipeline(const PipelineKey& key, bool instanced) const;
+	//Binds `pipeline` unless it's already bound, false if it's null(draw should be skipped)
+	bool bindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipeline& boundPipeline, DrawStats& stats) const;
+	void waitForPipelines();
+
+	//Keys built in earlier sessions -> compiled at startup so they don't hitch on first use
+	std::vector<std::pair<PipelineKey, bool>> loadPipelineManifest() const;
+	void savePipelineManifest() const;
+
+	//Next to the executable's working directory, written on cleanup
+	static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+	static constexpr const char* PIPELINE_MANIFEST_PATH = "pipeline_manifest.txt";
+
+	std::shared_ptr<ThreadPool> workerPool;
+
+	std::shared_ptr<PipelineCache> pipelineCache;
+	VkRenderPass mainPass = VK_NULL_HANDLE;
+	PipelineShaders mainShaders;
+	PipelineShaders instancedShaders;
+
+	// == Recording ==
+	//Everything recording a range of the draw list reads -> built on the recording thread, read only afterwards
+	struct DrawRecordContext {
+		const DrawItem* items = nullptr;
+		const VkPipeline* pipelines = nullptr; // per item, null -> skip the draw
+		VkDrawIndexedIndirectCommand* commands = nullptr; // per item, batched path only
+		size_t count = 0;
+
+		VkExtent2D extent{};
+		VkDescriptorSet uniformSet = VK_NULL_HANDLE;
+		uint32_t uniformOffset = 0;
+		bool bindless = false;
+		bool batched = false; // instanced pipeline available
+		bool useIndirect = false;
+	};
+
+	//Resolves every draw's pipeline and marks its material used, `gpuCulled` skips the batched path's command storage
+	DrawRecordContext prepareDrawRecording(
+		const ArenaVector<DrawItem>& drawList,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		VkExtent2D extent,
+		VkDescriptorSet uniformSet,
+		uint32_t uniformOffset,
+		bool bindless,
+		bool gpuCulled,
+		LinearArena& arena
+	);
+	//Default pipeline, viewport, scissor, descriptor sets and geometry buffers -> secondaries inherit none of it
+	void bindPassState(VkCommandBuffer commandBuffer, const DrawRecordContext& context, const std::shared_ptr<MeshManager>& meshManager, DrawStats& stats);
+	//Draws [first, first + count) of the context, safe to run for disjoint ranges at once
+	void recordDrawRange(
+		VkCommandBuffer commandBuffer,
+		const DrawRecordContext& context,
+		size_t first,
+		size_t count,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		DrawStats& stats
+	);
+
+	// == Parallel recording ==
+	//A command pool and the secondary buffer allocated from it -> one per worker for every recorded primary, so a
+	// pool is only ever used by one thread and reset once the primary's frame fence signalled
+	struct RecordSlot {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	};
+
+	void createRecordSlots(std::vector<RecordSlot>& slots, size_t slotCount);
+	void resetRecordSlots(std::vector<RecordSlot>& slots);
+	uint32_t getRecordChunkCount(size_t drawCount) const;
+	//Records the context's draws into `chunkCount` of `slots` and executes them from `commandBuffer`
+	void recordDrawsParallel(
+		VkCommandBuffer commandBuffer,
+		VkFramebuffer framebuffer,
+		std::vector<RecordSlot>& slots,
+		const DrawRecordContext& context,
+		uint32_t chunkCount,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<BufferManager>& bufferManager
+	);
+
+	//Below this many draws per chunk the hand off costs more than the recording it saves
+	static constexpr size_t RECORD_CHUNK_MIN_DRAWS = 64;
+
+	bool parallelRecordingEnabled = true;
+
+	// == Command buffer reuse ==
+	//Primary of one frame in flight + swapchain image, with the secondaries it executes
+	struct RecordedFrame {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		std::vector<RecordSlot> slots;
+		uint64_t signature = 0; // of what it recorded
+		bool valid = false;
+	};
+
+	RecordedFrame& getRecordedFrame(uint32_t imageIndex);
+	void invalidateRecordedFrames();
+	//Hash of everything a recording bakes in -> equal signatures record identical command buffers
+	uint64_t computeRecordSignature(
+		const DrawRecordContext& context,
+		VkFramebuffer framebuffer,
+		bool gpuCulling,
+		uint32_t chunkCount,
+		const std::shared_ptr<MeshManager>& meshManager,
+		const std::shared_ptr<BufferManager>& bufferManager
+	) const;
+
+	std::array<std::vector<RecordedFrame>, MAX_FRAMES_IN_FLIGHT> recordedFrames;
+	//Signature of the recording that last wrote each frame's indirect commands/draw data/cull candidates
+	// -> shared by every image of the frame, a reused primary needs them to still hold its draws
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameBufferSignatures{};
+	bool commandReuseEnabled = true;
+	bool lastFrameReused = false;
+
+	// == Instanced/indirect drawing ==
+	void createInstancedPipeline();
+	void ensureIndirectCapacity(const std::shared_ptr<BufferManager>& bufferManager, uint32_t drawCount);
+	//Consecutive draws of a primitive become one command with instanceCount > 1, recorded as
+	// vkCmdDrawIndexedIndirect per batch(`useIndirect`) or as one vkCmdDrawIndexed per command
+	// -> commands and draw data of draw i live in slot i, so disjoint ranges can be recorded in parallel
+	void recordBatchedDraws(
+		VkCommandBuffer commandBuffer,
+		const DrawRecordContext& context,
+		size_t first,
+		size_t count,
+		const std::shared_ptr<BufferManager>& bufferManager,
+		DrawStats& stats
+	);
+
+	//Command + draw data arrays, persistently mapped and rewritten every frame
+	struct IndirectBuffers {
+		BufferHandle commands{};
+		BufferHandle drawData{};
+		uint32_t capacity = 0; // draws
+	};
+
+	//Per instance DrawData at vertex binding 1 -> used by instanced direct draws as well as indirect ones
+	VkPipeline instancedPipeline = VK_NULL_HANDLE;
+	bool indirectDrawSupported = false;
+	bool indirectDrawEnabled = false;
+	std::array<IndirectBuffers, MAX_FRAMES_IN_FLIGHT> indirectBuffers;
+
+	//Host visible copy target of `readbackImage()`, grown on demand
+	BufferHandle readbackBuffer{};
+	VkDeviceSize readbackSize = 0;
+
+	// == Draw sorting ==
+	//Orders `drawList` by its 64 bit DrawSort keys -> draws sharing a pipeline and material end up next to each other
+	void sortDrawList(ArenaVector<DrawItem>& drawList, const std::shared_ptr<MeshManager>& meshManager, const glm::vec3& cameraPosition, LinearArena& arena) const;
+
+	DrawStats drawStats;
+
+	// == CPU culling ==
+	//Tests world space spheres with the SIMD kernel and compacts `drawList` in place
+	void cullDrawList(ArenaVector<DrawItem>& drawList, const std::shared_ptr<MeshManager>& meshManager, const Frustum& frustum, LinearArena& arena) const;
+
+	bool cpuCullingEnabled = true;
+
+	// == GPU culling ==
+	void createGpuCuller(VkDescriptorSetLayout uniformSetLayout);
+
+	std::shared_ptr<GpuCuller> gpuCuller;
+	bool gpuCullingEnabled = false;
 
 	// Graphics Pipeline
 	VkPipelineLayout pipelineLayout;
 
 	VkPipeline graphicsPipeline;
 
-	std::unordered_map<PipelineKey, VkPipeline> pipelineByKey; 
+	//Entries with a null pipeline and no pending build are permutations that failed to build
+	std::unordered_map<PipelineKey, PipelineEntry> pipelineByKey; 
+	std::unordered_map<PipelineKey, PipelineEntry> instancedPipelineByKey;
 
 	std::shared_ptr<ShaderLoader> shaderLoader;
 	std::vector<VkDynamicState> dynamicStates = {
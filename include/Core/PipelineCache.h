@@ -0,0 +1,47 @@
+#pragma once
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include "Utils/config.h"
+
+//Forward declarations
+class Devices;
+
+/**
+	* @class PipelineCache
+	* @brief Owns the `VkPipelineCache` every pipeline is created through, persisted to disk between runs.
+	*
+	* `load()` reads the file written by the last `save()` and only hands it to the driver if its header
+	* matches this device(vendor, device id and pipelineCacheUUID) -> a cache from another GPU or driver
+	* version is dropped instead of relying on the driver to reject it. With a valid cache, creating a
+	* pipeline that was built in an earlier run skips shader compilation.
+*/
+class PipelineCache {
+public:
+	PipelineCache(std::shared_ptr<Devices> devices);
+
+	//Creates the cache, seeded from `path` if it holds a cache for this device
+	void load(const std::string& path);
+
+	//Writes the current contents to the path given to `load()`
+	bool save() const;
+
+	VkPipelineCache getCache() const { return cache; };
+
+	//Whether `load()` found a usable cache -> pipelines created now are expected to be cache hits
+	bool loadedFromDisk() const { return seeded; };
+
+	void cleanup();
+
+private:
+	//Checks the VkPipelineCacheHeaderVersionOne the data starts with against the device
+	bool isValidForDevice(const std::vector<char>& data) const;
+
+	std::shared_ptr<Devices> cache_devices;
+
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	std::string cachePath;
+	bool seeded = false;
+};
+
+#endif
@@ -7,11 +7,25 @@
 
 #include "Core/VulkanInstance.h"
 #include "Core/VulkanDevices.h"
+#include "Managers/MemoryAllocator.h"
 
 class ShaderLoader; 
 class BufferManager;
 class Image; 
 
+//An attachment whose contents never leave its render passes(loadOp CLEAR/DONT_CARE, storeOp DONT_CARE)
+// -> created with TRANSIENT usage and backed by lazily allocated memory when the device has it
+struct TransientAttachmentInfo {
+	std::string name;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags usage = 0; // attachment usage, TRANSIENT is added on top
+	VkImageAspectFlags aspectFlags = 0;
+
+	//Range of passes(in frame order) the attachment is used in -> attachments with non overlapping ranges share memory
+	uint32_t firstPass = 0;
+	uint32_t lastPass = 0;
+};
+
 struct RenderTarget {
 	std::shared_ptr<Image> depthImage = nullptr;
 	//std::shared_ptr<Image> colorImages; -> instead of the lines below
@@ -29,8 +43,8 @@ struct RenderTarget {
 
 class RenderTargeter {
 public:
-	RenderTargeter(std::shared_ptr<VulkanInstance> instance, std::shared_ptr<Devices> devices)
-		: swpch_instance(instance), swpch_devices(devices) {
+	RenderTargeter(std::shared_ptr<VulkanInstance> instance, std::shared_ptr<Devices> devices, std::shared_ptr<MemoryAllocator> memoryAllocator)
+		: swpch_instance(instance), swpch_devices(devices), swpch_memoryAllocator(memoryAllocator) {
 		std::cout << "RenderTargeter constructor start" << std::endl;
 
 		if (!swpch_instance) throw std::runtime_error("Instance is null in RenderTargeter");
@@ -42,6 +56,16 @@ public:
 	// ==MAIN FUNCTIONS==
 	void createDepthImage();
 
+	//Creates every transient attachment at the render target extent and packs them into as few allocations as
+	// their lifetimes allow. Render passes using aliased attachments must start them from UNDEFINED and depend on
+	// the previous user's attachment writes
+	void createTransientAttachments(const std::vector<TransientAttachmentInfo>& attachmentInfos);
+	std::shared_ptr<Image> getTransientAttachment(const std::string& name) const;
+	void destroyTransientAttachments();
+
+	//Memory actually reserved for transient attachments(lazily allocated memory may never be committed)
+	VkDeviceSize getTransientMemorySize() const;
+
 	void getFramebufferDetails() {
 		std::cout << "[RenderTargeter::getFramebufferDetails] entered" << std::endl;
 
@@ -63,6 +87,12 @@ public:
 			<< "[RemderTargeter::getFramebufferDetails] SURFACE FORMAT: " << renderTarget.format << std::endl;
 	}
 	void createSwapchainResources(); // if using offscreen bascially duplicate this function to make offscreen images and image views
+
+	// == Headless ==
+	//Stands in for getFramebufferDetails() without a surface -> fixed extent, RGBA8 sRGB so frames can be written out as is
+	void setHeadlessDetails(VkExtent2D extent);
+	//Stands in for createSwapchainResources() -> `imageCount` color images the main pass renders into, readable by transfers
+	void createHeadlessResources(uint32_t imageCount);
 	void createFramebuffers(VkRenderPass renderpass, bool usingOffscreenPass);
 
 	//Renderpass creation
@@ -84,9 +114,9 @@ public:
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
 		//Initial and final layout of the swapchain image
-		// -> in this case final layout is VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		// -> in this case final layout is VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, headless images are copied out instead
 		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.finalLayout = swpch_instance->isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentRef{};
 		colorAttachmentRef.attachment = 0; //refers the the index of this attachment
@@ -237,17 +267,26 @@ private:
 	//Inject Vulkan Core Components
 	std::shared_ptr<VulkanInstance> swpch_instance = nullptr; 
 	std::shared_ptr<Devices> swpch_devices = nullptr; 
+	std::shared_ptr<MemoryAllocator> swpch_memoryAllocator = nullptr;
 
 	RenderTarget renderTarget; 
 
+	//Transient attachments and the memory they alias into
+	std::unordered_map<std::string, std::shared_ptr<Image>> transientAttachments;
+	std::vector<MemoryAllocation> transientMemory;
+
 	//Swapchain -> only used if rendering to the entire screen in game mode
 	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	//Color images standing in for the swapchain's when headless
+	std::vector<std::shared_ptr<Image>> headlessImages;
+	std::vector<MemoryAllocation> headlessMemory;
+	void destroyHeadlessResources();
 	//Sampler -> only used if offscreen rendering
 	VkSampler sampler;
 
 	//Renderpasses
-	VkRenderPass mainPass; 
-	VkRenderPass offscreenPass; 
+	VkRenderPass mainPass = VK_NULL_HANDLE; 
+	VkRenderPass offscreenPass = VK_NULL_HANDLE; // only created for the editor view, destroying null is a no-op
 
 	// Swapchain helpers
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -10,13 +10,20 @@ struct Capabilities {
 	bool supportsDescriptorIndexing = false; 
 	bool supportsBindless = false; 
 	bool supportsAnisotrophy = false;
+	bool supportsMemoryBudget = false; // VK_EXT_memory_budget, optional
+	bool supportsBufferDeviceAddress = false; // VK_KHR_buffer_device_address or vulkan 1.2, optional
+	bool supportsDrawIndirectCount = false; // VK_KHR_draw_indirect_count, optional -> GPU written draw counts
 
 	bool runtimeDescriptorArray = false;
 	bool shaderSampledImageArrayNonUniformIndexing = false;
 	bool descriptorBindingPartiallyBound = false;
 	bool descriptorBindingVariableDescriptorCount = false;
+	bool bufferDeviceAddress = false;
+	bool multiDrawIndirect = false; // drawCount > 1 in one vkCmdDrawIndexedIndirect
+	bool drawIndirectFirstInstance = false; // indirect commands may use firstInstance != 0
 
 	uint32_t maxUpdateAfterBindDescriptorsInAllPools = 0;
+	uint32_t maxDrawIndirectCount = 1;
 
 	void query(VkPhysicalDevice potentialDevice);
 };
@@ -37,6 +44,9 @@ public:
 	VkDevice getLogicalDevice() { return device; };
 	VkQueue getGraphicsQueue() { return graphicsQueue; };
 	VkQueue getPresentQueue() { return presentQueue; };
+	//Falls back to the graphics queue when the device has no dedicated transfer family
+	VkQueue getTransferQueue() { return transferQueue; };
+	bool hasDedicatedTransferQueue() const { return queueFamilies.hasDedicatedTransfer(); };
 	Capabilities getDeviceCaps() { return deviceCaps; };
 
 	QueueFamilyIndices getQueueFamilies() const { return queueFamilies; };
@@ -57,6 +67,7 @@ private:
 	VkDevice device = VK_NULL_HANDLE;
 	VkQueue graphicsQueue = VK_NULL_HANDLE;
 	VkQueue presentQueue = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
 
 	QueueFamilyIndices queueFamilies;
 
@@ -65,6 +76,7 @@ private:
 
 	//Helper functions
 	const bool checkDeviceExtensionSupport(VkPhysicalDevice potentialDevice);
+	const bool isDeviceExtensionAvailable(VkPhysicalDevice potentialDevice, const char* extensionName);
 	const bool rateDeviceSuitability(VkPhysicalDevice potentialDevice, int currentGreatestDeviceScore);
 	// this last logger function should be moved to a logger utility class
 	void logPhysicalDevice() const;
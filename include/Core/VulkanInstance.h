@@ -10,7 +10,8 @@ public:
 	bool framebufferResized = false;
 
 	//Initialize GLFW window on instance construction
-	VulkanInstance(std::shared_ptr<DebugManager> debugManager);
+	// -> headless skips GLFW entirely, there is no window or surface and nothing is presented
+	VulkanInstance(std::shared_ptr<DebugManager> debugManager, bool headless = false);
 	void cleanup();
 
 	//Main functions
@@ -21,6 +22,7 @@ public:
 	GLFWwindow* getWindowPtr() const { return window; };
 	VkInstance getInstance() const { return instance; };
 	VkSurfaceKHR getSurface() const { return surface; };
+	bool isHeadless() const { return headless; };
 
 
 
@@ -29,7 +31,8 @@ private:
 
 	GLFWwindow* window = VK_NULL_HANDLE;
 	VkInstance instance = VK_NULL_HANDLE; // Vulkan Instance
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	bool headless = false;
 };
 
 #endif
\ No newline at end of file
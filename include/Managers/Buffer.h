@@ -4,6 +4,7 @@
 
 #include "Utils/config.h"
 #include "Managers/Vertex.h"
+#include "Managers/MemoryAllocator.h"
 
 //Forward declarations
 struct Vertex;
@@ -54,25 +55,25 @@ public:
 		VkDeviceSize size,
 		VkDevice logicalDevice,
 		VkPhysicalDevice physicalDevice,
-		std::optional<std::vector<Vertex>> vertices,
-		std::optional<std::vector<uint32_t>> indices);
+		std::shared_ptr<MemoryAllocator> allocator,
+		const std::optional<std::vector<Vertex>>& vertices,
+		const std::optional<std::vector<uint32_t>>& indices);
 
 	void cleanup() {
 		std::cout << "Calling Buffer::cleanup() for handle: " << buf_handle << std::endl;
 
-		// Clean up buffer memory if allocated
-		if (buf_memory != VK_NULL_HANDLE) {
-			vkFreeMemory(buf_logicalDevice, buf_memory, nullptr);
-			buf_memory = VK_NULL_HANDLE;
-			std::cout << "Buffer memory freed" << std::endl;
-		}
-
 		// Destroy the buffer if it's created
 		if (buf_handle != VK_NULL_HANDLE) {
 			vkDestroyBuffer(buf_logicalDevice, buf_handle, nullptr);
 			buf_handle = VK_NULL_HANDLE;
 			std::cout << "Buffer destroyed" << std::endl;
 		}
+
+		// Hand the sub-allocation back to the allocator
+		if (buf_allocation.isValid()) {
+			buf_allocator->free(buf_allocation);
+			std::cout << "Buffer memory freed" << std::endl;
+		}
 	}
 
 	void allocateAndBindBuffer(
@@ -80,15 +81,21 @@ public:
 		VkPhysicalDevice physicalDevice,
 		VkDeviceSize size,
 		VkBufferUsageFlags usage,
-		VkMemoryPropertyFlags properties
+		VkMemoryPropertyFlags properties,
+		MemoryUsage memoryUsage = MemoryUsage::AUTO
 	);
 	
 	void createBuffer(
 		VkDevice logicalDevice, VkPhysicalDevice physicalDevice,
 		VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkDeviceSize size
+		VkDeviceSize size, MemoryUsage memoryUsage = MemoryUsage::AUTO
 	);
 
+	//Queue families the buffer is used from concurrently, set before createBuffer()
+	// -> fewer than two keeps the buffer VK_SHARING_MODE_EXCLUSIVE
+	void setSharedQueueFamilies(const std::vector<uint32_t>& queueFamilies) { buf_queueFamilies = queueFamilies; };
+	const std::vector<uint32_t>& getSharedQueueFamilies() const { return buf_queueFamilies; };
+
 	void mapData(VkDevice logicalDevice, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 
 	//Error handling functions
@@ -98,16 +105,37 @@ public:
 
 	//Getter functions 
 	VkBuffer getHandle() const { return buf_handle; };
-	VkDeviceMemory getMemory() const { return buf_memory; };
-
-	//This function gets the data within a buffer, either vertices or indices(for now)
-	template<typename T>
-	std::vector<T> getData() const;
+	const std::string& getName() const { return buf_name; };
+	VkDeviceMemory getMemory() const { return buf_allocation.memory; };
+	VkDeviceSize getMemoryOffset() const { return buf_allocation.offset; };
+	//Persistently mapped pointer, nullptr if the buffer is not host visible
+	void* getMappedPtr() const { return buf_allocation.mappedPtr; };
+	const MemoryAllocation& getAllocation() const { return buf_allocation; };
+	//0 unless the buffer was created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkDeviceAddress getDeviceAddress() const { return buf_deviceAddress; };
+	void setDeviceAddress(VkDeviceAddress address) { buf_deviceAddress = address; };
+
+	//Number of vertices/indices the buffer was created with, the data itself is not kept on the CPU
+	uint32_t getElementCount() const { return buf_elementCount; };
+
+	VkDeviceSize getSize() const { return buf_size; };
+	VkBufferUsageFlags getUsage() const { return buf_usage; };
+	VkMemoryPropertyFlags getProperties() const { return buf_properties; };
+	MemoryUsage getMemoryUsage() const { return buf_memoryUsage; };
+
+	//Exchanges the VkBuffer, its memory and device address with `other`
+	// -> used to move a buffer without invalidating the shared_ptr/handle everyone else holds
+	void swapStorage(Buffer& other) {
+		std::swap(buf_handle, other.buf_handle);
+		std::swap(buf_allocation, other.buf_allocation);
+		std::swap(buf_deviceAddress, other.buf_deviceAddress);
+	}
 
 private: 
 	//Injected vulkan components - for internal method use
 	VkDevice buf_logicalDevice;
 	VkPhysicalDevice buf_physicalDevice;
+	std::shared_ptr<MemoryAllocator> buf_allocator;
 
 	//Buffer info
 	BufferType buf_type = BufferType::GENERIC;
@@ -115,10 +143,17 @@ private:
 
 	VkDeviceSize buf_size; 
 	VkBuffer buf_handle = VK_NULL_HANDLE;
-	VkDeviceMemory buf_memory = VK_NULL_HANDLE;
+	MemoryAllocation buf_allocation{};
+	VkDeviceAddress buf_deviceAddress = 0;
+	VkBufferUsageFlags buf_usage = 0;
+	VkMemoryPropertyFlags buf_properties = 0;
+	MemoryUsage buf_memoryUsage = MemoryUsage::AUTO;
+	std::vector<uint32_t> buf_queueFamilies;
 	unsigned short buf_errors = BUF_ERROR_NONE;
 
-	//Optional data
+	uint32_t buf_elementCount = 0;
+
+	//Staging data, released as soon as it is copied into mapped memory
 	std::optional<std::vector<Vertex>> buf_vertices;
 	std::optional<std::vector<uint32_t>> buf_indices;
 };
@@ -5,6 +5,10 @@
 #include "Utils/config.h"
 #include "Managers/Buffer.h"
 #include "Managers/Vertex.h"
+#include "Managers/MemoryAllocator.h"
+#include "Managers/StagingRing.h"
+#include "Managers/DeletionQueue.h"
+#include "Utils/SlotMap.h"
 
 //Forward declarations
 class GraphicsPipeline; 
@@ -16,38 +20,206 @@ public:
 	BufferManager(
 		VkDevice logicalDevice,
 		VkPhysicalDevice physicalDevice,
-		VkQueue graphicsQueue
+		VkQueue graphicsQueue,
+		std::shared_ptr<MemoryAllocator> memoryAllocator,
+		VkDeviceSize stagingRingSize = 32ull * 1024 * 1024
 	);
 
+	//Moves upload batches onto a dedicated transfer queue, without it everything runs on the graphics queue
+	// -> buffers created afterwards with TRANSFER_DST are shared concurrently by both families, only images change hands
+	// -> batches signal a semaphore a small graphics queue submit waits on, it also records the image acquires
+	// [NOTE]: call before creating buffers, earlier ones stay exclusive to the graphics queue
+	void setTransferQueue(VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily);
+	bool usesTransferQueue() const { return useTransferQueue; };
+
 	void cleanup();
 
-	void createBuffer(
+	// == Buffer device address ==
+	//Set once bufferDeviceAddress is enabled on the logical device, without it the usage bit is stripped from new buffers
+	void setBufferDeviceAddressEnabled(bool enabled);
+	bool isBufferDeviceAddressEnabled() const { return bufferDeviceAddressEnabled; };
+	//VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT when supported, 0 otherwise -> OR it into the usage of buffers shaders read by pointer
+	VkBufferUsageFlags getDeviceAddressUsage() const;
+	//64 bit GPU address of the buffer, 0 if it has none(or the handle is stale)
+	VkDeviceAddress getDeviceAddress(BufferHandle handle) const;
+
+	BufferHandle createBuffer(
 		BufferType type,
 		const std::string& name,
 		VkDeviceSize bufferSize,
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
-		std::optional<std::vector<Vertex>> vertices = std::nullopt,
-		std::optional<std::vector<uint32_t>> indices = std::nullopt
+		const std::optional<std::vector<Vertex>>& vertices = std::nullopt,
+		const std::optional<std::vector<uint32_t>>& indices = std::nullopt,
+		MemoryUsage memoryUsage = MemoryUsage::AUTO
 	);
 	
 	VkCommandBuffer beginOneTimeCommands(VkCommandPool commandPool);
 
+	//Submits and blocks until the commands finished, any open upload batch is submitted first
 	void endOneTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool commandPool);
 
-	void copyBuffer(std::shared_ptr<Buffer> srcBuffer, std::shared_ptr<Buffer> dstBuffer, VkDeviceSize size, VkCommandPool commandPool);
+	// == Upload batching ==
+	//Command buffer that collects copies/barriers until the next flush, opens a new batch if none is open
+	// -> commandPool is ignored on a dedicated transfer queue, batches come from the transfer pool then
+	VkCommandBuffer getUploadCommandBuffer(VkCommandPool commandPool);
+
+	//Records a copy into the batch, visible to the graphics queue once the flush's acquire submit ran
+	void recordBufferCopy(VkCommandPool commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region);
+
+	//Transitions an image written by the batch to newLayout for the graphics queue
+	// -> a release barrier here plus an acquire barrier on flush when a transfer queue is used
+	void releaseImageToGraphics(
+		VkCommandPool commandPool,
+		VkImage image,
+		const VkImageSubresourceRange& subresourceRange,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout
+	);
+
+	//Token the currently open batch will complete with(or the last submitted one)
+	UploadToken getUploadBatchToken() const;
+
+	//Submits the open batch without waiting
+	UploadToken flushUploads();
+
+	bool isUploadComplete(UploadToken token);
+
+	void copyBuffer(
+		std::shared_ptr<Buffer> srcBuffer, 
+		std::shared_ptr<Buffer> dstBuffer, 
+		VkDeviceSize size, 
+		VkCommandPool commandPool,
+		VkDeviceSize srcOffset = 0,
+		VkDeviceSize dstOffset = 0
+	);
+
+	// == Staging ==
+	//Slice of the persistent staging ring, reused once the submit reading it completes
+	// -> record the copy reading a slice before allocating the next one, a full ring flushes the open batch
+	// -> requests larger than the ring(or a ring full of unsubmitted data) fall back to a temporary buffer
+	StagingAllocation allocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	//Records a copy of `data` into dstBuffer in the upload batch, host visible buffers are written directly
+	UploadToken uploadToBuffer(
+		std::shared_ptr<Buffer> dstBuffer,
+		const void* data,
+		VkDeviceSize size,
+		VkCommandPool commandPool,
+		VkDeviceSize dstOffset = 0
+	);
+
+	//Non blocking, retires every finished upload submission and frees its staging space
+	// -> called once per frame after the in flight fence wait
+	void reclaimStaging();
+
+	//Blocks until every upload submission up to token has finished, flushes the open batch if needed
+	void waitForUploads(UploadToken token);
+
+	uint64_t getCompletedUploadValue() const { return completedUploadValue; };
+	const StagingRing& getStagingRing() const { return stagingRing; };
+
+	// == Defragmentation ==
+	//Moves the buffer's contents into freshly allocated memory and swaps it in, the handle and Buffer stay the same
+	// -> returns the old storage, cleanup() it once no frame in flight can still read it. nullptr if the buffer can't be moved
+	// -> mapped buffers(the CPU holds pointers into them) and buffers without TRANSFER_SRC|DST are left alone
+	std::shared_ptr<Buffer> relocateBuffer(BufferHandle handle, VkCommandPool commandPool);
 
+	//Calls func(handle, buffer) for every live buffer
+	template<typename Func>
+	void forEachBuffer(Func&& func) {
+		buffers.forEach([&](BufferHandle handle, std::shared_ptr<Buffer>& buffer) {
+			if (buffer) func(handle, *buffer);
+		});
+	}
+
+	// == Retrieval ==
+	//O(1) and allocation free, nullptr if the buffer was removed -> use this from per frame code
+	Buffer* getBuffer(BufferHandle handle) const;
+
+	//Name lookups are kept for setup, debugging and the editor
 	std::shared_ptr<Buffer> getBuffer(const std::string& name);
+	BufferHandle findBuffer(const std::string& name) const;
 
+	// == Deletion ==
+	//Only forgets the buffer, cleanup() of the Buffer itself is left to the caller
+	void removeBuffer(BufferHandle handle);
 	void removeBufferByName(const std::string name);
 
+	//Forgets the buffer now and destroys it once the frames in flight that may use it have retired
+	void destroyBuffer(BufferHandle handle);
+
+	//Shared by every manager, flushed once per frame after the fence wait
+	DeletionQueue& getDeletionQueue() { return deletionQueue; };
+
+	std::shared_ptr<MemoryAllocator> getMemoryAllocator() { return bufferManager_memoryAllocator; };
+
 private:
-	std::unordered_map<std::string, std::shared_ptr<Buffer>> buffers;
+	SlotMap<std::shared_ptr<Buffer>, BufferTag> buffers;
+	std::unordered_map<std::string, BufferHandle> bufferNames;
 
 	VkDevice bufferManager_logicalDevice;
 	VkPhysicalDevice bufferManager_physicalDevice;
 	std::shared_ptr<GraphicsPipeline> bufferManager_graphicsPipeline;
 	VkQueue bufferManager_graphicsQueue;
+	std::shared_ptr<MemoryAllocator> bufferManager_memoryAllocator;
+
+	DeletionQueue deletionQueue;
+
+	bool bufferDeviceAddressEnabled = false;
+	PFN_vkGetBufferDeviceAddress getBufferDeviceAddressFunc = nullptr; // core or KHR entry point
+
+	// == Staging ring state ==
+	struct PendingUpload {
+		VkFence fence = VK_NULL_HANDLE; // always signaled from the graphics queue
+		uint64_t fenceValue = 0;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // freed once the fence signals
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		//Transfer queue batches only
+		VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+	};
+
+	struct OverflowStaging {
+		std::string name;
+		uint64_t fenceValue = 0; // 0 -> not submitted yet
+	};
+
+	void submitUpload(PendingUpload upload, const VkSubmitInfo& submitInfo);
+	void submitTransferBatch();
+	VkFence acquireUploadFence();
+	VkSemaphore acquireUploadSemaphore();
+	void retireUpload(const PendingUpload& upload);
+	void releaseCompletedStaging();
+
+	StagingRing stagingRing;
+	std::deque<OverflowStaging> overflowStaging;
+	uint32_t overflowCounter = 0;
+
+	//Every one time submit gets the next fence value, space tagged with it is reused once it completes
+	uint64_t nextUploadValue = 1;
+	uint64_t completedUploadValue = 0;
+	std::deque<PendingUpload> pendingUploads;
+	std::vector<VkFence> freeUploadFences;
+	std::vector<VkSemaphore> freeUploadSemaphores;
+
+	//Open upload batch, its fence value is reserved when it is opened so tokens can be handed out early
+	VkCommandBuffer uploadBatchCommandBuffer = VK_NULL_HANDLE;
+	VkCommandPool uploadBatchCommandPool = VK_NULL_HANDLE;
+	uint64_t uploadBatchValue = 0;
+
+	// == Transfer queue ==
+	bool useTransferQueue = false;
+	VkQueue bufferManager_transferQueue = VK_NULL_HANDLE;
+	uint32_t bufferManager_transferFamily = 0;
+	uint32_t bufferManager_graphicsFamily = 0;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE; // batches, transfer family
+	VkCommandPool acquireCommandPool = VK_NULL_HANDLE;  // ownership acquires, graphics family
+	std::vector<uint32_t> sharedQueueFamilies;          // graphics + transfer, for VK_SHARING_MODE_CONCURRENT buffers
+
+	//Acquire halves of the image ownership transfers recorded into the open batch
+	std::vector<VkImageMemoryBarrier> pendingImageAcquires;
 };
 
 #endif
\ No newline at end of file
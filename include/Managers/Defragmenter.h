@@ -0,0 +1,88 @@
+#pragma once
+#ifndef DEFRAGMENTER_H
+#define DEFRAGMENTER_H
+
+#include "Utils/config.h"
+#include "Utils/SlotMap.h"
+
+//Forward declarations
+class MemoryAllocator;
+class BufferManager;
+class ImageManager;
+class Buffer;
+class Image;
+
+//Outcome of one defragmentation pass
+struct DefragmentationReport {
+	uint32_t buffersMoved = 0;
+	uint32_t imagesMoved = 0;
+	VkDeviceSize bytesMoved = 0;
+	VkDeviceSize bytesReclaimed = 0; // VkDeviceMemory handed back to the driver
+	uint64_t framesTaken = 0;
+};
+
+/**
+	* @class Defragmenter
+	* @brief Empties sparsely used memory blocks by moving their resources into denser ones, a few per frame.
+	*
+	* `begin()` has the `MemoryAllocator` mark the sparse blocks as sources and collects every buffer and
+	* texture living in them. Each `step()` then moves up to `maxBytesPerFrame` of them: a replacement is
+	* allocated(never inside a source block), the contents are copied over and the storage is swapped into
+	* the existing `Buffer`/`Image`, so handles and shared_ptrs everyone holds stay valid.
+	*
+	* The old storage goes through the buffer manager's `DeletionQueue`, so it is only freed once every frame
+	* in flight that could still reference it has retired -> freeing the last allocation releases the source block.
+	*
+	* Buffers are copied on the GPU, textures are re-uploaded from their `TextureSource` and get their
+	* descriptors rewritten by the image manager's next `updateResidency()`.
+*/
+class Defragmenter {
+public:
+	Defragmenter(
+		std::shared_ptr<MemoryAllocator> memoryAllocator,
+		std::shared_ptr<BufferManager> bufferManager,
+		std::shared_ptr<ImageManager> imageManager
+	);
+
+	//Starts a pass over blocks less than `maxBlockUsage` full, false if there is nothing to compact
+	bool begin(float maxBlockUsage = 0.5f);
+
+	//Called once per frame after the frame's fence wait, before the upload batch is flushed
+	void step(uint64_t frameNumber, VkCommandPool commandPool);
+
+	bool isRunning() const { return running; };
+
+	//Upper bound on bytes moved per frame -> keeps the copies from eating into the frame
+	void setMaxBytesPerFrame(VkDeviceSize bytes) { maxBytesPerFrame = bytes; };
+
+	const DefragmentationReport& getLastReport() const { return report; };
+
+	//Abandons a running pass, old storage already swapped out is left to the deletion queue
+	void cleanup();
+
+private:
+	struct PendingMove {
+		BufferHandle buffer{};
+		ImageHandle image{};
+	};
+
+	void moveNext(VkCommandPool commandPool, VkDeviceSize& bytesThisFrame);
+	void finish(uint64_t frameNumber);
+
+	std::shared_ptr<MemoryAllocator> defrag_memoryAllocator;
+	std::shared_ptr<BufferManager> defrag_bufferManager;
+	std::shared_ptr<ImageManager> defrag_imageManager;
+
+	std::deque<PendingMove> pendingMoves;
+	uint64_t lastRetireFrame = 0; // every old allocation has been freed once this frame starts
+
+	bool running = false;
+	bool started = false; // first step() taken, `startFrame` is valid
+	uint64_t startFrame = 0;
+	VkDeviceSize reservedBefore = 0;
+	VkDeviceSize maxBytesPerFrame = 16ull * 1024 * 1024;
+
+	DefragmentationReport report{};
+};
+
+#endif
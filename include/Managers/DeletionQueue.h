@@ -0,0 +1,43 @@
+#pragma once
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include "Utils/config.h"
+
+/**
+	* @class DeletionQueue
+	* @brief Defers destroying GPU resources until no frame in flight can still reference them.
+	*
+	* Every request is tagged with the frame being recorded when it was pushed. Command buffers of that
+	* frame(and the ones before it) may still use the resource, so it is only destroyed once the frame
+	* MAX_FRAMES_IN_FLIGHT later has waited on its fence -> at that point the frame has retired.
+	*
+	* `flush()` is called once per frame right after the fence wait, nothing ever waits on the device.
+*/
+class DeletionQueue {
+public:
+	//Runs `destroy` once every frame up to the current one has retired
+	void push(std::function<void()> destroy);
+
+	//Destroys everything whose frames have retired, `frameNumber` is the frame about to be recorded
+	void flush(uint64_t frameNumber);
+
+	//Destroys everything right away -> only once the device is idle(shutdown, swapchain recreation)
+	void flushAll();
+
+	//Frame at which everything pushed so far will have been destroyed
+	uint64_t getRetireFrame() const { return currentFrame + MAX_FRAMES_IN_FLIGHT; };
+	size_t size() const;
+
+private:
+	struct Entry {
+		uint64_t retireFrame = 0;
+		std::function<void()> destroy;
+	};
+
+	std::deque<Entry> entries; // retireFrame only ever grows, so the front retires first
+	uint64_t currentFrame = 0;
+	mutable std::mutex queueMutex;
+};
+
+#endif
@@ -30,9 +30,13 @@ public:
 	descManager_bufferManager(bufferManager), 
 	descManager_camera(camera) {};
 
-	void createUniformBuffers();
+	//One persistently mapped buffer split into `viewsPerFrame` aligned slices per frame in flight
+	// -> every slice is reached through the same descriptor set with a dynamic offset
+	void createUniformBuffers(uint32_t viewsPerFrame = 1);
 
-	void updateUniformBuffer(uint32_t currentImage, VkExtent2D swapchainExtent);
+	//Writes the camera UBO into this frame's slice for `viewIndex`, returns the dynamic offset to bind set 0 with
+	uint32_t updateUniformBuffer(uint32_t currentFrame, VkExtent2D swapchainExtent, uint32_t viewIndex = 0);
+	uint32_t getUniformOffset(uint32_t currentFrame, uint32_t viewIndex = 0) const;
 
 	void createDescriptorPool(int meshCount, int materialCount);
 
@@ -41,9 +45,12 @@ public:
 	void cleanup();
 
 	//Getter functions
-	std::vector<VkDescriptorSet> getDescriptorSets() const { return descriptorSets; };
+	VkDescriptorSet getDescriptorSet() const { return descriptorSet; };
+	VkDeviceSize getUniformSliceSize() const { return uniformSliceSize; };
+	uint32_t getViewsPerFrame() const { return viewsPerFrame; };
 	VkDescriptorPool getDescriptorPool() { return descriptorPool; };
 	VkDescriptorSetLayout getDescriptorSetLayout() { return descriptorSetLayout; };
+	const std::shared_ptr<Camera>& getCamera() const { return descManager_camera; };
 
 	//Setter functions
 
@@ -60,9 +67,12 @@ private:
 	//Descriptor Info
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets; 
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE; 
 
-	std::vector<UniformBufferInfo> ubufInfo;
+	//Dynamic uniform buffer -> slice(frame, view) lives at (frame * viewsPerFrame + view) * uniformSliceSize
+	UniformBufferInfo uniformBuffer;
+	VkDeviceSize uniformSliceSize = 0;
+	uint32_t viewsPerFrame = 1;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include "Utils/config.h"
+#include "Managers/Vertex.h"
+
+//Forward declarations
+class BufferManager;
+class Buffer;
+
+//Where a primitive lives inside the shared geometry buffers -> fed straight into vkCmdDrawIndexed
+struct GeometryRange {
+	uint32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	bool resident = false;
+};
+
+//First-fit free list over a range of elements, neighbouring free ranges are merged on release
+class FreeRangeList {
+public:
+	void reset(uint32_t capacity);
+	void grow(uint32_t newCapacity);
+
+	std::optional<uint32_t> allocate(uint32_t count);
+	void release(uint32_t offset, uint32_t count);
+
+	uint32_t getCapacity() const { return capacity; };
+	uint32_t getUsed() const { return used; };
+	uint32_t getLargestFreeRange() const;
+	size_t getFreeRangeCount() const { return freeRanges.size(); };
+
+private:
+	void insertFreeRange(uint32_t offset, uint32_t count);
+
+	std::map<uint32_t, uint32_t> freeRanges; // offset -> count
+	uint32_t capacity = 0;
+	uint32_t used = 0;
+};
+
+/**
+	* @class GeometryBuffer
+	* @brief One device local vertex buffer and one index buffer that every primitive is packed into.
+	*
+	* Primitives get a `GeometryRange` back from `upload()` and draw with firstIndex/vertexOffset,
+	* so the draw loop only binds the vertex and index buffers once per batch.
+	*
+	* Ranges can be released at runtime and are reused by later uploads. When there is no free range
+	* large enough the buffers are grown(doubled) with a GPU copy of the old contents.
+*/
+class GeometryBuffer {
+public:
+	GeometryBuffer(
+		std::shared_ptr<BufferManager> bufferManager,
+		uint32_t initialVertexCapacity = 256 * 1024,
+		uint32_t initialIndexCapacity = 1024 * 1024
+	);
+
+	GeometryRange upload(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, VkCommandPool commandPool);
+
+	//[NOTE]: caller must make sure no in-flight frame still draws from this range
+	void release(GeometryRange& range);
+
+	//Binds both buffers at offset 0 -> draws index into them with firstIndex/vertexOffset
+	void bind(VkCommandBuffer commandBuffer) const;
+
+	bool isCreated() const { return vertexBuffer != nullptr && indexBuffer != nullptr; };
+
+	// == Getters ==
+	VkBuffer getVertexBuffer() const;
+	VkBuffer getIndexBuffer() const;
+	//0 without buffer device address support, changes whenever the buffers grow
+	VkDeviceAddress getVertexBufferAddress() const;
+	VkDeviceAddress getIndexBufferAddress() const;
+	const FreeRangeList& getVertexRanges() const { return vertexRanges; };
+	const FreeRangeList& getIndexRanges() const { return indexRanges; };
+
+	void printStats() const;
+
+private:
+	void createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity);
+	void growVertexBuffer(uint32_t minCapacity, VkCommandPool commandPool);
+	void growIndexBuffer(uint32_t minCapacity, VkCommandPool commandPool);
+
+	std::shared_ptr<BufferManager> geometry_bufferManager;
+
+	uint32_t initialVertexCapacity;
+	uint32_t initialIndexCapacity;
+	uint32_t generation = 0; // bumped on every grow, used to name the backing buffers
+
+	std::string vertexBufferName;
+	std::string indexBufferName;
+	std::shared_ptr<Buffer> vertexBuffer = nullptr;
+	std::shared_ptr<Buffer> indexBuffer = nullptr;
+
+	FreeRangeList vertexRanges;
+	FreeRangeList indexRanges;
+};
+
+#endif
@@ -4,6 +4,8 @@
 
 #include "Utils/config.h"
 #include "External/stb_image.h"
+#include "Managers/MemoryAllocator.h"
+#include "Managers/StagingRing.h"
 
 //Forward declarations
 class BufferManager;
@@ -32,9 +34,17 @@ enum ImageErrors : unsigned short {
 	IMG_ERROR_SAMPLER_CREATION = 0b0000000010000000
 };
 
+//Residency of a texture managed by the `ImageManager`
+// -> EVICTING keeps the memory alive until no in-flight frame can still reference it
+enum class TextureResidency : uint8_t {
+	RESIDENT = 0,
+	EVICTING = 1,
+	EVICTED = 2
+};
+
 class Image {
 public:
-	Image(VkDevice logicalDevice, VkPhysicalDevice physicalDevice);
+	Image(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<MemoryAllocator> allocator);
 
 	void cleanup() {
 		std::cout << "Cleaned up image: " << image << " successfully" << std::endl;
@@ -54,25 +64,37 @@ public:
 			image = VK_NULL_HANDLE;
 		}
 
-		if (imageMemory != VK_NULL_HANDLE) {
-			vkFreeMemory(imageLogicalDevice, imageMemory, nullptr);
-			imageMemory = VK_NULL_HANDLE;
+		if (imageAllocation.isValid()) {
+			imageAllocator->free(imageAllocation);
 		}
 	}
 
 	//This function will fully create a texture image from the main script
+	// -> the transitions and copy are recorded into the buffer manager's upload batch, check getUploadToken() for completion
 	void createTextureImage(
 		stbi_uc* pixels,
 		int texWidth, 
 		int texHeight, 
 		VkCommandPool commandPool, 
-		std::shared_ptr<Buffer> stagingBuf, 
 		std::shared_ptr<BufferManager> bufferManager
 	);
 
+	//Frees the memory, view and sampler, but keeps format and extent -> createTextureImage() brings it back
+	void evict() {
+		cleanup();
+		imageDetails.currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		residency = TextureResidency::EVICTED;
+	}
+
 	//This functions will full create a depth image from the main script
 	void createDepthImage(VkExtent2D renderTargetExtent);
 
+	//Creates only the VkImage -> memory comes from bindExternalMemory(), used for aliased/transient attachments
+	void createAttachmentImage(VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags);
+	VkMemoryRequirements getMemoryRequirements() const;
+	//Binds memory owned by the caller and creates the view -> cleanup() leaves the memory alone
+	void bindExternalMemory(VkDeviceMemory memory, VkDeviceSize offset);
+
 	void createImage(uint32_t width, uint32_t height,
 		VkImageTiling imageTiling,
 		VkImageUsageFlags usage,
@@ -80,7 +102,7 @@ public:
 	);
 
 	void transitionImageLayout(VkImageLayout newLayout, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager);
-	void copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager);
+	void copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager, VkDeviceSize bufferOffset = 0);
 	void createImageView();
 
 	//Specific texture image util functions
@@ -95,11 +117,46 @@ public:
 	VkSampler getSampler() { return imageSampler; };
 	VkImage getImage() { return image; };
 	ImageDetails getImageDetails() { return imageDetails; };
+	UploadToken getUploadToken() const { return uploadToken; };
+	VkDeviceSize getMemorySize() const { return imageAllocation.size; };
+	uint32_t getMemoryTypeIndex() const { return imageAllocation.memoryTypeIndex; };
+	const MemoryAllocation& getAllocation() const { return imageAllocation; };
+
+	//Exchanges the VkImage, its memory, view and sampler with `other` -> moves a texture without changing its handle
+	void swapStorage(Image& other) {
+		std::swap(image, other.image);
+		std::swap(imageAllocation, other.imageAllocation);
+		std::swap(imageDetails, other.imageDetails);
+		std::swap(imageSampler, other.imageSampler);
+		std::swap(uploadToken, other.uploadToken);
+	}
+
+	// == Residency ==
+	//Stamped while recording draws -> touching a non resident texture requests it back
+	void markUsed(uint64_t frameNumber) {
+		lastUsedFrame = frameNumber;
+		if (residency != TextureResidency::RESIDENT) residencyRequested = true;
+	};
+
+	TextureResidency getResidency() const { return residency; };
+	void setResidency(TextureResidency state) { residency = state; };
+	uint64_t getLastUsedFrame() const { return lastUsedFrame; };
+	bool isResidencyRequested() const { return residencyRequested; };
+	void clearResidencyRequest() { residencyRequested = false; };
+	uint64_t getEvictFrame() const { return evictFrame; };
+	void setEvictFrame(uint64_t frameNumber) { evictFrame = frameNumber; };
+
+	//Pinned images are never evicted(ex. the fallback texture)
+	void setPinned(bool pin) { pinned = pin; };
+	bool isPinned() const { return pinned; };
 
 private:
+	void createImageHandle(uint32_t width, uint32_t height, VkImageUsageFlags usage);
+
 	//Injected Vulkan Core components
 	VkDevice imageLogicalDevice; 
 	VkPhysicalDevice imagePhysicalDevice;
+	std::shared_ptr<MemoryAllocator> imageAllocator;
 	//TODO -> FIX THE SWAPCHAIN FORWARD DECLARATIONS
 	// CLASS IS CALLED "RENDERTARGETER" NOW **
 	// and remember to add resources to build folder, or figure out whats up with that
@@ -108,11 +165,18 @@ private:
 	std::shared_ptr<BufferManager> imageBufferManager;
 
 	//Main variables
-	VkImage image; 
-	VkDeviceMemory imageMemory; 
+	VkImage image = VK_NULL_HANDLE; 
+	MemoryAllocation imageAllocation{}; 
 	ImageDetails imageDetails; 
 
 	VkSampler imageSampler = VK_NULL_HANDLE;
+	UploadToken uploadToken{}; // batch that last wrote this image
+
+	TextureResidency residency = TextureResidency::RESIDENT;
+	uint64_t lastUsedFrame = 0;
+	uint64_t evictFrame = 0; // frame the eviction started on
+	bool residencyRequested = false;
+	bool pinned = false;
 	unsigned short imageErrors = IMG_ERROR_NONE; 
 };
 
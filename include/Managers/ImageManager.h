@@ -4,21 +4,42 @@
 
 #include "Utils/config.h"
 #include "Managers/Image.h"
+#include "Utils/SlotMap.h"
+#include "Utils/LinearArena.h"
 
 //Forward declarations
 class BufferManager; 
 class RenderTargeter;
 
+//Where a texture's pixels come from -> used to reload it after it was evicted
+struct TextureSource {
+	std::string path; // empty -> `pixels` holds a copy of the raw RGBA data
+	std::vector<unsigned char> pixels;
+	int width = 0;
+	int height = 0;
+};
+
+/**
+	* @class ImageManager
+	* @brief Owns every texture and keeps them inside the device memory budget.
+	*
+	* Draw recording stamps textures with the frame they were used in(`markUsed`). Once per frame
+	* `updateResidency` evicts the least recently used textures while the heap(or texture) budget is
+	* exceeded, and reloads evicted textures that were drawn again from their `TextureSource`.
+	*
+	* Evicting is two-step -> the texture first goes EVICTING so every frame in flight can move its
+	* descriptors over to the fallback texture, and its memory is freed MAX_FRAMES_IN_FLIGHT frames later.
+*/
 
 class ImageManager {
 	public: 
-		ImageManager(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<BufferManager>);
+		ImageManager(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<BufferManager>, std::shared_ptr<MemoryAllocator> memoryAllocator);
 
 		//From relative file path
-		void createTextureImage(std::string name, std::string texturePath, VkCommandPool commandPool);
+		ImageHandle createTextureImage(std::string name, std::string texturePath, VkCommandPool commandPool);
 
 		// From raw image data
-		void createTextureImage(
+		ImageHandle createTextureImage(
 			std::string name,
 			std::vector<unsigned char>& pixels,
 			int texWidth,
@@ -27,23 +48,80 @@ class ImageManager {
 		);
 
 		// == Deletion function == 
+		void removeImage(ImageHandle handle);
 		void removeImage(std::string name);
 
+		//Forgets the image now and destroys it once the frames in flight that may sample it have retired
+		void destroyImage(ImageHandle handle);
+
 		// == Retrieval functions ==
+		//O(1) and allocation free, nullptr if the image was removed
+		Image* getImage(ImageHandle handle) const;
+
+		//Name lookups -> setup, debugging and the editor
 		std::shared_ptr<Image> getImage(std::string name);
+		ImageHandle findImage(const std::string& name) const;
 		VkSampler getSampler(std::string name);
 		VkImage getImageHandle(std::string name);
 		ImageDetails getImageDetails(std::string name);
 
+		// == Residency ==
+		//Stamps the texture with the frame it was drawn in, requests it back if it was evicted
+		void markUsed(ImageHandle handle, uint64_t frameNumber);
+
+		//Called once per frame after that frame's fence wait
+		// -> returns the textures whose image view changed(allocated from `arena`), their descriptors need rewriting
+		ArenaVector<ImageHandle> updateResidency(uint64_t frameNumber, VkCommandPool commandPool, LinearArena& arena);
+
+		//Cap on resident texture bytes on top of the heap budget, 0 -> heap budget only
+		void setTextureBudget(VkDeviceSize bytes) { textureBudget = bytes; };
+		//Fraction of a heap's budget usage may reach before textures get evicted
+		void setBudgetFraction(float fraction) { budgetFraction = fraction; };
+
+		//Bound in place of evicted textures, nullptr until the first eviction
+		Image* getFallbackTexture() const { return getImage(fallbackHandle); };
+		VkDeviceSize getResidentTextureBytes() const;
+		void printResidency() const;
+
+		// == Defragmentation ==
+		//Re-uploads the texture from its `TextureSource` into new memory and swaps it in
+		// -> returns the old storage, cleanup() it once no frame in flight can sample it. nullptr if it can't be moved
+		// -> the descriptors are moved over by the next updateResidency(), like a reload
+		std::shared_ptr<Image> relocateImage(ImageHandle handle, VkCommandPool commandPool);
+
+		//Calls func(handle, image) for every live image
+		template<typename Func>
+		void forEachImage(Func&& func) {
+			images.forEach([&](ImageHandle handle, std::shared_ptr<Image>& image) {
+				if (image) func(handle, *image);
+			});
+		}
+
 		void cleanup();
 
 	private: 
-		std::unordered_map<std::string, std::shared_ptr<Image>> images; 
+		ImageHandle addImage(const std::string& name, std::shared_ptr<Image> image);
+
+		bool reloadTexture(ImageHandle handle, Image& image, VkCommandPool commandPool);
+		bool uploadFromSource(ImageHandle handle, Image& image, VkCommandPool commandPool);
+		void evictOverBudget(uint64_t frameNumber, VkCommandPool commandPool, ArenaVector<ImageHandle>& changed);
+		void ensureFallbackTexture(VkCommandPool commandPool);
+
+		SlotMap<std::shared_ptr<Image>, ImageTag> images;
+		std::unordered_map<std::string, ImageHandle> imageNames;
+		std::unordered_map<uint32_t, TextureSource> textureSources; // by handle index, textures without one are never evicted
+
+		std::vector<ImageHandle> relocatedImages; // swapped since the last updateResidency(), descriptors still point at the old view
+
+		ImageHandle fallbackHandle{};
+		VkDeviceSize textureBudget = 0;
+		float budgetFraction = 0.9f;
 
 		VkDevice imageManager_logicalDevice;
 		VkPhysicalDevice imageManager_physicalDevice;
 		std::shared_ptr<RenderTargeter> imageManagerSwapchain;
 		std::shared_ptr<BufferManager> imageManager_bufferManager;
+		std::shared_ptr<MemoryAllocator> imageManager_memoryAllocator;
 };
 
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "Utils/config.h"
 #include "Builders/DescriptorBuilder.h"
+#include "Utils/SlotMap.h"
 
 struct ShaderSet {
     std::string vert; 
@@ -35,9 +36,26 @@ public:
         descriptorSets = sets;
     }
 
+    //Handle into the ImageManager, invalid for materials built from an image the manager doesn't own
+    void setTextureHandle(ImageHandle handle) { textureHandle = handle; };
+
+    //Every frame's descriptor set needs the texture rewritten(it was evicted or reloaded)
+    void markTextureDirty() { textureDirtyMask = (1u << MAX_FRAMES_IN_FLIGHT) - 1; };
+    bool isTextureDirty(uint32_t frame) const { return (textureDirtyMask & (1u << frame)) != 0; };
+    void clearTextureDirty(uint32_t frame) { textureDirtyMask &= ~(1u << frame); };
+
+    //Element of the bindless texture array this material's texture sits in
+    void setTextureSlot(uint32_t slot) { textureSlot = slot; };
+    uint32_t getTextureSlot() const { return textureSlot; };
+
+    //Compact id the draw sort groups materials by, unique per MeshManager
+    void setSortID(uint32_t id) { sortID = id; };
+    uint32_t getSortID() const { return sortID; };
+
     std::shared_ptr<Image> getTextureImage() const { return textureImage; };
+    ImageHandle getTextureHandle() const { return textureHandle; };
     const std::string getName() const { return name; };
-    std::vector<VkDescriptorSet> getDescriptorSets() { return descriptorSets; };
+    const std::vector<VkDescriptorSet>& getDescriptorSets() const { return descriptorSets; };
     const std::shared_ptr<ShaderSet> getShaderSet() const { return shaders; };
 
 private:
@@ -47,6 +65,10 @@ private:
 
     std::string name;
     std::shared_ptr<Image> textureImage;
+    ImageHandle textureHandle{};
+    uint32_t textureSlot = 0;
+    uint32_t sortID = 0;
+    uint32_t textureDirtyMask = 0; // one bit per frame in flight
     const std::shared_ptr<ShaderSet> shaders;
 
     //ONLY USED IF BINDLESS TEXTURES ARE NOT SUPPORTED
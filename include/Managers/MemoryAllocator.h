@@ -0,0 +1,242 @@
+#pragma once
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+#include "Utils/config.h"
+
+//Buffers(linear) and optimal tiling images are kept in separate pools so bufferImageGranularity never has to be checked
+enum class AllocationKind : uint32_t {
+	LINEAR = 0,
+	OPTIMAL = 1
+};
+
+//What a resource's memory is used for, picks the memory type through `MemoryAllocator::selectMemoryType`
+// -> AUTO only requires the properties the caller asked for
+enum class MemoryUsage : uint8_t {
+	AUTO = 0,
+	GPU_ONLY,         // written once through staging, only read by the GPU
+	UPLOAD_PER_FRAME, // rewritten by the CPU every frame and read by the GPU(UBOs, per frame SSBOs)
+	STAGING,          // CPU writes, GPU copies out
+	READBACK          // GPU writes, CPU reads back
+};
+
+//Property flags a usage needs, would like and would rather avoid, on top of what the caller asked for
+struct MemoryPlacement {
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	VkMemoryPropertyFlags notPreferred = 0;
+};
+
+//A single sub-allocation (or dedicated allocation) handed out by the `MemoryAllocator`
+// -> resources bind to `memory` at `offset`
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0; // requested size, not the (power of two) node size
+	uint32_t memoryTypeIndex = 0;
+	void* mappedPtr = nullptr; // already offset into the block, only set for host visible memory
+
+	bool dedicated = false;
+	AllocationKind kind = AllocationKind::LINEAR;
+	uint32_t blockId = 0; // id of the owning block inside its pool
+	uint32_t order = 0; // buddy order of the node backing this allocation
+
+	bool isValid() const { return memory != VK_NULL_HANDLE; };
+};
+
+//Usage stats for a single memory type
+struct MemoryTypeStats {
+	uint32_t memoryTypeIndex = 0;
+	uint32_t heapIndex = 0;
+	VkMemoryPropertyFlags propertyFlags = 0;
+
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;
+
+	VkDeviceSize bytesReserved = 0;  // total VkDeviceMemory allocated from the driver
+	VkDeviceSize bytesAllocated = 0; // bytes handed out(including buddy rounding)
+	VkDeviceSize bytesRequested = 0; // bytes actually asked for by resources
+	VkDeviceSize bytesFree = 0;      // free bytes inside blocks
+	VkDeviceSize largestFreeRange = 0;
+
+	// 0 -> all free space is one contiguous range, approaches 1 as the free space gets split up
+	float fragmentation = 0.0f;
+};
+
+struct MemoryAllocatorStats {
+	std::vector<MemoryTypeStats> memoryTypes; // only types with live memory
+	uint32_t deviceMemoryCount = 0; // live VkDeviceMemory objects
+	VkDeviceSize totalReserved = 0;
+	VkDeviceSize totalAllocated = 0;
+	VkDeviceSize totalRequested = 0;
+};
+
+//Budget and usage of one memory heap
+// -> with VK_EXT_memory_budget these come from the driver(whole process), otherwise budget is a fraction of the heap
+// size and usage is what this allocator has reserved
+struct MemoryHeapBudget {
+	uint32_t heapIndex = 0;
+	VkMemoryHeapFlags flags = 0;
+	VkDeviceSize heapSize = 0;
+	VkDeviceSize budget = 0;
+	VkDeviceSize usage = 0;
+
+	VkDeviceSize allocatorReserved = 0;  // VkDeviceMemory this allocator holds on the heap
+	VkDeviceSize allocatorAllocated = 0; // bytes of that handed out to resources
+	bool fromDriver = false;
+
+	//Free space inside our own blocks can be reused without growing the heap, so it does not count against the budget
+	VkDeviceSize getEffectiveUsage() const {
+		VkDeviceSize reusable = allocatorReserved - allocatorAllocated;
+		return usage > reusable ? usage - reusable : 0;
+	};
+};
+
+/**
+	* @class MemoryAllocator
+	* @brief Sub-allocates buffers and images out of large shared `VkDeviceMemory` blocks.
+	*
+	* Each (memory type, resource kind) pair gets its own pool of fixed size blocks. Blocks are managed with
+	* a buddy allocator, so every node is naturally aligned to its own size, which covers any alignment
+	* the driver asks for up to the block size.
+	*
+	* Requests larger than half a block, or resources the driver prefers dedicated memory for, get their own
+	* `VkDeviceMemory` allocation.
+	*
+	* Host visible blocks are persistently mapped once, so resources must use `MemoryAllocation::mappedPtr`
+	* instead of calling vkMapMemory on the shared memory themselves.
+*/
+class MemoryAllocator {
+public:
+	MemoryAllocator(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024);
+
+	//Queries the resources requirements, allocates memory for it - binding is left to the caller
+	MemoryAllocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryUsage usage = MemoryUsage::AUTO);
+	MemoryAllocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties, MemoryUsage usage = MemoryUsage::AUTO);
+
+	//Raw allocation from already queried requirements
+	MemoryAllocation allocate(
+		const VkMemoryRequirements& memRequirements,
+		VkMemoryPropertyFlags properties,
+		AllocationKind kind,
+		bool dedicated = false,
+		VkBuffer dedicatedBuffer = VK_NULL_HANDLE,
+		VkImage dedicatedImage = VK_NULL_HANDLE,
+		MemoryUsage usage = MemoryUsage::AUTO
+	);
+
+	// == Placement ==
+	//Ranks every allowed memory type for `usage` -> all required flags, then most preferred, fewest not preferred, largest heap
+	// falls back to the plain required `properties` if no type satisfies the usage
+	uint32_t selectMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, MemoryUsage usage) const;
+	static MemoryPlacement getPlacement(MemoryUsage usage, VkMemoryPropertyFlags properties);
+
+	//Device local + host visible heap larger than the legacy 256MB BAR window(resizable BAR or an integrated GPU)
+	bool hasLargeDeviceLocalHostVisible() const { return largeDeviceLocalHostVisible; };
+
+	void free(MemoryAllocation& allocation);
+
+	//Set once bufferDeviceAddress is enabled on the logical device -> buffer memory is allocated with
+	// VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT so buffers created with SHADER_DEVICE_ADDRESS can be bound to it
+	void setBufferDeviceAddressEnabled(bool enabled) { bufferDeviceAddressEnabled = enabled; };
+	bool isBufferDeviceAddressEnabled() const { return bufferDeviceAddressEnabled; };
+
+	// == Budget ==
+	//Set once VK_EXT_memory_budget is enabled on the logical device
+	void setMemoryBudgetSupported(bool supported) { memoryBudgetSupported = supported; };
+	bool isMemoryBudgetSupported() const { return memoryBudgetSupported; };
+
+	//One entry per memory heap, cheap enough to query once per frame
+	std::vector<MemoryHeapBudget> getHeapBudgets();
+	//Same without allocating, fills the first memoryHeapCount entries and returns that count
+	uint32_t getHeapBudgets(std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS>& budgets);
+	uint32_t getHeapIndex(uint32_t memoryTypeIndex) const { return allocator_memProperties.memoryTypes[memoryTypeIndex].heapIndex; };
+
+	// == Defragmentation ==
+	//Marks sparse blocks(less than `maxBlockUsage` of them handed out) as sources, new allocations skip them
+	// -> resources moved out of them end up in denser blocks, a source block is released once its last allocation is freed
+	// -> the densest block of every pool is never a source, so there is always somewhere to move to
+	uint32_t beginDefragmentation(float maxBlockUsage);
+	void endDefragmentation();
+	bool isDefragmenting() const { return defragmenting; };
+	//True if the allocation lives in a block that is being emptied
+	bool isInDefragSource(const MemoryAllocation& allocation);
+
+	//Total VkDeviceMemory held from the driver
+	VkDeviceSize getReservedBytes();
+
+	// == Stats ==
+	MemoryAllocatorStats getStats();
+	void printStats();
+	void printBudgets();
+
+	void cleanup();
+
+private:
+	static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+	//Without VK_EXT_memory_budget assume the driver lets us use this much of each heap
+	static constexpr float FALLBACK_BUDGET_FRACTION = 0.8f;
+	//Without resizable BAR the CPU can only see this much of VRAM
+	static constexpr VkDeviceSize LEGACY_BAR_SIZE = 256ull * 1024 * 1024;
+
+	struct MemoryBlock {
+		uint32_t id = 0;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mappedPtr = nullptr;
+
+		uint32_t maxOrder = 0;
+		std::vector<std::set<VkDeviceSize>> freeLists; // free node offsets per order
+		uint32_t allocationCount = 0;
+		bool defragSource = false; // being emptied, receives no new allocations
+		VkDeviceSize bytesAllocated = 0;
+		VkDeviceSize bytesRequested = 0;
+
+		VkDeviceSize nodeSize(uint32_t order) const { return MIN_NODE_SIZE << order; };
+	};
+
+	struct DedicatedAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+	};
+
+	struct MemoryPool {
+		uint32_t memoryTypeIndex = 0;
+		AllocationKind kind = AllocationKind::LINEAR;
+		VkDeviceSize blockSize = 0;
+		uint32_t nextBlockId = 0;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		std::vector<DedicatedAllocation> dedicatedAllocations;
+	};
+
+	MemoryPool& getPool(uint32_t memoryTypeIndex, AllocationKind kind);
+	MemoryBlock* createBlock(MemoryPool& pool);
+	void destroyBlock(MemoryPool& pool, size_t blockIndex);
+
+	bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+	void freeToBlock(MemoryBlock& block, VkDeviceSize offset, uint32_t order);
+
+	MemoryAllocation allocateDedicated(MemoryPool& pool, VkDeviceSize size, VkBuffer buffer, VkImage image);
+	void* mapIfHostVisible(VkDeviceMemory memory, uint32_t memoryTypeIndex);
+	//Chains VkMemoryAllocateFlagsInfo onto `allocInfo` when buffers in `pool` may need a device address
+	void addAllocateFlags(const MemoryPool& pool, VkMemoryAllocateInfo& allocInfo, VkMemoryAllocateFlagsInfo& flagsInfo) const;
+
+	VkDevice allocator_logicalDevice;
+	VkPhysicalDevice allocator_physicalDevice;
+	VkPhysicalDeviceMemoryProperties allocator_memProperties{};
+	bool supportsDedicatedAllocation = false; // vulkan 1.1+
+	bool memoryBudgetSupported = false;
+	bool largeDeviceLocalHostVisible = false;
+	bool bufferDeviceAddressEnabled = false;
+	bool defragmenting = false;
+
+	VkDeviceSize preferredBlockSize;
+
+	//Indexed by memoryTypeIndex * 2 + kind
+	std::vector<MemoryPool> pools;
+
+	std::mutex allocatorMutex;
+};
+
+#endif
@@ -11,9 +11,12 @@
 #include "Managers/Image.h"
 #include "Managers/Vertex.h"
 #include "Managers/Material.h"
+#include "Managers/GeometryBuffer.h"
 
 #include "Builders/DescriptorBuilder.h"
 
+#include "Utils/FrustumCulling.h"
+
 class Buffer; 
 
 union PipelineKey {
@@ -64,6 +67,11 @@ public:
         material(material),
         primitiveIndex(primitiveIndex)
     {
+        vertexCount = static_cast<uint32_t>(this->vertices.size());
+        indexCount = static_cast<uint32_t>(this->indices.size());
+
+        computeBounds();
+
         registerPipelineKey(
             blendModeID,
             cullModeID,
@@ -74,6 +82,7 @@ public:
     }
 
     //Getters
+    // -> empty once the geometry is uploaded, unless the CPU copy was kept(see setKeepCpuGeometry)
     const std::vector<Vertex>& getVertices() const {
         return vertices;
     }
@@ -82,7 +91,43 @@ public:
         return indices;
     }
 
-    std::shared_ptr<Material> getMaterial() const {
+    //Counts stay valid after the CPU copy is released
+    uint32_t getVertexCount() const { return vertexCount; };
+    uint32_t getIndexCount() const { return indexCount; };
+
+    // == Bounds ==
+    //Object space, computed from the vertices on creation -> kept after the CPU copy is released
+    const glm::vec3& getBoundsMin() const { return boundsMin; };
+    const glm::vec3& getBoundsMax() const { return boundsMax; };
+    //xyz = center, w = radius
+    const glm::vec4& getBoundingSphere() const { return boundingSphere; };
+    //Entry in the mesh manager's `BoundsSoA`
+    void setBoundsIndex(size_t index) { boundsIndex = index; };
+    size_t getBoundsIndex() const { return boundsIndex; };
+
+    // == Instancing ==
+    //Extra model matrix slots the primitive is drawn with(mesh instances), the parent mesh's own slot always is
+    void addInstanceTransform(int transformIndex) { instanceTransforms.push_back(transformIndex); };
+    void removeInstanceTransform(int transformIndex) {
+        instanceTransforms.erase(std::remove(instanceTransforms.begin(), instanceTransforms.end(), transformIndex), instanceTransforms.end());
+    };
+    const std::vector<int>& getInstanceTransforms() const { return instanceTransforms; };
+
+    // == CPU geometry ==
+    //Keep vertices/indices around after upload, e.g. for collision or picking
+    void setKeepCpuGeometry(bool keep) { keepCpuGeometry = keep; };
+    bool keepsCpuGeometry() const { return keepCpuGeometry; };
+    bool hasCpuGeometry() const { return !vertices.empty() || !indices.empty(); };
+
+    //Frees the CPU copy once it lives in the geometry buffer
+    void releaseCpuGeometry() {
+        if (keepCpuGeometry) return;
+
+        std::vector<Vertex>().swap(vertices);
+        std::vector<uint32_t>().swap(indices);
+    }
+
+    const std::shared_ptr<Material>& getMaterial() const {
         return material;
     }
 
@@ -129,10 +174,51 @@ public:
         return meshPipelineKey;
     }
 
+    //Location inside the shared geometry buffers
+    void setGeometryRange(const GeometryRange& range) {
+        geometryRange = range;
+    }
+
+    GeometryRange& getGeometryRange() {
+        return geometryRange;
+    }
+
+    const GeometryRange& getGeometryRange() const {
+        return geometryRange;
+    }
+
 private:
+    void computeBounds() {
+        if (vertices.empty()) return;
+
+        boundsMin = boundsMax = vertices[0].pos;
+        for (const Vertex& vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.pos);
+            boundsMax = glm::max(boundsMax, vertex.pos);
+        }
+
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const Vertex& vertex : vertices) {
+            glm::vec3 offset = vertex.pos - center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+
+        boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+    }
+
     std::string name;
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    bool keepCpuGeometry = false;
+
+    glm::vec3 boundsMin{ 0.0f };
+    glm::vec3 boundsMax{ 0.0f };
+    glm::vec4 boundingSphere{ 0.0f };
+    size_t boundsIndex = 0;
+    std::vector<int> instanceTransforms;
     
     std::shared_ptr<Material> material;
 
@@ -141,7 +227,9 @@ private:
     int parentMeshIndex; 
     std::string parentMeshName; // used to access mesh transform and index from draw loop
 
-    int primitiveIndex; // used to name v + i buffers and access them from the draw loop
+    int primitiveIndex; // used to identify the primitive in logs and load order
+
+    GeometryRange geometryRange; // offsets/counts used to draw from the shared geometry buffers
 };
 
 class Mesh {
@@ -191,12 +279,19 @@ private:
     int meshIndex;
 };
 
+//Another placement of an existing mesh -> shares its primitives, only owns a model matrix slot
+struct MeshInstance {
+    std::string sourceMesh;
+    int transformIndex = -1;
+};
+
 class MeshManager {
 public:
     MeshManager(
         VkDevice logicalDevice, 
         VkPhysicalDevice physicalDevice, 
-        std::shared_ptr<BufferManager> bufferManager
+        std::shared_ptr<BufferManager> bufferManager,
+        std::shared_ptr<ImageManager> imageManager = nullptr
     );
 
     //Model loading functions
@@ -218,7 +313,8 @@ public:
     //Creates a material -> needed to bind to mesh
     void createMaterial(
         std::string name,
-        std::shared_ptr<Image> textureImage
+        std::shared_ptr<Image> textureImage,
+        ImageHandle textureHandle = ImageHandle{}
     );
 
     std::shared_ptr<Primitive> createPrimitive(
@@ -238,6 +334,30 @@ public:
         std::vector<std::shared_ptr<Primitive>> primitives
     );
 
+    //Uploads a primitives vertices and indices into the shared geometry buffers
+    // -> the primitives CPU copy is released afterwards unless it asked to keep it
+    void uploadPrimitiveGeometry(std::shared_ptr<Primitive> primitive, VkCommandPool commandPool);
+
+    //Default for primitives created from now on -> off, geometry only lives on the GPU after upload
+    void setKeepCpuGeometry(bool keep) { keepCpuGeometry = keep; };
+
+    // == Instancing ==
+    //Draws `sourceMeshName` again with its own transform, no geometry is copied and every instance of a
+    // primitive goes out in the same instanced draw. Returns the model matrix slot, -1 on failure
+    // -> the SSBOs grow on each frame's `updateStorageBuffers()` once the slots outgrow them
+    int createMeshInstance(const std::string& instanceName, const std::string& sourceMeshName, const glm::mat4& transform);
+    void removeMeshInstance(const std::string& instanceName);
+    //Moves an instance, every frame in flight picks the matrix up on its next `updateStorageBuffers()`
+    bool setMeshInstanceTransform(const std::string& instanceName, const glm::mat4& transform);
+    const std::unordered_map<std::string, MeshInstance>& getAllMeshInstances() const { return meshInstances; };
+
+    //Removes a mesh right away, its geometry ranges go back to the geometry buffer once the frames drawing it have retired
+    void removeMesh(const std::string& meshName);
+
+    //Removes a material no primitive uses anymore, its texture is destroyed once the frames sampling it have retired
+    // -> descriptor sets stay allocated until the pool is reset
+    bool removeMaterial(const std::string& materialName);
+
     //Model matrix transform method
     void transform(
         std::string meshName, 
@@ -249,12 +369,24 @@ public:
     void createStorageBuffers();
     void createSSBODescriptors(VkDescriptorPool descriptorPool);
 
+    //Called once per frame after its fence wait -> grows this frame's model matrix SSBO if the slots outgrew it
+    // (rewriting its descriptor) and writes the transforms changed since the frame was last recorded
+    void updateStorageBuffers(uint32_t currentFrame);
+
     //Material Descriptor Set up
     void createMaterialDescriptors(
         VkDescriptorPool descriptorPool, 
         Capabilities &deviceCaps
     );
 
+    // == Texture residency ==
+    //Called while recording draws -> stamps the material's texture with the frame it was drawn in
+    void markMaterialUsed(const Material* material, uint64_t frameNumber);
+
+    //Called once per frame after its fence wait -> lets the ImageManager evict/reload textures, then rewrites
+    // this frame's material descriptors that still point at an old view(or at an evicted texture)
+    void updateTextureResidency(uint32_t currentFrame, uint64_t frameNumber, VkCommandPool commandPool, LinearArena& frameArena);
+
     //For loading meshes during rendering
     void queueMeshLoad(std::shared_ptr<Mesh> mesh) {
         std::lock_guard <std::mutex> lock(meshQueueMutex);
@@ -265,9 +397,13 @@ public:
     //Storage buffer set
     const std::unordered_map<std::string, std::shared_ptr<Mesh>>& getAllMeshes() const;
     const std::unordered_map<std::string, std::shared_ptr<Material>>& getAllMaterials() const { return materials; };
-    const std::vector<std::shared_ptr<Primitive>> getAllPrimitives() const { return primitives; };
+    const std::vector<std::shared_ptr<Primitive>>& getAllPrimitives() const { return primitives; };
     //[THIS GETTER IS FOR DEBUGGING, NORMALLY ACCESS MATRICES THROUGH MESH POINTER]
-    const std::vector<glm::mat4> getAllModelMatrices() const { return modelMatrices; };
+    const std::vector<glm::mat4>& getAllModelMatrices() const { return modelMatrices; };
+    //Object space bounds of every primitive ever created, indexed by `Primitive::getBoundsIndex()`
+    const BoundsSoA& getPrimitiveBounds() const { return primitiveBounds; };
+    //Model matrices as this frame's SSBO holds them(transforms are written there), nullptr before createStorageBuffers()
+    const glm::mat4* getFrameModelMatrices(uint32_t frame, size_t& count) const;
     
     const std::shared_ptr<Material> getMaterial(std::string materialName) {
         auto it= materials.find(materialName);
@@ -278,16 +414,22 @@ public:
             std::cerr << "Failed to find material by name : [" << materialName << "]" << std::endl;
         }
     }
-    const std::unordered_map<PipelineKey, std::vector<std::shared_ptr<Primitive>>> getPrimitiveByPipelineKey() const { return primitivesByPipelineKey; };
+    const std::unordered_map<PipelineKey, std::vector<std::shared_ptr<Primitive>>>& getPrimitiveByPipelineKey() const { return primitivesByPipelineKey; };
+
 
+    const std::shared_ptr<GeometryBuffer>& getGeometryBuffer() const { return geometryBuffer; };
 
     //Sets 
-    std::vector<VkDescriptorSet> getSSBODescriptorSets() { return meshDescriptorSets; };
+    const std::vector<VkDescriptorSet>& getSSBODescriptorSets() const { return meshDescriptorSets; };
+    //Bumped on every descriptor set write -> command buffers recorded before it bound stale sets
+    uint64_t getDescriptorVersion() const { return descriptorVersion; };
+    //Model matrix SSBO of a frame in flight, invalid before createStorageBuffers()
+    BufferHandle getStorageBufferHandle(uint32_t frame) const { return frame < storageBufferHandles.size() ? storageBufferHandles[frame] : BufferHandle{}; };
 
     //Set layouts
     VkDescriptorSetLayout getMeshDescriptorSetLayout() { return meshDescriptorSetLayout; };
     VkDescriptorSetLayout getMaterialDescriptorSetLayout() { return materialDescriptorSetLayout; };
-    std::vector<VkDescriptorSet> getMaterialDescriptorSets() { return materialDescriptorSets; };
+    const std::vector<VkDescriptorSet>& getMaterialDescriptorSets() const { return materialDescriptorSets; };
 
     std::shared_ptr<Mesh> getMesh(const std::string& name) const {
         auto it = meshes.find(name);
@@ -320,17 +462,38 @@ private:
 
     //Stores all materials by name
     std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+    uint32_t nextMaterialSortID = 0;
+
+    //Stores mesh instances by name
+    std::unordered_map<std::string, MeshInstance> meshInstances;
 
     //Stores <name, meshIndex> -> meshIndex is index of particular mesh in 'meshes' map
     std::unordered_map<std::string, int> meshIndices;
 
+    //Bounds stored SoA for the culling kernels -> append only, like model matrix slots
+    BoundsSoA primitiveBounds;
+
     //Stores primitives by pipeline key for batched rendering
     std::unordered_map<PipelineKey, std::vector<std::shared_ptr<Primitive>>> primitivesByPipelineKey; 
 
+    //Shared vertex + index buffers for every primitive
+    std::shared_ptr<GeometryBuffer> geometryBuffer;
+    bool keepCpuGeometry = false;
+
+    //Textures are bound through materials, the ImageManager decides which ones are resident
+    std::shared_ptr<ImageManager> meshManager_imageManager;
+    void writeMaterialTexture(const std::shared_ptr<Material>& material, uint32_t currentFrame);
+    uint64_t descriptorVersion = 0;
+
     //SSBO Management
     std::shared_ptr<BufferManager> meshManager_bufferManager;
     std::vector<void*> mappedStorageBufferPtrs;
+    std::vector<BufferHandle> storageBufferHandles; // one per frame in flight
     std::vector<glm::mat4> modelMatrices;
+    std::array<std::vector<int>, MAX_FRAMES_IN_FLIGHT> dirtyTransforms; // slots each frame's SSBO still has to pick up
+    void markTransformDirty(int transformIndex);
+    void growStorageBuffer(uint32_t frame);
+    void writeStorageDescriptor(uint32_t frame);
 
     //Hot-loading queue
     std::mutex meshQueueMutex;
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include "Utils/config.h"
+
+//Fence value of one upload submission -> poll with BufferManager::isUploadComplete() or block with waitForUploads()
+struct UploadToken {
+	uint64_t value = 0; // 0 -> nothing to wait for
+};
+
+//A slice of the staging ring -> copy from `buffer` at `offset`
+struct StagingAllocation {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mappedPtr = nullptr; // already offset into the ring
+};
+
+/**
+	* @class StagingRing
+	* @brief Ring allocator over one persistently mapped staging buffer.
+	*
+	* Slices are handed out in order and tagged with the fence value of the submission that reads them
+	* (`markSubmitted`). Once that fence value is known to be complete (`reclaim`) the space is reused,
+	* so uploads never have to create, map or destroy their own staging buffers.
+	*
+	* The ring does not own the buffer, `BufferManager` creates it and owns the submissions/fences.
+*/
+class StagingRing {
+public:
+	void init(VkBuffer buffer, void* mappedPtr, VkDeviceSize capacity);
+
+	std::optional<StagingAllocation> allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	//Tags every slice not yet submitted with the fence value of the submission reading it
+	void markSubmitted(uint64_t fenceValue);
+	//Frees every slice whose fence value has completed
+	void reclaim(uint64_t completedFenceValue);
+
+	bool hasUnsubmitted() const;
+
+	VkDeviceSize getCapacity() const { return capacity; };
+	VkDeviceSize getBytesInFlight() const;
+
+private:
+	struct RingEntry {
+		VkDeviceSize begin = 0;
+		VkDeviceSize end = 0;
+		uint64_t fenceValue = 0; // 0 -> not submitted yet
+	};
+
+	VkBuffer ringBuffer = VK_NULL_HANDLE;
+	char* ringMappedPtr = nullptr;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize head = 0;
+
+	std::deque<RingEntry> entries;
+	mutable std::mutex ringMutex;
+};
+
+#endif
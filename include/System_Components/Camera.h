@@ -3,6 +3,7 @@
 #define CAMERA_H
 
 #include "Utils/config.h"
+#include "Utils/FrustumCulling.h"
 
 
 //Inject this class into UniformBufferManager, figure out how this math shit works
@@ -31,6 +32,13 @@ public:
         return glm::perspective(glm::radians(fov), aspect, 0.1f, 100.0f);
     }
 
+    //Planes of what `getProjectionMatrix(aspect) * getViewMatrix()` sees, world space
+    Frustum getFrustum(float aspect) const {
+        glm::mat4 proj = getProjectionMatrix(aspect);
+        proj[1][1] *= -1; // same Y flip as the UBO
+        return Frustum::fromMatrix(proj * getViewMatrix());
+    }
+
     glm::vec3 getPosition() const {
         return position;
     }
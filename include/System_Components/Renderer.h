@@ -16,10 +16,13 @@ class MeshManager;
 class BufferManager;
 class DescriptorManager;
 class ImageManager;
+class MemoryAllocator;
 class DebugManager;
+class Defragmenter;
 class ThreadPool;
 class Camera;
 class GUI; 
+struct DrawStats;
 
 // Other system components
 class IO;
@@ -36,6 +39,15 @@ struct MeshRequest {
     std::string sourcePathOrPrefabFlag;
 };
 
+//Headless run -> no window, surface or swapchain, a fixed number of frames into offscreen images
+struct HeadlessSettings {
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t frameCount = 300;
+    uint32_t dumpInterval = 0; // every n-th frame is written out as a PNG, 0 writes none
+    std::string dumpDirectory = "headless_frames";
+};
+
 class Renderer {
 public:
     // Main creation function
@@ -43,12 +55,20 @@ public:
     // Draws a frame
     void draw();
 
+    //Call before createRenderer() -> draw() then renders `settings.frameCount` frames, logs their timings and returns
+    void setHeadless(const HeadlessSettings& settings);
+    bool isHeadless() const { return headless; };
+
+    //Draws and binds of the last recorded frame
+    const DrawStats& getLastDrawStats() const;
+
 
     // == Initializer functions ==
     void initCamera();
     void initInstance();
     void initDevices();
 
+    void initMemoryAllocator();
     void initBufferManager();
     void initImageManager();
 
@@ -70,6 +90,9 @@ public:
     void createMeshesAndMaterials();
     void createMaterial(std::string materialName, std::string pathToImage); // EXPOSED FUNCTION
     void createMesh(std::string meshName, std::string materialName, std::string filePath); // EXPOSED FUNCTION
+    //Places an existing mesh again without copying its geometry -> all placements draw in one instanced call
+    void createMeshInstance(std::string instanceName, std::string sourceMeshName, glm::mat4 transform); // EXPOSED FUNCTION
+    void setMeshInstanceTransform(std::string instanceName, glm::mat4 transform); // EXPOSED FUNCTION
     void loadMeshesToVertexBufferManager();
 
     //Submits a mesh request to the request queue
@@ -78,6 +101,9 @@ public:
     void submitMaterialRequest(const MaterialRequest& request);
     void checkMaterialQueue();
 
+    //Starts compacting device memory, runs a little every frame until the sparse blocks are released
+    void defragmentMemory(float maxBlockUsage = 0.5f);
+
     // == Cleanup == 
     void cleanup();
     void cleanupResources();
@@ -86,6 +112,12 @@ private:
     // Renderer State/Flags
     // sets game/engine state for correct window docking
     bool inGame = true; 
+    bool headless = false;
+    HeadlessSettings headlessSettings;
+
+    //Headless draw loop and frame dumps
+    void drawHeadless();
+    void dumpFrame(uint32_t imageIndex, uint32_t frame);
 
     // Core Vulkan components
     std::shared_ptr<VulkanInstance> instance;
@@ -96,11 +128,13 @@ private:
     // Utility managers
     std::shared_ptr<SwapchainRecreater> swapchainRecreater;
     std::shared_ptr<MeshManager> meshManager;
+    std::shared_ptr<MemoryAllocator> memoryAllocator;
     std::shared_ptr<BufferManager> bufferManager;
     std::shared_ptr<DescriptorManager> descriptorManager;
     std::shared_ptr<ThreadPool> threadPool; 
     std::shared_ptr<ImageManager> imageManager;
     std::shared_ptr<DebugManager> debugManager;
+    std::shared_ptr<Defragmenter> defragmenter;
 
     //material and mesh queues
     std::queue<MaterialRequest> materialQueue;
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef DRAW_SORT_H
+#define DRAW_SORT_H
+
+#include "Utils/config.h"
+#include "Utils/LinearArena.h"
+
+//One draw of the frame's draw list, `index` points back into it
+struct DrawSortEntry {
+	uint64_t key = 0;
+	uint32_t index = 0;
+};
+
+//Binds issued while recording one frame -> "saved" is measured against binding the pipeline(and material) for every draw
+struct DrawStats {
+	uint32_t draws = 0;
+	uint32_t pipelineBinds = 0;
+	uint32_t materialBinds = 0;
+	bool bindsMaterials = false; // false with bindless textures, no per draw material binds to save
+
+	uint32_t getPipelineBindsSaved() const { return draws > pipelineBinds ? draws - pipelineBinds : 0; };
+	uint32_t getMaterialBindsSaved() const { return bindsMaterials && draws > materialBinds ? draws - materialBinds : 0; };
+};
+
+/*
+	64 bit draw keys, most significant field first -> sorting the keys as integers groups draws by state
+	Opaque : [63:62] pass | [61:34] pipeline | [33:20] material | [19:8] primitive | [7:0] depth, front to back
+	Blended: [63:62] pass | [61:46] depth, back to front | [45:18] pipeline | [17:0] material
+	Opaque draws of one primitive end up next to each other -> recordBatchedDraws merges them into one instanced draw,
+	depth only orders the instances of a primitive
+	Blended draws sort on depth before state -> correct compositing wins over fewer binds
+*/
+namespace DrawSort {
+	enum Pass : uint64_t {
+		PASS_OPAQUE = 0,
+		PASS_BLENDED = 1,
+	};
+
+	//Monotonic 16 bit depth -> top bits of the float, so no near/far range is needed(~1% steps)
+	uint16_t quantizeDepth(float depth);
+	//Monotonic 8 bit depth for the opaque key -> 4 exponent + 4 mantissa bits, clamped to 1/16..4096(~6% steps)
+	uint8_t quantizeDepthCoarse(float depth);
+
+	//`pipelineKey` is a packed PipelineKey(28 bits used), `materialID` keeps its low 18 bits(14 for opaque draws)
+	// and `primitiveID` its low 12 -> IDs that alias only cost a merge, never a wrong draw
+	uint64_t makeKey(Pass pass, uint32_t pipelineKey, uint32_t materialID, uint32_t primitiveID, float depth);
+
+	//Stable LSD radix sort on the key, 8 bits per pass -> passes whose byte is the same for every entry are skipped
+	void radixSort(DrawSortEntry* entries, size_t count, LinearArena& arena);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include "Utils/config.h"
+
+//Six normalized planes(xyz = inward normal, w = distance) -> a point p is inside when dot(n, p) + w >= 0 for all of them
+struct Frustum {
+	std::array<glm::vec4, 6> planes{}; // left, right, bottom, top, near, far
+
+	//Gribb/Hartmann extraction from a projection * view matrix, expects 0..1 depth(GLM_FORCE_DEPTH_ZERO_TO_ONE)
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+//Bounding volumes in structure of arrays form -> the culling kernel loads 4/8 of each component at once
+struct BoundsSoA {
+	//Spheres
+	std::vector<float> centerX, centerY, centerZ, radius;
+	//AABBs
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	size_t size() const { return radius.size(); };
+
+	//Returns the index of the new entry
+	size_t push(const glm::vec4& sphere, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void clear();
+};
+
+//Timings of one `benchmarkFrustumCulling()` run
+struct CullBenchmarkResult {
+	size_t objectCount = 0;
+	uint32_t iterations = 0;
+	double scalarMs = 0.0; // average per iteration
+	double simdMs = 0.0;
+	size_t visibleCount = 0;
+	bool resultsMatch = true; // SIMD and scalar kernels agreed on every object
+};
+
+namespace FrustumCulling {
+	//Kernel `cullSpheres()` dispatches to, picked at compile time -> "AVX2", "SSE" or "scalar"
+	const char* getKernelName();
+
+	//Writes 1(visible) or 0 into `visible` for each of the `count` spheres, 8(AVX2)/4(SSE) objects per iteration
+	void cullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+		const float* radius, size_t count, uint8_t* visible);
+
+	//Reference implementation, also handles the tails the SIMD kernels leave over
+	void cullSpheresScalar(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+		const float* radius, size_t count, uint8_t* visible);
+
+	//Culls random spheres with both kernels and logs the timings
+	CullBenchmarkResult benchmarkFrustumCulling(size_t objectCount = 100000, uint32_t iterations = 100);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef LINEAR_ARENA_H
+#define LINEAR_ARENA_H
+
+#include "Utils/config.h"
+
+/**
+	* @class LinearArena
+	* @brief Bump allocator for short lived CPU data, everything it handed out is dropped at once by `reset()`.
+	*
+	* Memory comes from a list of chunks that are kept across resets. When a frame needs more than the
+	* arena holds another chunk is added, and on the next reset all chunks are merged into one big enough
+	* for the whole frame -> after a few frames the arena stops touching the heap entirely.
+	*
+	* Destructors are never run, only trivially destructible data(or containers using `ArenaAllocator`)
+	* belongs in here. Not thread safe, worker threads use their own `getScratchArena()`.
+*/
+class LinearArena {
+public:
+	//Position inside the arena -> `rewind()` to it frees everything allocated since
+	struct Marker {
+		size_t chunkIndex = 0;
+		size_t offset = 0;
+	};
+
+	explicit LinearArena(size_t initialCapacity = 64 * 1024);
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	//Uninitialized storage for `count` objects of T
+	template<typename T>
+	T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "LinearArena never runs destructors");
+		return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	//Frees everything at once, O(1) unless the arena had to grow since the last reset
+	void reset();
+
+	Marker getMarker() const { return { currentChunk, chunks.empty() ? 0 : chunks[currentChunk].offset }; };
+	void rewind(Marker marker);
+
+	size_t getCapacity() const;
+	size_t getBytesUsed() const;
+	size_t getPeakBytesUsed() const { return peakBytesUsed; };
+
+private:
+	struct Chunk {
+		std::unique_ptr<char[]> memory;
+		size_t size = 0;
+		size_t offset = 0;
+	};
+
+	void addChunk(size_t minSize);
+
+	std::vector<Chunk> chunks;
+	size_t currentChunk = 0;
+	size_t peakBytesUsed = 0;
+};
+
+//STL allocator over a `LinearArena` -> deallocate is a no-op, the memory goes away with the arena's next reset
+template<typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	ArenaAllocator(LinearArena& arena) : arena(&arena) {};
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {};
+
+	T* allocate(size_t count) { return static_cast<T*>(arena->allocate(sizeof(T) * count, alignof(T))); };
+	void deallocate(T*, size_t) {};
+
+	LinearArena* getArena() const { return arena; };
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); };
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); };
+
+private:
+	LinearArena* arena;
+};
+
+//[NOTE]: must not outlive the arena's next reset/rewind
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//Per thread arena for temporaries inside a single call, use with `ScratchScope` so nested users don't clobber each other
+LinearArena& getScratchArena();
+
+//Rewinds the scratch arena to where it was when the scope was opened
+class ScratchScope {
+public:
+	ScratchScope() : arena(getScratchArena()), marker(arena.getMarker()) {};
+	~ScratchScope() { arena.rewind(marker); };
+
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	LinearArena& getArena() { return arena; };
+
+private:
+	LinearArena& arena;
+	LinearArena::Marker marker;
+};
+
+#endif
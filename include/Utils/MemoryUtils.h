@@ -7,6 +7,8 @@
 //Finds memory type of the passed in physical device
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 uint32_t verboseFindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+//True if a memory type allowed by typeFilter has ALL of the properties -> ex. checking for lazily allocated memory
+bool hasMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 //Finds the supported image format -> ranks from least to most desirable
 // Eventually this should be fixed to rank devies
@@ -0,0 +1,120 @@
+#pragma once
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include "Utils/config.h"
+
+//Typed index + generation into a `SlotMap` -> a handle to a removed object never resolves, even after its slot is reused
+template<typename Tag>
+struct Handle {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool isValid() const { return index != UINT32_MAX; };
+
+	bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; };
+	bool operator!=(const Handle& other) const { return !(*this == other); };
+};
+
+struct BufferTag;
+struct ImageTag;
+
+using BufferHandle = Handle<BufferTag>;
+using ImageHandle = Handle<ImageTag>;
+
+/**
+	* @class SlotMap
+	* @brief Dense vector of slots with a free list, handed out as generational handles.
+	*
+	* Lookups are a bounds check plus a generation compare, no hashing and no allocation. Removing an
+	* object bumps its slot's generation so any handle still pointing at it resolves to nullptr.
+*/
+template<typename T, typename Tag>
+class SlotMap {
+public:
+	using HandleType = Handle<Tag>;
+
+	HandleType insert(T value) {
+		uint32_t index;
+		if (!freeSlots.empty()) {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			index = static_cast<uint32_t>(slots.size());
+			slots.emplace_back();
+		}
+
+		Slot& slot = slots[index];
+		slot.value = std::move(value);
+		slot.occupied = true;
+		count++;
+
+		HandleType handle{};
+		handle.index = index;
+		handle.generation = slot.generation;
+		return handle;
+	}
+
+	bool remove(HandleType handle) {
+		if (!contains(handle)) return false;
+
+		Slot& slot = slots[handle.index];
+		slot.value = T{};
+		slot.occupied = false;
+		slot.generation++;
+
+		freeSlots.push_back(handle.index);
+		count--;
+		return true;
+	}
+
+	T* get(HandleType handle) {
+		return contains(handle) ? &slots[handle.index].value : nullptr;
+	}
+
+	const T* get(HandleType handle) const {
+		return contains(handle) ? &slots[handle.index].value : nullptr;
+	}
+
+	bool contains(HandleType handle) const {
+		return handle.index < slots.size()
+			&& slots[handle.index].occupied
+			&& slots[handle.index].generation == handle.generation;
+	}
+
+	//Calls func(handle, value) for every live object
+	template<typename Func>
+	void forEach(Func&& func) {
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (!slots[i].occupied) continue;
+
+			HandleType handle{};
+			handle.index = i;
+			handle.generation = slots[i].generation;
+			func(handle, slots[i].value);
+		}
+	}
+
+	void clear() {
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (!slots[i].occupied) continue;
+			remove(HandleType{ i, slots[i].generation });
+		}
+	}
+
+	size_t size() const { return count; };
+
+private:
+	struct Slot {
+		T value{};
+		uint32_t generation = 1; // starts at 1 so a default constructed handle never matches
+		bool occupied = false;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	size_t count = 0;
+};
+
+#endif
@@ -10,6 +10,8 @@ public:
 
     ~ThreadPool();
 
+    size_t getThreadCount() const { return workers.size(); }
+
     template<typename Func, typename... Args>
     auto submit(Func&& f, Args&&... args) -> std::future<decltype(f(args...))> {
         using ReturnType = decltype(f(args...));
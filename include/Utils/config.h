@@ -53,9 +53,14 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
+#include <type_traits>
 #include <limits>
 #include <optional>
 #include <set>
+#include <map>
+#include <deque>
+#include <mutex>
 #include <array>
 #include <string>
 #include <functional>
@@ -12,14 +12,20 @@ struct SwapchainSupportDetails {
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // only set when a family without graphics can transfer
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
 	};
+
+	bool hasDedicatedTransfer() const {
+		return transferFamily.has_value() && transferFamily != graphicsFamily;
+	};
 };
 
 SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 
 // -- Helper functions --
 //This function finds indices of queue families specified in QueueFamilyIndices
+// -> surface may be VK_NULL_HANDLE(headless), presentFamily is the graphics family then
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
\ No newline at end of file
@@ -8,8 +8,9 @@
 /*
 	This function returns a list of required Vulkan extensions(char* strings) for GLFW
 	based on whether validation layers are enabled or not
+	-> headless leaves out GLFW's surface extensions, GLFW is never initialized then
 */
-std::vector<const char*> getRequiredExtensions();
+std::vector<const char*> getRequiredExtensions(bool headless = false);
 
 /* 
 	This is a basic loader function
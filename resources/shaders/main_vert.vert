@@ -45,5 +45,5 @@ void main() {
     fragTangent = tangent; 
     fragBitangent = bitangent; 
 
-    gl_Position = model * ubo.proj * ubo.view * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,428 @@
+#include "../include/Core/GpuCuller.h"
+#include "../include/Core/VulkanDevices.h"
+#include "../include/Core/GraphicsPipeline.h"
+#include "../include/Managers/BufferManager.h"
+#include "../include/Managers/Buffer.h"
+#include "../include/Managers/MeshManager.h"
+#include "../include/Managers/ShaderLoader.h"
+
+static constexpr uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x of cull.comp
+
+GpuCuller::GpuCuller(std::shared_ptr<Devices> devices) : culler_devices(devices) {};
+
+bool GpuCuller::create(VkDescriptorSetLayout uniformSetLayout, ShaderLoader& shaderLoader, VkPipelineCache pipelineCache) {
+	VkDevice logicalDevice = culler_devices->getLogicalDevice();
+	Capabilities caps = culler_devices->getDeviceCaps();
+
+	const std::string shaderPath = "resources/shaders/cull.spv";
+	if (!std::ifstream(shaderPath).good()) {
+		std::cout << "[GpuCuller] Cull shader not found -> GPU culling disabled" << std::endl;
+		return false;
+	}
+
+	// == Set 1 -> candidates, model matrices, commands, draw data, counts ==
+	std::array<VkDescriptorSetLayoutBinding, CULL_BINDING_COUNT> bindings{};
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setLayoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &setLayoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create cull descriptor set layout");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = CULL_BINDING_COUNT * MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create cull descriptor pool");
+	}
+
+	std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> setLayouts;
+	setLayouts.fill(cullSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	allocInfo.pSetLayouts = setLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, cullSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate cull descriptor sets");
+	}
+
+	// == Pipeline ==
+	//Set 0 is the renderer's camera set -> bound with the same dynamic offset as the graphics pass
+	std::array<VkDescriptorSetLayout, 2> pipelineSetLayouts = { uniformSetLayout, cullSetLayout };
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = static_cast<uint32_t>(pipelineSetLayouts.size());
+	layoutInfo.pSetLayouts = pipelineSetLayouts.data();
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create cull pipeline layout");
+	}
+
+	VkShaderModule computeModule = shaderLoader.createShaderModule(logicalDevice, shaderLoader.readShaderFile(shaderPath));
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	VkResult result = vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(logicalDevice, computeModule, nullptr);
+
+	if (result != VK_SUCCESS) {
+		std::cerr << "[GpuCuller] Failed to create cull pipeline: " << result << " -> GPU culling disabled" << std::endl;
+		pipeline = VK_NULL_HANDLE;
+		return false;
+	}
+
+	//Packing needs a GPU written draw count, and a batch has to fit into one multi draw
+	if (caps.supportsDrawIndirectCount && caps.multiDrawIndirect) {
+		drawIndirectCountFunc = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+			vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+
+	std::cout << "[GpuCuller] Created cull pipeline -> "
+		<< (usesDrawCount() ? "compacting with draw indirect count" : "zero instance commands for culled draws") << std::endl;
+	return true;
+}
+
+// == Buffers ==
+void GpuCuller::ensureCapacity(const std::shared_ptr<BufferManager>& bufferManager, uint32_t frameIndex, uint32_t drawCount, uint32_t batchCount) {
+	FrameBuffers& buffers = frameBuffers[frameIndex];
+	const std::string suffix = "_" + std::to_string(frameIndex);
+
+	if (buffers.capacity < drawCount) {
+		uint32_t newCapacity = std::max({ drawCount, buffers.capacity * 2, 256u });
+		std::cout << "[GpuCuller] Growing cull buffers of frame " << frameIndex << " to " << newCapacity << " draws" << std::endl;
+
+		//Only this frame slot used them, and it retired with the fence wait
+		bufferManager->destroyBuffer(buffers.candidates);
+		bufferManager->destroyBuffer(buffers.commands);
+		bufferManager->destroyBuffer(buffers.drawData);
+
+		buffers.candidates = bufferManager->createBuffer(
+			BufferType::GENERIC,
+			"cull_candidates" + suffix,
+			static_cast<VkDeviceSize>(newCapacity) * sizeof(CullCandidate),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			std::nullopt,
+			std::nullopt,
+			MemoryUsage::UPLOAD_PER_FRAME
+		);
+
+		//Written and read by the GPU only
+		buffers.commands = bufferManager->createBuffer(
+			BufferType::GENERIC,
+			"cull_commands" + suffix,
+			static_cast<VkDeviceSize>(newCapacity) * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			std::nullopt,
+			std::nullopt,
+			MemoryUsage::GPU_ONLY
+		);
+
+		buffers.drawData = bufferManager->createBuffer(
+			BufferType::GENERIC,
+			"cull_draw_data" + suffix,
+			static_cast<VkDeviceSize>(newCapacity) * sizeof(DrawData),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			std::nullopt,
+			std::nullopt,
+			MemoryUsage::GPU_ONLY
+		);
+
+		buffers.capacity = newCapacity;
+	}
+
+	if (buffers.countCapacity < batchCount) {
+		uint32_t newCapacity = std::max({ batchCount, buffers.countCapacity * 2, 64u });
+
+		bufferManager->destroyBuffer(buffers.counts);
+		buffers.counts = bufferManager->createBuffer(
+			BufferType::GENERIC,
+			"cull_counts" + suffix,
+			static_cast<VkDeviceSize>(newCapacity) * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			std::nullopt,
+			std::nullopt,
+			MemoryUsage::GPU_ONLY
+		);
+
+		buffers.countCapacity = newCapacity;
+	}
+}
+
+void GpuCuller::writeDescriptors(const std::shared_ptr<BufferManager>& bufferManager, const std::shared_ptr<MeshManager>& meshManager, uint32_t frameIndex) {
+	const FrameBuffers& buffers = frameBuffers[frameIndex];
+
+	//Checked every frame -> growing any of the buffers(model matrices included) needs no extra bookkeeping
+	std::array<BufferHandle, CULL_BINDING_COUNT> handles = {
+		buffers.candidates,
+		meshManager->getStorageBufferHandle(frameIndex),
+		buffers.commands,
+		buffers.drawData,
+		buffers.counts
+	};
+
+	std::array<VkBuffer, CULL_BINDING_COUNT> vkBuffers{};
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; i++) {
+		Buffer* buffer = bufferManager->getBuffer(handles[i]);
+		if (buffer == nullptr) {
+			throw std::runtime_error("Cull buffer " + std::to_string(i) + " is missing");
+		}
+		vkBuffers[i] = buffer->getHandle();
+	}
+
+	//Writing a set invalidates every command buffer that bound it -> keeps reused ones valid while nothing moved
+	if (vkBuffers == writtenBuffers[frameIndex]) return;
+
+	std::array<VkDescriptorBufferInfo, CULL_BINDING_COUNT> bufferInfos{};
+	std::array<VkWriteDescriptorSet, CULL_BINDING_COUNT> writes{};
+
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; i++) {
+		bufferInfos[i].buffer = vkBuffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = cullSets[frameIndex];
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(culler_devices->getLogicalDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	writtenBuffers[frameIndex] = vkBuffers;
+	descriptorVersion++;
+}
+
+// == Recording ==
+ArenaVector<CullBatch> GpuCuller::recordCulling(
+	VkCommandBuffer commandBuffer,
+	uint32_t frameIndex,
+	uint64_t frameNumber,
+	const ArenaVector<DrawItem>& drawList,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	VkDescriptorSet uniformSet,
+	uint32_t uniformOffset,
+	LinearArena& arena,
+	bool bindless
+) {
+	ArenaVector<CullBatch> batches{ ArenaAllocator<CullBatch>(arena) };
+	if (drawList.empty()) return batches;
+
+	//Candidates are staged in the arena first -> the batch count is only known after the walk
+	CullCandidate* candidates = arena.allocateArray<CullCandidate>(drawList.size());
+	uint32_t candidateCount = 0;
+	PipelineKey batchKey{};
+
+	for (const DrawItem& item : drawList) {
+		meshManager->markMaterialUsed(item.material, frameNumber);
+
+		const GeometryRange& range = item.primitive->getGeometryRange();
+		if (!range.resident) continue;
+
+		bool startsBatch = batches.empty()
+			|| !(item.pipelineKey == batchKey)
+			|| (!bindless && item.material != batches.back().material);
+
+		if (startsBatch) {
+			CullBatch batch{};
+			batch.first = candidateCount;
+			batch.index = static_cast<uint32_t>(batches.size());
+			batch.material = item.material;
+			batch.pipelineKey = item.pipelineKey.packed;
+			batches.push_back(batch);
+			batchKey = item.pipelineKey;
+		}
+
+		CullBatch& batch = batches.back();
+
+		CullCandidate& candidate = candidates[candidateCount];
+		candidate.sphere = item.primitive->getBoundingSphere();
+		candidate.indexCount = range.indexCount;
+		candidate.firstIndex = range.firstIndex;
+		candidate.vertexOffset = static_cast<int32_t>(range.vertexOffset);
+		candidate.meshIndex = static_cast<uint32_t>(item.transformIndex);
+		candidate.textureSlot = item.material != nullptr ? item.material->getTextureSlot() : 0;
+		candidate.batchIndex = batch.index;
+		candidate.batchBase = batch.first;
+		candidate.pad = 0;
+
+		batch.count++;
+		candidateCount++;
+	}
+
+	if (candidateCount == 0) return batches;
+
+	ensureCapacity(bufferManager, frameIndex, candidateCount, static_cast<uint32_t>(batches.size()));
+
+	const FrameBuffers& buffers = frameBuffers[frameIndex];
+	Buffer* candidateBuffer = bufferManager->getBuffer(buffers.candidates);
+	Buffer* countsBuffer = bufferManager->getBuffer(buffers.counts);
+	if (candidateBuffer == nullptr || countsBuffer == nullptr || candidateBuffer->getMappedPtr() == nullptr) {
+		std::cerr << "[GpuCuller] Cull buffers unavailable, skipping draws" << std::endl;
+		batches.clear();
+		return batches;
+	}
+
+	memcpy(candidateBuffer->getMappedPtr(), candidates, sizeof(CullCandidate) * candidateCount);
+	writeDescriptors(bufferManager, meshManager, frameIndex);
+
+	//Counters start at 0, only read back as draw counts when compacting
+	vkCmdFillBuffer(commandBuffer, countsBuffer->getHandle(), 0, sizeof(uint32_t) * batches.size(), 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+		&uniformSet, 1, &uniformOffset);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1,
+		&cullSets[frameIndex], 0, nullptr);
+
+	CullPushConstants pushConstants{};
+	pushConstants.candidateCount = candidateCount;
+	pushConstants.compact = usesDrawCount() ? 1u : 0u;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+
+	vkCmdDispatch(commandBuffer, (candidateCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+	//Commands + counts are read as indirect arguments, draw data as an instance rate vertex attribute
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+	return batches;
+}
+
+void GpuCuller::recordDraws(
+	VkCommandBuffer commandBuffer,
+	const ArenaVector<CullBatch>& batches,
+	VkPipelineLayout graphicsLayout,
+	bool bindless,
+	uint32_t frameIndex,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	DrawStats& stats
+) {
+	if (batches.empty()) return;
+
+	const FrameBuffers& buffers = frameBuffers[frameIndex];
+	Buffer* commandsBuffer = bufferManager->getBuffer(buffers.commands);
+	Buffer* drawDataBuffer = bufferManager->getBuffer(buffers.drawData);
+	Buffer* countsBuffer = bufferManager->getBuffer(buffers.counts);
+	if (commandsBuffer == nullptr || drawDataBuffer == nullptr || countsBuffer == nullptr) return;
+
+	Capabilities caps = culler_devices->getDeviceCaps();
+	VkBuffer commandsHandle = commandsBuffer->getHandle();
+	VkBuffer countsHandle = countsBuffer->getHandle();
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	VkBuffer drawDataHandle = drawDataBuffer->getHandle();
+	VkDeviceSize drawDataOffset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &drawDataHandle, &drawDataOffset);
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	const Material* boundMaterial = nullptr;
+
+	for (const CullBatch& batch : batches) {
+		if (batch.count == 0) continue;
+
+		if (batch.pipeline == VK_NULL_HANDLE) continue;
+
+		if (batch.pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
+			boundPipeline = batch.pipeline;
+			stats.pipelineBinds++;
+		}
+
+		//Batches split on key or material -> neighbours can still share the material
+		if (!bindless && batch.material != boundMaterial) {
+			VkDescriptorSet materialSet = batch.material->getDescriptorSets()[frameIndex];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsLayout, 2, 1,
+				&materialSet, 0, nullptr);
+			boundMaterial = batch.material;
+			stats.materialBinds++;
+		}
+
+		//Candidates, the GPU may cull some of them
+		stats.draws += batch.count;
+
+		VkDeviceSize commandOffset = static_cast<VkDeviceSize>(batch.first) * stride;
+
+		if (usesDrawCount()) {
+			//[NOTE]: a batch larger than maxDrawIndirectCount is clamped, no device with multi draw reports a small limit in practice
+			uint32_t maxDraws = std::min(batch.count, caps.maxDrawIndirectCount);
+			drawIndirectCountFunc(commandBuffer, commandsHandle, commandOffset,
+				countsHandle, static_cast<VkDeviceSize>(batch.index) * sizeof(uint32_t), maxDraws, stride);
+		} else if (caps.multiDrawIndirect) {
+			for (uint32_t first = 0; first < batch.count; first += caps.maxDrawIndirectCount) {
+				uint32_t chunk = std::min(batch.count - first, caps.maxDrawIndirectCount);
+				vkCmdDrawIndexedIndirect(commandBuffer, commandsHandle, commandOffset + static_cast<VkDeviceSize>(first) * stride, chunk, stride);
+			}
+		} else {
+			for (uint32_t i = 0; i < batch.count; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, commandsHandle, commandOffset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+			}
+		}
+	}
+}
+
+void GpuCuller::cleanup() {
+	VkDevice logicalDevice = culler_devices->getLogicalDevice();
+
+	if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+	if (pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+	if (descriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+	if (cullSetLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(logicalDevice, cullSetLayout, nullptr);
+
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	cullSetLayout = VK_NULL_HANDLE;
+}
@@ -4,6 +4,11 @@
 #include "../include/Utils/MemoryUtils.h"
 #include "../include/Managers/DescriptorManager.h"
 #include "../include/Managers/MeshManager.h"
+#include "../include/Managers/Defragmenter.h"
+#include "../include/Core/GpuCuller.h"
+#include "../include/Core/PipelineCache.h"
+#include "../include/Utils/ThreadPool.h"
+#include "../include/System_Components/Camera.h"
 #include "../include/System_Components/GUI.h"
 
 void GraphicsPipeline::cleanup() {
@@ -18,7 +23,46 @@ void GraphicsPipeline::cleanup() {
 	}
 	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 
-	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+	//Primaries went with `commandPool`, only the secondaries' pools are left
+	for (std::vector<RecordedFrame>& frames : recordedFrames) {
+		for (RecordedFrame& recorded : frames) {
+			for (RecordSlot& slot : recorded.slots) {
+				vkDestroyCommandPool(logicalDevice, slot.pool, nullptr);
+			}
+		}
+		frames.clear();
+	}
+
+	if (gpuCuller) {
+		gpuCuller->cleanup();
+	}
+
+	//Workers may still be compiling -> their pipelines have to exist before they can be destroyed
+	waitForPipelines();
+	savePipelineManifest();
+
+	//Default pipelines live in the maps as well
+	for (auto* pipelines : { &pipelineByKey, &instancedPipelineByKey }) {
+		for (auto& [key, entry] : *pipelines) {
+			if (entry.pipeline != VK_NULL_HANDLE) vkDestroyPipeline(logicalDevice, entry.pipeline, nullptr);
+		}
+		pipelines->clear();
+	}
+	graphicsPipeline = VK_NULL_HANDLE;
+	instancedPipeline = VK_NULL_HANDLE;
+
+	for (PipelineShaders* shaders : { &mainShaders, &instancedShaders }) {
+		if (shaders->vert != VK_NULL_HANDLE) vkDestroyShaderModule(logicalDevice, shaders->vert, nullptr);
+		if (shaders->frag != VK_NULL_HANDLE) vkDestroyShaderModule(logicalDevice, shaders->frag, nullptr);
+		*shaders = PipelineShaders{};
+	}
+
+	//Everything built this run goes to disk -> the next startup skips compiling it
+	if (pipelineCache) {
+		pipelineCache->save();
+		pipelineCache->cleanup();
+	}
+
 	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
 };
 
@@ -43,23 +87,246 @@ void GraphicsPipeline::createGraphicsPipeline(
 	std::cout << "Loaded vertex shader, size: " << vertShaderCode.size() << std::endl;
 	std::cout << "Loaded fragment shader, size: " << fragShaderCode.size() << std::endl;
 
-	VkShaderModule vertShaderModule = shaderLoader->createShaderModule(logicalDevice, vertShaderCode);
-	VkShaderModule fragShaderModule = shaderLoader->createShaderModule(logicalDevice, fragShaderCode);
+	//Every permutation is built from these -> kept alive until cleanup so new keys can still be built
+	mainShaders.vert = shaderLoader->createShaderModule(logicalDevice, vertShaderCode);
+	mainShaders.frag = shaderLoader->createShaderModule(logicalDevice, fragShaderCode);
 
-	//Now we assign the shaders to the pipeline using PipelineShaderStageCreateInfo
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
+	//Specify per-mesh index passed as push constant
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(int);
+
+	//finally create the pipeline layout -> shared by every permutation
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	layoutInfo.pSetLayouts = descriptorSetLayouts.data(); 
+
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
 
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
+	if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout");
+	};
+
+	std::cout << "[DEBUG] : RENDER PASS HANDLE: " << renderTargeter->getMainPass();
+	mainPass = renderTargeter->getMainPass();
+
+	// == Pipeline cache ==
+	//Every pipeline below goes through it, pipelines built in an earlier run skip compilation
+	pipelineCache = std::make_shared<PipelineCache>(devices);
+	pipelineCache->load(PIPELINE_CACHE_PATH);
+
+	//Built on this thread -> it's the fallback for every permutation still compiling
+	requestPipeline(getDefaultPipelineKey(), false, false);
+	graphicsPipeline = getPipeline(getDefaultPipelineKey(), false);
+
+	if (graphicsPipeline == VK_NULL_HANDLE) {
+		throw std::runtime_error("Failed to create graphics pipeline");
+	};
+
+	std::cout << "Finished creating graphics pipeline" << std::endl;
+
+	//Same state, different shaders and vertex input -> used for instanced and indirect draws
+	createInstancedPipeline();
+
+	//Culling writes commands for the indirect pipeline -> nothing to feed without it
+	if (indirectDrawSupported) {
+		createGpuCuller(descriptorSetLayouts[0]);
+	}
+};
+
+// == Pipeline permutations ==
+//Mirrors the IDs MeshManager stores in the key(glTF primitive modes for topology)
+static VkPrimitiveTopology toVkTopology(uint32_t topology) {
+	switch (topology) {
+	case 0: return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+	case 1: return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+	case 2: return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP; // line loop -> no Vulkan equivalent, drawn open
+	case 3: return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+	case 5: return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	case 6: return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
+	default: return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	}
+}
+
+static VkCullModeFlags toVkCullMode(uint32_t cullMode) {
+	switch (cullMode) {
+	case 0: return VK_CULL_MODE_NONE;
+	case 2: return VK_CULL_MODE_FRONT_BIT;
+	default: return VK_CULL_MODE_BACK_BIT;
+	}
+}
+
+PipelineKey GraphicsPipeline::getDefaultPipelineKey() {
+	PipelineKey key{};
+	key.blendMode = 0;  // opaque
+	key.cullMode = 1;   // back
+	key.depthTest = 1;
+	key.depthWrite = 1;
+	key.topology = 4;   // triangles
+	return key;
+}
+
+VkPipeline GraphicsPipeline::getPipeline(const PipelineKey& key, bool instanced) {
+	auto& pipelines = instanced ? instancedPipelineByKey : pipelineByKey;
+
+	auto it = pipelines.find(key);
+	if (it == pipelines.end()) {
+		requestPipeline(key, instanced, true);
+		it = pipelines.find(key);
+	}
+
+	PipelineEntry& entry = it->second;
+	if (entry.pending.valid()) {
+		//Still compiling -> never stall the frame on it
+		if (entry.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return getFallbackPipeline(key, instanced);
+		}
+		entry.pipeline = entry.pending.get();
+	}
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+	//Failures are stored too(as null) so a broken key isn't rebuilt every frame
+	if (entry.pipeline != VK_NULL_HANDLE) return entry.pipeline;
+
+	return getFallbackPipeline(key, instanced);
+}
+
+void GraphicsPipeline::requestPipeline(const PipelineKey& key, bool instanced, bool async) {
+	auto& pipelines = instanced ? instancedPipelineByKey : pipelineByKey;
+	if (pipelines.find(key) != pipelines.end()) return;
+
+	PipelineEntry entry{};
+	if (async && workerPool) {
+		//Everything createPipelineForKey() reads is fixed after createGraphicsPipeline() and the cache is
+		// internally synchronized -> safe to build on a worker
+		entry.pending = workerPool->submit([this, key, instanced]() {
+			return createPipelineForKey(key, instanced);
+		});
+	} else {
+		entry.pipeline = createPipelineForKey(key, instanced);
+	}
+
+	pipelines.emplace(key, std::move(entry));
+}
+
+VkPipeline GraphicsPipeline::getFallbackPipeline(const PipelineKey& key, bool instanced) const {
+	//The default state only stands in for other triangle lists -> lines/points are skipped until theirs is ready
+	if (key.topology != getDefaultPipelineKey().topology) return VK_NULL_HANDLE;
+
+	return instanced ? instancedPipeline : graphicsPipeline;
+}
+
+bool GraphicsPipeline::bindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipeline& boundPipeline, DrawStats& stats) const {
+	if (pipeline == VK_NULL_HANDLE) return false;
+
+	if (pipeline != boundPipeline) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		boundPipeline = pipeline;
+		stats.pipelineBinds++;
+	}
+	return true;
+}
+
+size_t GraphicsPipeline::getPendingPipelineCount() const {
+	size_t pending = 0;
+	for (const auto* pipelines : { &pipelineByKey, &instancedPipelineByKey }) {
+		for (const auto& [key, entry] : *pipelines) {
+			if (entry.pending.valid()) pending++;
+		}
+	}
+	return pending;
+}
+
+void GraphicsPipeline::waitForPipelines() {
+	for (auto* pipelines : { &pipelineByKey, &instancedPipelineByKey }) {
+		for (auto& [key, entry] : *pipelines) {
+			if (entry.pending.valid()) entry.pipeline = entry.pending.get();
+		}
+	}
+}
+
+void GraphicsPipeline::preparePipelines(const std::shared_ptr<MeshManager>& meshManager) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Keys seen in earlier sessions plus the ones the loaded scene uses, all compiled in parallel
+	std::vector<std::pair<PipelineKey, bool>> keys = loadPipelineManifest();
+	for (const auto& [pipelineKey, primitivesVector] : meshManager->getPrimitiveByPipelineKey()) {
+		keys.emplace_back(pipelineKey, false);
+		keys.emplace_back(pipelineKey, true);
+	}
+
+	for (const auto& [key, instanced] : keys) {
+		if (instanced && instancedPipeline == VK_NULL_HANDLE) continue;
+		requestPipeline(key, instanced, true);
+	}
+
+	//Startup is the one place waiting is fine -> nothing known so far hitches on first use
+	waitForPipelines();
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "[GraphicsPipeline] " << pipelineByKey.size() + instancedPipelineByKey.size() << " pipeline permutations ready in "
+		<< ms << " ms" << (pipelineCache->loadedFromDisk() ? " (cache loaded from disk)" : "") << std::endl;
+}
+
+std::vector<std::pair<PipelineKey, bool>> GraphicsPipeline::loadPipelineManifest() const {
+	std::vector<std::pair<PipelineKey, bool>> keys;
+
+	std::ifstream file(PIPELINE_MANIFEST_PATH);
+	if (!file.is_open()) return keys;
+
+	//One "<packed key> <instanced>" pair per line
+	uint32_t packed = 0;
+	int instanced = 0;
+	while (file >> packed >> instanced) {
+		PipelineKey key{};
+		key.packed = packed;
+		keys.emplace_back(key, instanced != 0);
+	}
+
+	std::cout << "[GraphicsPipeline] Warming " << keys.size() << " pipelines from [" << PIPELINE_MANIFEST_PATH << "]" << std::endl;
+	return keys;
+}
+
+void GraphicsPipeline::savePipelineManifest() const {
+	std::ofstream file(PIPELINE_MANIFEST_PATH, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "[GraphicsPipeline] Failed to open [" << PIPELINE_MANIFEST_PATH << "] for writing" << std::endl;
+		return;
+	}
+
+	//Only keys that built -> a permutation the driver rejects isn't retried every startup
+	for (const auto* pipelines : { &pipelineByKey, &instancedPipelineByKey }) {
+		bool instanced = pipelines == &instancedPipelineByKey;
+		for (const auto& [key, entry] : *pipelines) {
+			if (entry.pipeline != VK_NULL_HANDLE) {
+				file << key.packed << " " << (instanced ? 1 : 0) << "\n";
+			}
+		}
+	}
+}
+
+VkPipeline GraphicsPipeline::createPipelineForKey(const PipelineKey& key, bool instanced) {
+	VkDevice logicalDevice = devices->getLogicalDevice();
+	const PipelineShaders& shaders = instanced ? instancedShaders : mainShaders;
+
+	if (shaders.vert == VK_NULL_HANDLE || shaders.frag == VK_NULL_HANDLE) {
+		return VK_NULL_HANDLE;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Now we assign the shaders to the pipeline using PipelineShaderStageCreateInfo
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = shaders.vert;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = shaders.frag;
+	shaderStages[1].pName = "main";
 
 	//Create dynamic state create info struct 
 	VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -67,22 +334,37 @@ void GraphicsPipeline::createGraphicsPipeline(
 	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
 	dynamicState.pDynamicStates = dynamicStates.data();
 
-	//Get per-vertex binding and attribute descriptions
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescription = Vertex::getAttributeDescriptions();
+	//Binding 0 -> per vertex data, binding 1(instanced only) -> one DrawData per instance, location 5 in the vertex shader
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+	bindingDescriptions[0] = Vertex::getBindingDescription();
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(DrawData);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	auto vertexAttributes = Vertex::getAttributeDescriptions();
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+
+	if (instanced) {
+		VkVertexInputAttributeDescription drawDataAttribute{};
+		drawDataAttribute.binding = 1;
+		drawDataAttribute.location = 5;
+		drawDataAttribute.format = VK_FORMAT_R32G32_UINT;
+		drawDataAttribute.offset = 0;
+		attributeDescriptions.push_back(drawDataAttribute);
+	}
 
 	//Specifies vertex data to be drawn
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
+	vertexInputInfo.vertexBindingDescriptionCount = instanced ? 2 : 1;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	//Specifies how input vertices should be assembled
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.topology = toVkTopology(key.topology);
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 	VkPipelineViewportStateCreateInfo viewportState{};
@@ -96,7 +378,7 @@ void GraphicsPipeline::createGraphicsPipeline(
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
 	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.cullMode = toVkCullMode(key.cullMode);
 	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	rasterizer.depthBiasEnable = VK_FALSE;
 
@@ -108,16 +390,22 @@ void GraphicsPipeline::createGraphicsPipeline(
 
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE;
 	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.stencilTestEnable = VK_FALSE;
 
-	//specifies how color blending will work
+	//specifies how color blending will work -> blend mode 2(BLEND) is standard alpha blending, MASK stays opaque
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
 	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
+	colorBlendAttachment.blendEnable = key.blendMode == 2 ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
 	VkPipelineColorBlendStateCreateInfo colorBlending{};
 	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -130,31 +418,10 @@ void GraphicsPipeline::createGraphicsPipeline(
 	colorBlending.blendConstants[2] = 0.0f;
 	colorBlending.blendConstants[3] = 0.0f;
 
-	//Specify per-mesh index passed as push constant
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(int);
-
-	//finally create the pipeline layout 
-	VkPipelineLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-	layoutInfo.pSetLayouts = descriptorSetLayouts.data(); 
-
-	layoutInfo.pushConstantRangeCount = 1;
-	layoutInfo.pPushConstantRanges = &pushConstantRange;
-
-	if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
-	};
-
-	std::cout << "[DEBUG] : RENDER PASS HANDLE: " << renderTargeter->getMainPass();
-
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2; 
-	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineInfo.pStages = shaderStages.data();
 	//reference all the stages of the pipeline
 	pipelineInfo.pVertexInputState = &vertexInputInfo; 
 	pipelineInfo.pInputAssemblyState = &inputAssembly;
@@ -165,22 +432,85 @@ void GraphicsPipeline::createGraphicsPipeline(
 	pipelineInfo.pDepthStencilState = &depthStencil; 
 	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = pipelineLayout; 
-	pipelineInfo.renderPass = renderTargeter->getMainPass();
+	pipelineInfo.renderPass = mainPass;
 	pipelineInfo.subpass = 0; //specify subpass index where pipeline will be used
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	VkResult result = vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(logicalDevice, pipelineCache->getCache(), 1, &pipelineInfo, nullptr, &pipeline);
 
 	if (result != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create graphics pipeline: error: " + std::to_string(result));
-	};
+		std::cerr << "[GraphicsPipeline] Failed to create pipeline for key " << key.packed << (instanced ? " (instanced)" : "")
+			<< ": " << result << std::endl;
+		return VK_NULL_HANDLE;
+	}
 
-	std::cout << "Finished creating graphics pipeline -> result : " << result << std::endl;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "[GraphicsPipeline] Built pipeline for key " << key.packed << (instanced ? " (instanced)" : "")
+		<< " in " << ms << " ms" << std::endl;
 
-	//Delete shader modules
-	vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
-	vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
-};
+	return pipeline;
+}
+
+void GraphicsPipeline::createInstancedPipeline() {
+	VkDevice logicalDevice = devices->getLogicalDevice();
+	Capabilities caps = devices->getDeviceCaps();
+
+	const std::string vertPath = "resources/shaders/vert_indirect.spv";
+	const std::string fragPath = caps.supportsBindless ? "resources/shaders/frag_indirect.spv" : "resources/shaders/frag_traditional.spv";
+
+	if (!std::ifstream(vertPath).good() || !std::ifstream(fragPath).good()) {
+		std::cout << "[GraphicsPipeline] Indirect shaders not found -> instancing and indirect drawing disabled" << std::endl;
+		return;
+	}
+
+	instancedShaders.vert = shaderLoader->createShaderModule(logicalDevice, shaderLoader->readShaderFile(vertPath));
+	instancedShaders.frag = shaderLoader->createShaderModule(logicalDevice, shaderLoader->readShaderFile(fragPath));
+
+	requestPipeline(getDefaultPipelineKey(), true, false);
+	instancedPipeline = getPipeline(getDefaultPipelineKey(), true);
+
+	if (instancedPipeline == VK_NULL_HANDLE) {
+		std::cerr << "[GraphicsPipeline] Failed to create instanced pipeline -> instancing and indirect drawing disabled" << std::endl;
+		return;
+	}
+
+	//firstInstance of a direct draw is always honoured, indirect commands need the feature for it
+	indirectDrawSupported = caps.drawIndirectFirstInstance;
+	indirectDrawEnabled = indirectDrawSupported;
+	std::cout << "[GraphicsPipeline] Created instanced pipeline, indirect: " << (indirectDrawSupported ? "yes" : "no")
+		<< ", multi draw: " << (caps.multiDrawIndirect ? "yes" : "no") << std::endl;
+}
+
+void GraphicsPipeline::setIndirectDraw(bool enable) {
+	if (enable && !indirectDrawSupported) {
+		std::cerr << "[GraphicsPipeline] Indirect drawing is not available on this device" << std::endl;
+		return;
+	}
+
+	indirectDrawEnabled = enable;
+}
+
+void GraphicsPipeline::createGpuCuller(VkDescriptorSetLayout uniformSetLayout) {
+	auto culler = std::make_shared<GpuCuller>(devices);
+
+	if (!culler->create(uniformSetLayout, *shaderLoader, pipelineCache->getCache())) {
+		culler->cleanup();
+		return;
+	}
+
+	gpuCuller = culler;
+	gpuCullingEnabled = true;
+}
+
+void GraphicsPipeline::setGpuCulling(bool enable) {
+	if (enable && !gpuCuller) {
+		std::cerr << "[GraphicsPipeline] GPU culling is not available on this device" << std::endl;
+		return;
+	}
+
+	gpuCullingEnabled = enable;
+}
 
 void GraphicsPipeline::createCommandPool() {
 	//Define variables used to create command pool
@@ -273,6 +603,28 @@ void GraphicsPipeline::drawOffscreen(
 	// Wait for frame fence
 	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+	//Everything this frame built last time around has retired with its fence
+	frameArenas[currentFrame].reset();
+
+	//Give back staging space of uploads that finished since the last frame, and submit anything
+	// recorded since then so it lands ahead of this frame on the queue
+	bufferManager->reclaimStaging();
+
+	//Resources released while this frame slot was in flight can go now
+	bufferManager->getDeletionQueue().flush(frameNumber);
+
+	//Moves a bounded amount of memory out of sparse blocks, frees what frames in flight no longer use
+	if (defragmenter) {
+		defragmenter->step(frameNumber, commandPool);
+	}
+
+	//Model matrices changed or added since this frame slot last ran, then textures -> evicts/reloads them and
+	// points this frame's material descriptors at whatever is resident now
+	meshManager->updateStorageBuffers(currentFrame);
+	meshManager->updateTextureResidency(currentFrame, frameNumber, commandPool, frameArenas[currentFrame]);
+
+	bufferManager->flushUploads();
+
 	//[DEBUG]
 	std::cout << "\n=== BEGIN FRAME " << currentFrame << " ===" << std::endl;
 	std::cout << "Framebuffer resized: " << framebufferResized << std::endl;
@@ -328,6 +680,7 @@ void GraphicsPipeline::drawOffscreen(
 	// NO PRESENTATION AFTER QUEUE SUBMISSION
 
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
 
 	std::cout << "=== END FRAME " << currentFrame << " ===\n" << std::endl;
 }
@@ -341,8 +694,6 @@ void GraphicsPipeline::drawSwapchain(GLFWwindow* window,
 	const std::shared_ptr<GUI>& gui,
 	const std::shared_ptr<RenderTargeter>& renderTargeter) {
 
-	std::cout << "[GraphicsPipeline::drawSwapchain] entered" << std::endl;
-
 	VkDevice logicalDevice = devices->getLogicalDevice();
 
 	//Render Target info
@@ -350,9 +701,36 @@ void GraphicsPipeline::drawSwapchain(GLFWwindow* window,
 	VkExtent2D extent = renderTarget.extent;
 
 	// Wait for frame fence
-	std::cout << "[GraphicsPipeline::drawSwapchain] -fr{"<<  currentFrame << "} Waiting on in-flight fence" << std::endl;
 	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+	//Everything this frame built last time around has retired with its fence
+	frameArenas[currentFrame].reset();
+
+	//Give back staging space of uploads that finished since the last frame, and submit anything
+	// recorded since then so it lands ahead of this frame on the queue
+	bufferManager->reclaimStaging();
+
+	//Resources released while this frame slot was in flight can go now
+	bufferManager->getDeletionQueue().flush(frameNumber);
+
+	//Moves a bounded amount of memory out of sparse blocks, frees what frames in flight no longer use
+	if (defragmenter) {
+		bool wasRunning = defragmenter->isRunning();
+		defragmenter->step(frameNumber, commandPool);
+
+		//Moved buffers get new handles -> nothing recorded before(or during) the pass may be submitted again
+		if (wasRunning || defragmenter->isRunning()) {
+			invalidateRecordedFrames();
+		}
+	}
+
+	//Model matrices changed or added since this frame slot last ran, then textures -> evicts/reloads them and
+	// points this frame's material descriptors at whatever is resident now
+	meshManager->updateStorageBuffers(currentFrame);
+	meshManager->updateTextureResidency(currentFrame, frameNumber, commandPool, frameArenas[currentFrame]);
+
+	bufferManager->flushUploads();
+
 	//Aquire next image
 	uint32_t imageIndex = 0;
 
@@ -373,11 +751,9 @@ void GraphicsPipeline::drawSwapchain(GLFWwindow* window,
 	}
 
 	// Reset fence & command buffer
-	std::cout << "[GraphicsPipeline::drawSwaphchain] Reset inFlightFence -fr:{" << currentFrame << "}" << std::endl;
 	vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
-	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 
-	recordFullDraw(commandBuffers[currentFrame], imageIndex, descriptorManager, bufferManager, meshManager, gui, renderTargeter);
+	VkCommandBuffer commandBuffer = recordFullDraw(imageIndex, descriptorManager, bufferManager, meshManager, gui, renderTargeter);
 
 	// Submit commands
 	VkSubmitInfo submitInfo{};
@@ -392,7 +768,7 @@ void GraphicsPipeline::drawSwapchain(GLFWwindow* window,
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+	submitInfo.pCommandBuffers = &commandBuffer;
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[imageIndex] };
 	submitInfo.signalSemaphoreCount = 1;
@@ -423,13 +799,159 @@ void GraphicsPipeline::drawSwapchain(GLFWwindow* window,
 	}
 
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
+}
 
-	std::cout << "=== END FRAME " << currentFrame << " ===\n" << std::endl;
+uint32_t GraphicsPipeline::drawHeadless(
+	const std::shared_ptr<DescriptorManager>& descriptorManager,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<GUI>& gui,
+	const std::shared_ptr<RenderTargeter>& renderTargeter,
+	FrameTiming& timing
+) {
+	VkDevice logicalDevice = devices->getLogicalDevice();
+	RenderTarget& renderTarget = renderTargeter->getRenderTarget();
+
+	if (renderTarget.images.empty()) {
+		throw std::runtime_error("Headless render target has no images");
+	}
+
+	// Wait for frame fence
+	auto waitStart = std::chrono::high_resolution_clock::now();
+	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	auto waitEnd = std::chrono::high_resolution_clock::now();
+
+	//Same per frame housekeeping as `drawSwapchain()`
+	frameArenas[currentFrame].reset();
+	bufferManager->reclaimStaging();
+	bufferManager->getDeletionQueue().flush(frameNumber);
+
+	if (defragmenter) {
+		bool wasRunning = defragmenter->isRunning();
+		defragmenter->step(frameNumber, commandPool);
+
+		if (wasRunning || defragmenter->isRunning()) {
+			invalidateRecordedFrames();
+		}
+	}
+
+	meshManager->updateStorageBuffers(currentFrame);
+	meshManager->updateTextureResidency(currentFrame, frameNumber, commandPool, frameArenas[currentFrame]);
+
+	bufferManager->flushUploads();
+
+	//No swapchain to acquire from -> images are used round robin with the frames in flight, so with at least
+	// MAX_FRAMES_IN_FLIGHT of them the fence just waited on also retired this image's last use
+	uint32_t imageIndex = currentFrame % static_cast<uint32_t>(renderTarget.images.size());
+
+	vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
+
+	VkCommandBuffer commandBuffer = recordFullDraw(imageIndex, descriptorManager, bufferManager, meshManager, gui, renderTargeter);
+
+	//Nothing to wait on or signal, the fence is all a headless frame needs
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (vkQueueSubmit(devices->getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit draw command buffer");
+	}
+
+	auto submitEnd = std::chrono::high_resolution_clock::now();
+
+	timing.fenceWaitMs = std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+	timing.cpuMs = std::chrono::duration<double, std::milli>(submitEnd - waitEnd).count();
+	timing.commandBufferReused = lastFrameReused;
+
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
+
+	return imageIndex;
+}
+
+void GraphicsPipeline::readbackImage(
+	uint32_t imageIndex,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	const std::shared_ptr<RenderTargeter>& renderTargeter,
+	std::vector<uint8_t>& pixels
+) {
+	RenderTarget& renderTarget = renderTargeter->getRenderTarget();
+	if (imageIndex >= renderTarget.images.size()) {
+		throw std::runtime_error("Readback image index out of range");
+	}
+
+	VkExtent2D extent = renderTarget.extent;
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	if (readbackSize < size) {
+		if (readbackSize > 0) {
+			bufferManager->destroyBuffer(readbackBuffer);
+		}
+
+		readbackBuffer = bufferManager->createBuffer(
+			BufferType::GENERIC,
+			"headless_readback",
+			size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			std::nullopt,
+			std::nullopt,
+			MemoryUsage::READBACK
+		);
+		readbackSize = size;
+	}
+
+	Buffer* buffer = bufferManager->getBuffer(readbackBuffer);
+	if (buffer == nullptr || buffer->getMappedPtr() == nullptr) {
+		throw std::runtime_error("Headless readback buffer is not host visible");
+	}
+
+	//Same queue as the frame and submitted after it -> the barrier alone orders the copy behind its render pass
+	VkCommandBuffer commandBuffer = bufferManager->beginOneTimeCommands(commandPool);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // main pass' final layout when headless
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = renderTarget.images[imageIndex];
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, renderTarget.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		buffer->getHandle(), 1, &region);
+
+	VkMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+	//Blocks until the copy finished
+	bufferManager->endOneTimeCommands(commandBuffer, commandPool);
+
+	pixels.resize(static_cast<size_t>(size));
+	memcpy(pixels.data(), buffer->getMappedPtr(), static_cast<size_t>(size));
 }
 
 //For in game
-void GraphicsPipeline::recordFullDraw(
-	VkCommandBuffer commandBuffer,
+VkCommandBuffer GraphicsPipeline::recordFullDraw(
 	uint32_t imageIndex,
 	const std::shared_ptr<DescriptorManager>& descriptorManager,
 	const std::shared_ptr<BufferManager>& bufferManager,
@@ -437,10 +959,60 @@ void GraphicsPipeline::recordFullDraw(
 	const std::shared_ptr<GUI>& gui,
 	const std::shared_ptr<RenderTargeter>& renderTargeter
 ) {
-	std::cout << "[CmdBuf] Recording 'full-draw' commandBuffer for imageIndex: " << imageIndex << std::endl;
-
 	RenderTarget& renderTarget = renderTargeter->getRenderTarget();
 	VkExtent2D extent = renderTarget.extent;
+	VkFramebuffer framebuffer = renderTarget.mainFramebuffers[imageIndex];
+
+	//Update camera per-frame -> written into this frame's slice of the dynamic uniform buffer
+	// -> dynamic data, a reused command buffer picks it up as is
+	uint32_t uniformOffset = descriptorManager->updateUniformBuffer(currentFrame, renderTarget.extent);
+	VkDescriptorSet uniformSet = descriptorManager->getDescriptorSet();
+
+	ArenaVector<DrawItem> drawList = buildDrawList(meshManager, frameArenas[currentFrame]);
+	const bool bindless = devices->getDeviceCaps().supportsDescriptorIndexing;
+
+	// === GPU Culling ===
+	//Compute can't run inside a render pass -> commands are written before it begins
+	const bool gpuCulling = indirectDrawEnabled && gpuCullingEnabled;
+
+	// === CPU Culling ===
+	if (!gpuCulling && cpuCullingEnabled) {
+		float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+		cullDrawList(drawList, meshManager, descriptorManager->getCamera()->getFrustum(aspect), frameArenas[currentFrame]);
+	}
+
+	// === Draw Sorting ===
+	//After culling -> only visible draws are sorted, before GPU culling -> its batches follow the sorted order
+	sortDrawList(drawList, meshManager, descriptorManager->getCamera()->getPosition(), frameArenas[currentFrame]);
+
+	//Pipelines resolved and materials marked up front -> neither is safe from the recording workers
+	DrawRecordContext context = prepareDrawRecording(drawList, meshManager, bufferManager, extent, uniformSet, uniformOffset,
+		bindless, gpuCulling, frameArenas[currentFrame]);
+
+	//GPU culled draws are a handful of indirect calls, not worth splitting
+	const uint32_t chunkCount = gpuCulling ? 1 : getRecordChunkCount(context.count);
+
+	// === Command Buffer Reuse ===
+	uint64_t signature = computeRecordSignature(context, framebuffer, gpuCulling, chunkCount, meshManager, bufferManager);
+	RecordedFrame& recorded = getRecordedFrame(imageIndex);
+
+	//Same draws, pipelines, descriptors and buffers as when it was recorded, and this frame's indirect buffers
+	// still hold what it reads -> submit it again as is
+	lastFrameReused = commandReuseEnabled && recorded.valid
+		&& recorded.signature == signature && frameBufferSignatures[currentFrame] == signature;
+	if (lastFrameReused) {
+		return recorded.commandBuffer;
+	}
+
+	VkCommandBuffer commandBuffer = recorded.commandBuffer;
+	recorded.valid = false;
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	//This frame's fence was waited on -> the secondaries it executed last time are done
+	resetRecordSlots(recorded.slots);
+
+	drawStats = DrawStats{};
+	drawStats.bindsMaterials = !bindless;
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -449,6 +1021,12 @@ void GraphicsPipeline::recordFullDraw(
 		throw std::runtime_error("Failed to begin recording command buffer");
 	}
 
+	ArenaVector<CullBatch> cullBatches{ ArenaAllocator<CullBatch>(frameArenas[currentFrame]) };
+	if (gpuCulling) {
+		cullBatches = gpuCuller->recordCulling(commandBuffer, currentFrame, frameNumber, drawList, meshManager, bufferManager,
+			uniformSet, uniformOffset, frameArenas[currentFrame], bindless);
+	}
+
 	// === Main Render Pass ===
 	{
 		//gui->beginFrame(currentFrame);
@@ -457,7 +1035,7 @@ void GraphicsPipeline::recordFullDraw(
 		VkRenderPassBeginInfo renderPassBeginInfo{};
 		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderPassBeginInfo.renderPass = renderTargeter->getMainPass();
-		renderPassBeginInfo.framebuffer = renderTarget.mainFramebuffers[imageIndex];
+		renderPassBeginInfo.framebuffer = framebuffer;
 		renderPassBeginInfo.renderArea = { {0, 0}, extent };
 
 		std::array<VkClearValue, 2> clearValues{};
@@ -466,64 +1044,24 @@ void GraphicsPipeline::recordFullDraw(
 		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-		VkViewport viewport{};
-		viewport.width = static_cast<float>(extent.width);
-		viewport.height = static_cast<float>(extent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor{ {0, 0}, extent };
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		// === Descriptor Sets Binding ===
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-			&descriptorManager->getDescriptorSets()[currentFrame], 0, nullptr);
-
-		//Update camera per-frame
-		descriptorManager->updateUniformBuffer(currentFrame, renderTargeter->getRenderTarget().extent); 
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+			chunkCount > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-		//Bind mesh transform descriptor sets
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
-			&meshManager->getSSBODescriptorSets()[currentFrame], 0, nullptr);
-
-		// == Draw Primitives == 
-		const auto& primitives = meshManager->getPrimitiveByPipelineKey(); 
-
-		// === Draw Meshes ===
-		if (devices->getDeviceCaps().supportsDescriptorIndexing) {
-			std::cout << "USING INDEXING\n" 
-				<< "material sets: " << meshManager->getMaterialDescriptorSets().size() << std::endl;
-			VkDescriptorSet bindlessMatSet = meshManager->getMaterialDescriptorSets()[currentFrame];
-
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1,
-				&bindlessMatSet, 0, nullptr);
-
-			// Draws all primitives within the same pipeline key
-			for (const auto& [pipelineKey, primitivesVector] : primitives) {
-				for (const auto& primitive : primitivesVector) {
-					drawPrimitive(commandBuffer, bufferManager, primitive, true);
-				};
-			};
+		if (chunkCount > 1) {
+			recordDrawsParallel(commandBuffer, framebuffer, recorded.slots, context, chunkCount, meshManager, bufferManager);
 		} else {
-			std::cout << "NO INDEXING" << std::endl;
-			std::cout << "model matrices count before draw: " << meshManager->getAllModelMatrices().size() << std::endl;
-
-
-			for (const auto& [pipelineKey, primitivesVector] : primitives) {
-				for (const auto& primitive : primitivesVector) {
-					VkDescriptorSet materialSet = primitive->getMaterial()->getDescriptorSets()[currentFrame];
-
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1,
-						&materialSet, 0, nullptr);
-
-					drawPrimitive(commandBuffer, bufferManager, primitive, true);
+			bindPassState(commandBuffer, context, meshManager, drawStats);
+
+			if (gpuCulling) {
+				//Batches whose pipeline is still compiling(and has no fallback) keep a null pipeline and are skipped
+				for (CullBatch& batch : cullBatches) {
+					PipelineKey key{};
+					key.packed = batch.pipelineKey;
+					batch.pipeline = getPipeline(key, true);
 				}
+				gpuCuller->recordDraws(commandBuffer, cullBatches, pipelineLayout, bindless, currentFrame, bufferManager, drawStats);
+			} else {
+				recordDrawRange(commandBuffer, context, 0, context.count, meshManager, bufferManager, drawStats);
 			}
 		}
 
@@ -535,6 +1073,14 @@ void GraphicsPipeline::recordFullDraw(
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to record command buffer");
 	}
+
+	//Recording may have grown buffers or rewritten the cull set -> store what was actually recorded against
+	signature = computeRecordSignature(context, framebuffer, gpuCulling, chunkCount, meshManager, bufferManager);
+	recorded.signature = signature;
+	recorded.valid = true;
+	frameBufferSignatures[currentFrame] = signature;
+
+	return commandBuffer;
 }
 
 ////For offscreen editor view
@@ -742,48 +1288,684 @@ void GraphicsPipeline::recordOffscreenDraw(VkCommandBuffer commandBuffer,
 //	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
 //}
 
-void GraphicsPipeline::drawPrimitive(
+ArenaVector<DrawItem> GraphicsPipeline::buildDrawList(const std::shared_ptr<MeshManager>& meshManager, LinearArena& arena) const {
+	const auto& primitivesByKey = meshManager->getPrimitiveByPipelineKey();
+
+	size_t primitiveCount = 0;
+	for (const auto& [pipelineKey, primitivesVector] : primitivesByKey) {
+		for (const auto& primitive : primitivesVector) {
+			primitiveCount += 1 + primitive->getInstanceTransforms().size();
+		}
+	}
+
+	ArenaVector<DrawItem> drawList{ ArenaAllocator<DrawItem>(arena) };
+	drawList.reserve(primitiveCount);
+
+	//Map order keeps primitives of the same pipeline key next to each other
+	for (const auto& [pipelineKey, primitivesVector] : primitivesByKey) {
+		for (const auto& primitive : primitivesVector) {
+			DrawItem item{};
+			item.primitive = primitive.get();
+			item.material = primitive->getMaterial().get();
+			item.pipelineKey = pipelineKey;
+			item.transformIndex = primitive->getParentMeshIndex();
+			drawList.push_back(item);
+
+			//Instances right behind the primitive -> merged into one instanced draw
+			for (int transformIndex : primitive->getInstanceTransforms()) {
+				item.transformIndex = transformIndex;
+				drawList.push_back(item);
+			}
+		}
+	}
+
+	return drawList;
+}
+
+//Bounding sphere of a draw in world space -> xyz center, w radius
+static glm::vec4 getWorldSphere(const DrawItem& item, const BoundsSoA& bounds, const glm::mat4* modelMatrices, size_t matrixCount) {
+	size_t boundsIndex = item.primitive->getBoundsIndex();
+	glm::vec3 center(bounds.centerX[boundsIndex], bounds.centerY[boundsIndex], bounds.centerZ[boundsIndex]);
+	float radius = bounds.radius[boundsIndex];
+
+	int meshIndex = item.transformIndex;
+	if (modelMatrices != nullptr && meshIndex >= 0 && static_cast<size_t>(meshIndex) < matrixCount) {
+		const glm::mat4& model = modelMatrices[meshIndex];
+		center = glm::vec3(model * glm::vec4(center, 1.0f));
+		radius *= std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+	}
+
+	return glm::vec4(center, radius);
+}
+
+// == Draw sorting ==
+void GraphicsPipeline::sortDrawList(
+	ArenaVector<DrawItem>& drawList,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const glm::vec3& cameraPosition,
+	LinearArena& arena
+) const {
+	const size_t drawCount = drawList.size();
+	if (drawCount < 2) return;
+
+	const BoundsSoA& bounds = meshManager->getPrimitiveBounds();
+	size_t matrixCount = 0;
+	const glm::mat4* modelMatrices = meshManager->getFrameModelMatrices(currentFrame, matrixCount);
+
+	DrawSortEntry* entries = arena.allocateArray<DrawSortEntry>(drawCount);
+	for (size_t i = 0; i < drawCount; i++) {
+		const DrawItem& item = drawList[i];
+
+		//BLEND(2) is the only mode createPipelineForKey() blends with
+		DrawSort::Pass pass = item.pipelineKey.blendMode == 2 ? DrawSort::PASS_BLENDED : DrawSort::PASS_OPAQUE;
+		uint32_t materialID = item.material != nullptr ? item.material->getSortID() : 0;
+		float depth = glm::length(glm::vec3(getWorldSphere(item, bounds, modelMatrices, matrixCount)) - cameraPosition);
+
+		uint32_t primitiveID = static_cast<uint32_t>(item.primitive->getPrimitiveIndex());
+
+		entries[i].key = DrawSort::makeKey(pass, item.pipelineKey.packed, materialID, primitiveID, depth);
+		entries[i].index = static_cast<uint32_t>(i);
+	}
+
+	DrawSort::radixSort(entries, drawCount, arena);
+
+	//Gather through a copy -> items are trivially copyable arena data
+	DrawItem* unsorted = arena.allocateArray<DrawItem>(drawCount);
+	memcpy(unsorted, drawList.data(), sizeof(DrawItem) * drawCount);
+	for (size_t i = 0; i < drawCount; i++) {
+		drawList[i] = unsorted[entries[i].index];
+	}
+}
+
+// == CPU culling ==
+void GraphicsPipeline::cullDrawList(
+	ArenaVector<DrawItem>& drawList,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const Frustum& frustum,
+	LinearArena& arena
+) const {
+	const size_t drawCount = drawList.size();
+	if (drawCount == 0) return;
+
+	const BoundsSoA& bounds = meshManager->getPrimitiveBounds();
+	size_t matrixCount = 0;
+	const glm::mat4* modelMatrices = meshManager->getFrameModelMatrices(currentFrame, matrixCount);
+
+	//World space spheres of this frame's draws, SoA so the kernel can load 8 at a time
+	float* centerX = arena.allocateArray<float>(drawCount);
+	float* centerY = arena.allocateArray<float>(drawCount);
+	float* centerZ = arena.allocateArray<float>(drawCount);
+	float* radius = arena.allocateArray<float>(drawCount);
+	uint8_t* visible = arena.allocateArray<uint8_t>(drawCount);
+
+	for (size_t i = 0; i < drawCount; i++) {
+		glm::vec4 sphere = getWorldSphere(drawList[i], bounds, modelMatrices, matrixCount);
+		centerX[i] = sphere.x;
+		centerY[i] = sphere.y;
+		centerZ[i] = sphere.z;
+		radius[i] = sphere.w;
+	}
+
+	FrustumCulling::cullSpheres(frustum, centerX, centerY, centerZ, radius, drawCount, visible);
+
+	//Compact in place -> keeps the order buildDrawList produced
+	size_t kept = 0;
+	for (size_t i = 0; i < drawCount; i++) {
+		if (visible[i]) {
+			drawList[kept++] = drawList[i];
+		}
+	}
+	drawList.resize(kept);
+}
+
+// == Indirect drawing ==
+void GraphicsPipeline::ensureIndirectCapacity(const std::shared_ptr<BufferManager>& bufferManager, uint32_t drawCount) {
+	IndirectBuffers& frameBuffers = indirectBuffers[currentFrame];
+	if (frameBuffers.capacity >= drawCount) return;
+
+	uint32_t newCapacity = std::max({ drawCount, frameBuffers.capacity * 2, 256u });
+	std::cout << "[GraphicsPipeline] Growing indirect buffers of frame " << currentFrame << " to " << newCapacity << " draws" << std::endl;
+
+	//Only this frame slot used them, and it retired with the fence wait -> the deletion queue is just being safe
+	bufferManager->destroyBuffer(frameBuffers.commands);
+	bufferManager->destroyBuffer(frameBuffers.drawData);
+
+	frameBuffers.commands = bufferManager->createBuffer(
+		BufferType::GENERIC,
+		"indirect_commands_" + std::to_string(currentFrame),
+		static_cast<VkDeviceSize>(newCapacity) * sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::UPLOAD_PER_FRAME
+	);
+
+	frameBuffers.drawData = bufferManager->createBuffer(
+		BufferType::GENERIC,
+		"indirect_draw_data_" + std::to_string(currentFrame),
+		static_cast<VkDeviceSize>(newCapacity) * sizeof(DrawData),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::UPLOAD_PER_FRAME
+	);
+
+	frameBuffers.capacity = newCapacity;
+}
+
+void GraphicsPipeline::recordBatchedDraws(
 	VkCommandBuffer commandBuffer,
-	const std::shared_ptr<BufferManager>& bufferManager, 
-	const std::shared_ptr<Primitive> primitivePtr, 
-	bool usePushConstant // pass in the parentMeshIndex -> NOT THE ACTUAL PRIMTIVE INDEX
+	const DrawRecordContext& context,
+	size_t first,
+	size_t count,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	DrawStats& stats
+) {
+	if (count == 0) return;
+
+	Buffer* commandsBuffer = bufferManager->getBuffer(indirectBuffers[currentFrame].commands);
+	Buffer* drawDataBuffer = bufferManager->getBuffer(indirectBuffers[currentFrame].drawData);
+	if (commandsBuffer == nullptr || drawDataBuffer == nullptr || commandsBuffer->getMappedPtr() == nullptr || drawDataBuffer->getMappedPtr() == nullptr) {
+		std::cerr << "[GraphicsPipeline] Indirect buffers unavailable, skipping draws" << std::endl;
+		return;
+	}
+
+	//Slots [first, first + count) of the commands and draw data belong to this range -> parallel chunks never share one
+	VkDrawIndexedIndirectCommand* commands = context.commands + first;
+	auto* drawData = static_cast<DrawData*>(drawDataBuffer->getMappedPtr()) + first;
+	const uint32_t base = static_cast<uint32_t>(first);
+
+	Capabilities caps = devices->getDeviceCaps();
+	VkBuffer commandsHandle = commandsBuffer->getHandle();
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	VkBuffer drawDataHandle = drawDataBuffer->getHandle();
+	VkDeviceSize drawDataOffset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &drawDataHandle, &drawDataOffset);
+
+	//Commands [batchStart, commandCount) share a pipeline key(and a material without bindless)
+	uint32_t commandCount = 0;
+	uint32_t instanceCount = 0; // draw data entries written
+	uint32_t batchStart = 0;
+	PipelineKey batchKey{};
+	VkPipeline batchPipeline = VK_NULL_HANDLE;
+	VkPipeline boundPipeline = graphicsPipeline;
+	const Material* batchMaterial = nullptr;
+	const Material* boundMaterial = nullptr;
+	const Primitive* runPrimitive = nullptr;
+	uint32_t batchItems = 0; // draw list entries in the current batch
+
+	auto submitBatch = [&]() {
+		uint32_t batchCommands = commandCount - batchStart;
+		if (batchCommands == 0) return;
+
+		//Batches split on the key -> at most one bind per batch, skipped while its pipeline compiles
+		if (!bindPipeline(commandBuffer, batchPipeline, boundPipeline, stats)) return;
+
+		//A new pipeline key can keep the material of the batch before it
+		if (!context.bindless && batchMaterial != boundMaterial) {
+			VkDescriptorSet materialSet = batchMaterial->getDescriptorSets()[currentFrame];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1,
+				&materialSet, 0, nullptr);
+			boundMaterial = batchMaterial;
+			stats.materialBinds++;
+		}
+
+		stats.draws += batchItems;
+
+		if (!context.useIndirect) {
+			for (uint32_t i = batchStart; i < commandCount; i++) {
+				const VkDrawIndexedIndirectCommand& command = commands[i];
+				vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+			}
+		} else if (caps.multiDrawIndirect) {
+			for (uint32_t chunkFirst = batchStart; chunkFirst < commandCount; chunkFirst += caps.maxDrawIndirectCount) {
+				uint32_t chunk = std::min(commandCount - chunkFirst, caps.maxDrawIndirectCount);
+				vkCmdDrawIndexedIndirect(commandBuffer, commandsHandle, static_cast<VkDeviceSize>(base + chunkFirst) * stride, chunk, stride);
+			}
+		} else {
+			for (uint32_t i = batchStart; i < commandCount; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, commandsHandle, static_cast<VkDeviceSize>(base + i) * stride, 1, stride);
+			}
+		}
+	};
+
+	for (size_t i = first; i < first + count; i++) {
+		const DrawItem& item = context.items[i];
+
+		const GeometryRange& range = item.primitive->getGeometryRange();
+		if (!range.resident) continue;
+
+		//firstInstance doubles as the index into the draw data, instances of a primitive follow each other
+		drawData[instanceCount].meshIndex = static_cast<uint32_t>(item.transformIndex);
+		drawData[instanceCount].textureSlot = item.material != nullptr ? item.material->getTextureSlot() : 0;
+
+		//Same primitive as the previous draw -> one more instance of it
+		if (item.primitive == runPrimitive) {
+			commands[commandCount - 1].instanceCount++;
+			instanceCount++;
+			batchItems++;
+			continue;
+		}
+
+		bool startsBatch = commandCount == batchStart
+			|| !(item.pipelineKey == batchKey)
+			|| (!context.bindless && item.material != batchMaterial);
+
+		if (startsBatch) {
+			submitBatch();
+			batchStart = commandCount;
+			batchKey = item.pipelineKey;
+			batchPipeline = context.pipelines[i];
+			batchMaterial = item.material;
+			batchItems = 0;
+		}
+
+		VkDrawIndexedIndirectCommand& command = commands[commandCount];
+		command.indexCount = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.vertexOffset = static_cast<int32_t>(range.vertexOffset);
+		command.firstInstance = base + instanceCount;
+
+		runPrimitive = item.primitive;
+		commandCount++;
+		instanceCount++;
+		batchItems++;
+	}
+
+	//The GPU reads the commands once the batch is submitted, which is after this copy
+	if (context.useIndirect) {
+		memcpy(static_cast<VkDrawIndexedIndirectCommand*>(commandsBuffer->getMappedPtr()) + first, commands,
+			sizeof(VkDrawIndexedIndirectCommand) * commandCount);
+	}
+
+	submitBatch();
+}
+
+// == Recording ==
+GraphicsPipeline::DrawRecordContext GraphicsPipeline::prepareDrawRecording(
+	const ArenaVector<DrawItem>& drawList,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	VkExtent2D extent,
+	VkDescriptorSet uniformSet,
+	uint32_t uniformOffset,
+	bool bindless,
+	bool gpuCulled,
+	LinearArena& arena
 ) {
-	int primitiveIndex = primitivePtr->getPrimitiveIndex();
-	int meshIndex = primitivePtr->getParentMeshIndex();
+	DrawRecordContext context{};
+	context.extent = extent;
+	context.uniformSet = uniformSet;
+	context.uniformOffset = uniformOffset;
+	context.bindless = bindless;
+	if (drawList.empty()) return context;
+
+	context.items = drawList.data();
+	context.count = drawList.size();
+	context.batched = instancedPipeline != VK_NULL_HANDLE;
+	context.useIndirect = context.batched && indirectDrawEnabled;
+
+	//Sorted list -> consecutive draws mostly share a key and material, only changes hit the maps
+	VkPipeline* pipelines = arena.allocateArray<VkPipeline>(context.count);
+	PipelineKey lastKey = getDefaultPipelineKey();
+	VkPipeline lastPipeline = getPipeline(lastKey, context.batched);
+	const Material* lastMaterial = nullptr;
+
+	for (size_t i = 0; i < context.count; i++) {
+		const DrawItem& item = drawList[i];
+
+		if (!(item.pipelineKey == lastKey)) {
+			lastKey = item.pipelineKey;
+			lastPipeline = getPipeline(lastKey, context.batched);
+		}
+		pipelines[i] = lastPipeline;
 
-	//[debug]
-	int safeIndex = 0;
-	int testIndex = 1; 
+		if (item.material != lastMaterial) {
+			meshManager->markMaterialUsed(item.material, frameNumber);
+			lastMaterial = item.material;
+		}
+	}
+	context.pipelines = pipelines;
 
-	std::cout << "Drawing primitive : prim" << primitiveIndex << "\n with mesh index " << meshIndex << std::endl;
+	//The culler writes its own commands
+	if (context.batched && !gpuCulled) {
+		ensureIndirectCapacity(bufferManager, static_cast<uint32_t>(context.count));
+		//Built in the arena -> copied out for indirect draws, read back for direct ones
+		context.commands = arena.allocateArray<VkDrawIndexedIndirectCommand>(context.count);
+	}
+
+	return context;
+}
 
-	std::shared_ptr<Buffer> vbuf = bufferManager->getBuffer("vbuf" + std::to_string(primitiveIndex));
-	std::shared_ptr<Buffer> ibuf = bufferManager->getBuffer("ibuf" + std::to_string(primitiveIndex));
+void GraphicsPipeline::bindPassState(
+	VkCommandBuffer commandBuffer,
+	const DrawRecordContext& context,
+	const std::shared_ptr<MeshManager>& meshManager,
+	DrawStats& stats
+) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	stats.pipelineBinds++;
+
+	VkViewport viewport{};
+	viewport.width = static_cast<float>(context.extent.width);
+	viewport.height = static_cast<float>(context.extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{ {0, 0}, context.extent };
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// === Descriptor Sets Binding ===
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+		&context.uniformSet, 1, &context.uniformOffset);
+
+	//Bind mesh transform descriptor sets
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
+		&meshManager->getSSBODescriptorSets()[currentFrame], 0, nullptr);
+
+	// Every primitive lives in the shared geometry buffers, bind once for the whole list
+	meshManager->getGeometryBuffer()->bind(commandBuffer);
+
+	if (context.bindless) {
+		VkDescriptorSet bindlessMatSet = meshManager->getMaterialDescriptorSets()[currentFrame];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1,
+			&bindlessMatSet, 0, nullptr);
+	}
+}
 
-	if (!vbuf || !ibuf) {
-		std::cerr << "Missing buffers for prim: " << primitiveIndex << std::endl;
+void GraphicsPipeline::recordDrawRange(
+	VkCommandBuffer commandBuffer,
+	const DrawRecordContext& context,
+	size_t first,
+	size_t count,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<BufferManager>& bufferManager,
+	DrawStats& stats
+) {
+	if (context.batched) {
+		recordBatchedDraws(commandBuffer, context, first, count, bufferManager, stats);
 		return;
-	} else {
-		std::cout << "vbuf addr: " << vbuf->getHandle() << "\n"
-			<< "ibuf addr: " << ibuf->getHandle() << std::endl;
 	}
 
-	VkBuffer vertexBuffer = vbuf->getHandle();
-	VkBuffer indexBuffer = ibuf->getHandle();
-	auto indices = ibuf->getData<uint32_t>();
+	VkPipeline boundPipeline = graphicsPipeline;
+	const Material* boundMaterial = nullptr;
 
-	VkBuffer vertexBuffers[] = { vertexBuffer };
-	VkDeviceSize offsets[] = { 0 };
+	for (size_t i = first; i < first + count; i++) {
+		const DrawItem& item = context.items[i];
+		if (!bindPipeline(commandBuffer, context.pipelines[i], boundPipeline, stats)) continue;
 
-	if (usePushConstant) {
-		std::cout << "Mesh index to push: " << meshIndex << std::endl;
+		//Sorted by material inside each pipeline -> only rebound when it changes
+		if (!context.bindless && item.material != boundMaterial) {
+			VkDescriptorSet materialSet = item.material->getDescriptorSets()[currentFrame];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1,
+				&materialSet, 0, nullptr);
+			boundMaterial = item.material;
+			stats.materialBinds++;
+		}
+
+		drawPrimitive(commandBuffer, *item.primitive, true, item.transformIndex);
+		stats.draws++;
+	}
+}
+
+uint32_t GraphicsPipeline::getRecordChunkCount(size_t drawCount) const {
+	if (!parallelRecordingEnabled || !workerPool) return 1;
+
+	//The pool is shared with pipeline compiles -> a chunk queued behind one would stall the frame, record inline until they're done
+	if (getPendingPipelineCount() > 0) return 1;
+
+	//One per worker plus the recording thread, which takes a chunk itself
+	// -> rounded down, so every chunk keeps at least RECORD_CHUNK_MIN_DRAWS draws
+	size_t slotCount = workerPool->getThreadCount() + 1;
+	size_t chunks = std::max<size_t>(drawCount / RECORD_CHUNK_MIN_DRAWS, 1);
+	return static_cast<uint32_t>(std::min(chunks, slotCount));
+}
+
+void GraphicsPipeline::recordDrawsParallel(
+	VkCommandBuffer commandBuffer,
+	VkFramebuffer framebuffer,
+	std::vector<RecordSlot>& slots,
+	const DrawRecordContext& context,
+	uint32_t chunkCount,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<BufferManager>& bufferManager
+) {
+	if (slots.size() < chunkCount) {
+		createRecordSlots(slots, chunkCount);
+	}
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = mainPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	//Per frame scratch comes from the frame arena -> recording allocates nothing once the arena has grown
+	LinearArena& arena = frameArenas[currentFrame];
+	DrawStats* chunkStats = arena.allocateArray<DrawStats>(chunkCount);
+	std::fill(chunkStats, chunkStats + chunkCount, DrawStats{});
+	const size_t chunkSize = (context.count + chunkCount - 1) / chunkCount;
+
+	//Nothing but the slot's own pool and buffer is written -> bind state is set up again in every secondary
+	auto recordChunk = [&](uint32_t chunk) {
+		VkCommandBuffer secondary = slots[chunk].commandBuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		//No one time submit -> the primary executing it may be reused while the draws don't change
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording secondary command buffer");
+		}
+
+		size_t first = std::min(context.count, static_cast<size_t>(chunk) * chunkSize);
+		size_t count = std::min(chunkSize, context.count - first);
+
+		bindPassState(secondary, context, meshManager, chunkStats[chunk]);
+		recordDrawRange(secondary, context, first, count, meshManager, bufferManager, chunkStats[chunk]);
+
+		if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record secondary command buffer");
+		}
+	};
+
+	//Chunk 0 is recorded here while the workers take the rest
+	ArenaVector<std::future<void>> pending{ ArenaAllocator<std::future<void>>(arena) };
+	pending.reserve(chunkCount - 1);
+	for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+		pending.push_back(workerPool->submit([&recordChunk, chunk]() { recordChunk(chunk); }));
+	}
+	recordChunk(0);
+
+	//get() rethrows a worker's exception here
+	for (std::future<void>& future : pending) {
+		future.get();
+	}
+
+	VkCommandBuffer* secondaries = arena.allocateArray<VkCommandBuffer>(chunkCount);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+		secondaries[chunk] = slots[chunk].commandBuffer;
+
+		drawStats.draws += chunkStats[chunk].draws;
+		drawStats.pipelineBinds += chunkStats[chunk].pipelineBinds;
+		drawStats.materialBinds += chunkStats[chunk].materialBinds;
+	}
+
+	vkCmdExecuteCommands(commandBuffer, chunkCount, secondaries);
+}
 
+void GraphicsPipeline::createRecordSlots(std::vector<RecordSlot>& slots, size_t slotCount) {
+	VkDevice logicalDevice = devices->getLogicalDevice();
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(devices->getPhysicalDevice(), instance->getSurface());
+
+	size_t first = slots.size();
+	slots.resize(slotCount);
+
+	for (size_t i = first; i < slotCount; i++) {
+		RecordSlot& slot = slots[i];
+
+		//Reset as a whole whenever its primary is re-recorded -> no per buffer reset flag
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+		if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &slot.pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create recording command pool");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = slot.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate secondary command buffer");
+		}
+	}
+}
+
+void GraphicsPipeline::resetRecordSlots(std::vector<RecordSlot>& slots) {
+	VkDevice logicalDevice = devices->getLogicalDevice();
+	for (RecordSlot& slot : slots) {
+		vkResetCommandPool(logicalDevice, slot.pool, 0);
+	}
+}
+
+// == Command buffer reuse ==
+GraphicsPipeline::RecordedFrame& GraphicsPipeline::getRecordedFrame(uint32_t imageIndex) {
+	std::vector<RecordedFrame>& frames = recordedFrames[currentFrame];
+	if (frames.size() <= imageIndex) {
+		frames.resize(imageIndex + 1);
+	}
+
+	RecordedFrame& recorded = frames[imageIndex];
+	if (recorded.commandBuffer == VK_NULL_HANDLE) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(devices->getLogicalDevice(), &allocInfo, &recorded.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate command buffer");
+		}
+	}
+
+	return recorded;
+}
+
+void GraphicsPipeline::invalidateRecordedFrames() {
+	for (std::vector<RecordedFrame>& frames : recordedFrames) {
+		for (RecordedFrame& recorded : frames) {
+			recorded.valid = false;
+		}
+	}
+}
+
+static void hashCombine(uint64_t& hash, uint64_t value) {
+	hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+}
+
+template<typename Handle>
+static uint64_t handleBits(Handle handle) {
+	//Dispatchable handles are pointers, non dispatchable ones 64 bit integers on 32 bit builds
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+}
+
+static uint64_t handleBits(uint64_t handle) {
+	return handle;
+}
+
+uint64_t GraphicsPipeline::computeRecordSignature(
+	const DrawRecordContext& context,
+	VkFramebuffer framebuffer,
+	bool gpuCulling,
+	uint32_t chunkCount,
+	const std::shared_ptr<MeshManager>& meshManager,
+	const std::shared_ptr<BufferManager>& bufferManager
+) const {
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	//Pass state
+	hashCombine(hash, handleBits(framebuffer));
+	hashCombine(hash, handleBits(mainPass));
+	hashCombine(hash, (static_cast<uint64_t>(context.extent.width) << 32) | context.extent.height);
+	hashCombine(hash, handleBits(context.uniformSet));
+	hashCombine(hash, context.uniformOffset);
+	hashCombine(hash, (context.bindless ? 1 : 0) | (context.batched ? 2 : 0) | (context.useIndirect ? 4 : 0) | (gpuCulling ? 8 : 0));
+	hashCombine(hash, chunkCount);
+
+	//Descriptor writes invalidate command buffers that bound the set -> any write since means re-record
+	hashCombine(hash, meshManager->getDescriptorVersion());
+	hashCombine(hash, handleBits(meshManager->getSSBODescriptorSets()[currentFrame]));
+	if (context.bindless) {
+		hashCombine(hash, handleBits(meshManager->getMaterialDescriptorSets()[currentFrame]));
+	}
+
+	if (gpuCulling) {
+		hashCombine(hash, gpuCuller->getDescriptorVersion());
+	}
+
+	//Buffers the commands reference directly
+	const std::shared_ptr<GeometryBuffer>& geometryBuffer = meshManager->getGeometryBuffer();
+	hashCombine(hash, handleBits(geometryBuffer->getVertexBuffer()));
+	hashCombine(hash, handleBits(geometryBuffer->getIndexBuffer()));
+	if (context.batched && !gpuCulling) {
+		for (BufferHandle handle : { indirectBuffers[currentFrame].commands, indirectBuffers[currentFrame].drawData }) {
+			Buffer* buffer = bufferManager->getBuffer(handle);
+			hashCombine(hash, buffer != nullptr ? handleBits(buffer->getHandle()) : 0);
+		}
+	}
+
+	//The draws themselves -> order, geometry, transform slot, material and the pipeline they resolved to
+	for (size_t i = 0; i < context.count; i++) {
+		const DrawItem& item = context.items[i];
+		const GeometryRange& range = item.primitive->getGeometryRange();
+
+		hashCombine(hash, handleBits(item.primitive));
+		hashCombine(hash, handleBits(item.material));
+		hashCombine(hash, static_cast<uint32_t>(item.transformIndex));
+		hashCombine(hash, handleBits(context.pipelines[i]));
+		hashCombine(hash, item.material != nullptr ? item.material->getTextureSlot() : 0);
+		hashCombine(hash, (static_cast<uint64_t>(range.firstIndex) << 32) | range.indexCount);
+		hashCombine(hash, (static_cast<uint64_t>(range.vertexOffset) << 1) | (range.resident ? 1 : 0));
+	}
+
+	return hash;
+}
+
+void GraphicsPipeline::drawPrimitive(
+	VkCommandBuffer commandBuffer,
+	const Primitive& primitive, 
+	bool usePushConstant, // pass in the parentMeshIndex -> NOT THE ACTUAL PRIMTIVE INDEX
+	int transformIndex
+) {
+	int primitiveIndex = primitive.getPrimitiveIndex();
+	int meshIndex = transformIndex >= 0 ? transformIndex : primitive.getParentMeshIndex();
+
+	const GeometryRange& range = primitive.getGeometryRange();
+
+	if (!range.resident) {
+		std::cerr << "Primitive " << primitiveIndex << " has no geometry uploaded" << std::endl;
+		return;
+	}
+
+	if (usePushConstant) {
 		vkCmdPushConstants(commandBuffer, pipelineLayout,
 			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
 			sizeof(int), &meshIndex);
 	}
 
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	// Vertex and index buffers are bound once per batch by the caller
+	vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, static_cast<int32_t>(range.vertexOffset), 0);
 }
\ No newline at end of file
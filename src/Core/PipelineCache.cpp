@@ -0,0 +1,122 @@
+#include "../include/Core/PipelineCache.h"
+#include "../include/Core/VulkanDevices.h"
+
+PipelineCache::PipelineCache(std::shared_ptr<Devices> devices) : cache_devices(devices) {};
+
+void PipelineCache::load(const std::string& path) {
+	cachePath = path;
+	seeded = false;
+
+	std::vector<char> data;
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+	if (file.is_open()) {
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+
+		if (isValidForDevice(data)) {
+			seeded = true;
+		} else {
+			std::cout << "[PipelineCache] [" << path << "] was written for another device or driver, starting empty" << std::endl;
+			data.clear();
+		}
+	} else {
+		std::cout << "[PipelineCache] No cache at [" << path << "], starting empty" << std::endl;
+	}
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	VkResult result = vkCreatePipelineCache(cache_devices->getLogicalDevice(), &createInfo, nullptr, &cache);
+
+	//Header checked out but the driver still refused the payload -> retry empty rather than run without a cache
+	if (result != VK_SUCCESS && !data.empty()) {
+		std::cerr << "[PipelineCache] Driver rejected [" << path << "]: " << result << ", starting empty" << std::endl;
+		seeded = false;
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(cache_devices->getLogicalDevice(), &createInfo, nullptr, &cache);
+	}
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
+
+	if (seeded) {
+		std::cout << "[PipelineCache] Loaded " << data.size() << " bytes from [" << path << "]" << std::endl;
+	}
+}
+
+bool PipelineCache::isValidForDevice(const std::vector<char>& data) const {
+	//Fields are read one by one -> no assumptions about the struct's padding
+	if (data.size() < 16 + VK_UUID_SIZE) return false;
+
+	uint32_t headerSize = 0;
+	uint32_t headerVersion = 0;
+	uint32_t vendorID = 0;
+	uint32_t deviceID = 0;
+	memcpy(&headerSize, data.data(), sizeof(uint32_t));
+	memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+	memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+	memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+	const uint8_t* uuid = reinterpret_cast<const uint8_t*>(data.data() + 16);
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(cache_devices->getPhysicalDevice(), &properties);
+
+	return headerSize >= 16 + VK_UUID_SIZE
+		&& headerSize <= data.size()
+		&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& vendorID == properties.vendorID
+		&& deviceID == properties.deviceID
+		&& memcmp(uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::save() const {
+	if (cache == VK_NULL_HANDLE || cachePath.empty()) return false;
+
+	VkDevice logicalDevice = cache_devices->getLogicalDevice();
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(logicalDevice, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+		std::cerr << "[PipelineCache] Nothing to save" << std::endl;
+		return false;
+	}
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(logicalDevice, cache, &size, data.data()) != VK_SUCCESS) {
+		std::cerr << "[PipelineCache] Failed to read the cache back" << std::endl;
+		return false;
+	}
+
+	//Written next to the target first -> a crash mid write leaves the previous cache intact
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "[PipelineCache] Failed to open [" << tempPath << "] for writing" << std::endl;
+			return false;
+		}
+		file.write(data.data(), static_cast<std::streamsize>(size));
+	}
+
+	std::remove(cachePath.c_str());
+	if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+		std::cerr << "[PipelineCache] Failed to move the cache to [" << cachePath << "]" << std::endl;
+		return false;
+	}
+
+	std::cout << "[PipelineCache] Saved " << size << " bytes to [" << cachePath << "]" << std::endl;
+	return true;
+}
+
+void PipelineCache::cleanup() {
+	if (cache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(cache_devices->getLogicalDevice(), cache, nullptr);
+		cache = VK_NULL_HANDLE;
+	}
+}
@@ -36,10 +36,8 @@ void RenderTargeter::cleanup(bool isLastCleanup) {
 	VkInstance instance = swpch_instance->getInstance();
 	VkSurfaceKHR surface = swpch_instance->getSurface();
 
-	//Clean up depth image
-	if (renderTarget.depthImage != nullptr) {
-		renderTarget.depthImage->cleanup();
-	}
+	//Clean up depth image(and any other transient attachment)
+	destroyTransientAttachments();
 	
 	if (!renderTarget.isSwapchain) {
 		for (size_t i = 0; i < renderTarget.offscreenFramebuffers.size(); i++) {
@@ -47,9 +45,13 @@ void RenderTargeter::cleanup(bool isLastCleanup) {
 		}
 	}
 
-	for (size_t i = 0; i < renderTarget.offscreenFramebuffers.size(); i++) {
+	for (size_t i = 0; i < renderTarget.mainFramebuffers.size(); i++) {
 		vkDestroyFramebuffer(logicalDevice, renderTarget.mainFramebuffers[i], nullptr);
 	}
+	renderTarget.mainFramebuffers.clear();
+
+	//Views belong to the images -> gone with them, not destroyed again below
+	destroyHeadlessResources();
 
 	for (size_t i = 0; i < renderTarget.imageViews.size(); i++) {
 		vkDestroyImageView(logicalDevice, renderTarget.imageViews[i], nullptr);
@@ -80,14 +82,121 @@ void RenderTargeter::cleanup(bool isLastCleanup) {
 
 void RenderTargeter::createDepthImage() {
 	std::cout << "[RenderTargeter::createDepthImage] entered" << std::endl;
+
+	//Depth is cleared on load and never stored -> it only has to exist inside the render pass
+	TransientAttachmentInfo depthInfo{};
+	depthInfo.name = "depth";
+	depthInfo.format = findDepthFormat(swpch_devices->getPhysicalDevice());
+	depthInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	depthInfo.aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+	depthInfo.firstPass = 0;
+	depthInfo.lastPass = 1; // shared by the offscreen and main pass
+
+	createTransientAttachments({ depthInfo });
+
+	renderTarget.depthImage = getTransientAttachment("depth");
+	std::cout << "[RenderTargeter::createDepthImage] exited" << std::endl;
+}
+
+// == Transient attachments ==
+void RenderTargeter::createTransientAttachments(const std::vector<TransientAttachmentInfo>& attachmentInfos) {
 	VkDevice logicalDevice = swpch_devices->getLogicalDevice();
 	VkPhysicalDevice physicalDevice = swpch_devices->getPhysicalDevice();
 
-	std::shared_ptr<Image> depthImage = std::make_shared<Image>(logicalDevice, physicalDevice);
+	//One allocation shared by attachments that are never alive at the same time
+	struct AliasGroup {
+		VkMemoryRequirements requirements{};
+		uint32_t lastPass = 0;
+		std::vector<std::shared_ptr<Image>> images;
+	};
+	std::vector<AliasGroup> groups;
 
-	depthImage->createDepthImage(renderTarget.extent);
-	renderTarget.depthImage = std::move(depthImage);
-	std::cout << "[RenderTargeter::createDepthImage] exited" << std::endl;
+	//Greedy interval partitioning -> earliest starting attachment first, join any group whose last user is done
+	std::vector<const TransientAttachmentInfo*> sortedInfos;
+	for (const auto& info : attachmentInfos) {
+		sortedInfos.push_back(&info);
+	}
+	std::sort(sortedInfos.begin(), sortedInfos.end(),
+		[](const TransientAttachmentInfo* a, const TransientAttachmentInfo* b) { return a->firstPass < b->firstPass; });
+
+	for (const TransientAttachmentInfo* info : sortedInfos) {
+		std::shared_ptr<Image> image = std::make_shared<Image>(logicalDevice, physicalDevice, swpch_memoryAllocator);
+		image->createAttachmentImage(renderTarget.extent, info->format, info->usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, info->aspectFlags);
+
+		VkMemoryRequirements requirements = image->getMemoryRequirements();
+
+		//Of the groups that are free by now, take the one that has to grow the least
+		AliasGroup* group = nullptr;
+		for (auto& candidate : groups) {
+			if (candidate.lastPass >= info->firstPass) continue;
+			if ((candidate.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0) continue;
+
+			if (group == nullptr || std::max(candidate.requirements.size, requirements.size) < std::max(group->requirements.size, requirements.size)) {
+				group = &candidate;
+			}
+		}
+
+		if (group == nullptr) {
+			groups.push_back(AliasGroup{});
+			group = &groups.back();
+			group->requirements = requirements;
+		} else {
+			std::cout << "[RenderTargeter] Attachment [" << info->name << "] aliases memory of an earlier attachment" << std::endl;
+			group->requirements.size = std::max(group->requirements.size, requirements.size);
+			group->requirements.alignment = std::max(group->requirements.alignment, requirements.alignment);
+			group->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+		}
+
+		group->lastPass = info->lastPass;
+		group->images.push_back(image);
+		transientAttachments[info->name] = std::move(image);
+	}
+
+	for (auto& group : groups) {
+		//Lazily allocated memory is only committed if the device actually needs it(tilers keep these on chip)
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		if (hasMemoryType(physicalDevice, group.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+			properties = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		}
+
+		//Dedicated, but not tied to a single image so every member of the group can bind to it
+		MemoryAllocation allocation = swpch_memoryAllocator->allocate(group.requirements, properties, AllocationKind::OPTIMAL, true);
+
+		for (auto& image : group.images) {
+			image->bindExternalMemory(allocation.memory, allocation.offset);
+		}
+
+		std::cout << "[RenderTargeter] Transient memory of size : [" << allocation.size << "] shared by " << group.images.size()
+			<< " attachment(s)" << (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT ? ", lazily allocated" : "") << std::endl;
+
+		transientMemory.push_back(allocation);
+	}
+}
+
+std::shared_ptr<Image> RenderTargeter::getTransientAttachment(const std::string& name) const {
+	auto it = transientAttachments.find(name);
+	return it != transientAttachments.end() ? it->second : nullptr;
+}
+
+void RenderTargeter::destroyTransientAttachments() {
+	//Images first, the memory they alias is freed once nothing is bound to it
+	for (auto& [name, image] : transientAttachments) {
+		image->cleanup();
+	}
+	transientAttachments.clear();
+
+	for (auto& allocation : transientMemory) {
+		swpch_memoryAllocator->free(allocation);
+	}
+	transientMemory.clear();
+}
+
+VkDeviceSize RenderTargeter::getTransientMemorySize() const {
+	VkDeviceSize size = 0;
+	for (const auto& allocation : transientMemory) {
+		size += allocation.size;
+	}
+	return size;
 }
 
 void RenderTargeter::createSwapchainResources() {
@@ -206,6 +315,65 @@ void RenderTargeter::createSwapchainResources() {
 	std::cout << "=== END createSwapchainResources ===" << std::endl;
 }
 
+// == Headless ==
+void RenderTargeter::setHeadlessDetails(VkExtent2D extent) {
+	renderTarget.extent = extent;
+	//Byte order stbi_write_png expects, stored sRGB encoded like the swapchain's B8G8R8A8_SRGB
+	renderTarget.format = VK_FORMAT_R8G8B8A8_SRGB;
+
+	std::cout << "[RenderTargeter::setHeadlessDetails] EXTENT : [h:" << extent.height << " w: " << extent.width << "] \n"
+		<< "[RenderTargeter::setHeadlessDetails] FORMAT: " << renderTarget.format << std::endl;
+}
+
+void RenderTargeter::createHeadlessResources(uint32_t imageCount) {
+	std::cout << "=== START createHeadlessResources ===" << std::endl;
+
+	VkDevice logicalDevice = swpch_devices->getLogicalDevice();
+	VkPhysicalDevice physicalDevice = swpch_devices->getPhysicalDevice();
+
+	//Same role as the swapchain images -> main pass color attachment, copied out by frame dumps
+	renderTarget.isSwapchain = false;
+	renderTarget.images.resize(imageCount);
+	renderTarget.imageViews.resize(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; i++) {
+		std::shared_ptr<Image> image = std::make_shared<Image>(logicalDevice, physicalDevice, swpch_memoryAllocator);
+		image->createAttachmentImage(renderTarget.extent, renderTarget.format,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		//Dedicated like the swapchain's images would be
+		MemoryAllocation allocation = swpch_memoryAllocator->allocate(image->getMemoryRequirements(),
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::OPTIMAL, true);
+		image->bindExternalMemory(allocation.memory, allocation.offset);
+
+		renderTarget.images[i] = image->getImage();
+		renderTarget.imageViews[i] = image->getImageDetails().imageView;
+
+		headlessImages.push_back(image);
+		headlessMemory.push_back(allocation);
+	}
+
+	std::cout << "[RenderTargeter] Created " << imageCount << " headless color images" << std::endl;
+	std::cout << "=== END createHeadlessResources ===" << std::endl;
+}
+
+void RenderTargeter::destroyHeadlessResources() {
+	if (headlessImages.empty()) return;
+
+	for (auto& image : headlessImages) {
+		image->cleanup();
+	}
+	headlessImages.clear();
+
+	for (auto& allocation : headlessMemory) {
+		swpch_memoryAllocator->free(allocation);
+	}
+	headlessMemory.clear();
+
+	renderTarget.images.clear();
+	renderTarget.imageViews.clear();
+}
+
 void RenderTargeter::createFramebuffers(VkRenderPass renderPass, bool usingOffscreenPass) {
 	std::cout << "RenderTargeter[createFramebuffers] entered" << std::endl;
 	VkDevice logicalDevice = swpch_devices->getLogicalDevice();
@@ -221,10 +389,12 @@ void RenderTargeter::createFramebuffers(VkRenderPass renderPass, bool usingOffsc
 		renderTarget.mainFramebuffers.resize(renderTarget.imageViews.size());
 
 		std::cout << "Main framebuffer vec size: " << renderTarget.mainFramebuffers.size() << std::endl;
-		std::cout << "Addrs: \n"
-			<< "[0]: " << renderTarget.mainFramebuffers[0] << "\n"
-			<< "[1]: " << renderTarget.mainFramebuffers[1] << "\n"
-			<< "[2]: " << renderTarget.mainFramebuffers[2] << std::endl;
+		//Image count depends on the target(3 for most swapchains, 2 headless)
+		std::cout << "Addrs: \n";
+		for (size_t i = 0; i < renderTarget.mainFramebuffers.size(); i++) {
+			std::cout << "[" << i << "]: " << renderTarget.mainFramebuffers[i] << "\n";
+		}
+		std::cout << std::endl;
 	}
 
 	std::cout << "[RenderTargeter::createFramebuffers] Depth image view handle: " << renderTarget.depthImage->getImageDetails().imageView << std::endl;
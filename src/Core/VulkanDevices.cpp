@@ -1,8 +1,12 @@
 #include "../include/Core/VulkanDevices.h"
 
 void Capabilities::query(VkPhysicalDevice potentialDevice) {
+	VkPhysicalDeviceBufferDeviceAddressFeatures addressFeatures{};
+	addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+
 	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
 	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	indexingFeatures.pNext = &addressFeatures;
 
 	VkPhysicalDeviceFeatures2 features2{};
 	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
@@ -14,6 +18,9 @@ void Capabilities::query(VkPhysicalDevice potentialDevice) {
 	shaderSampledImageArrayNonUniformIndexing = indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
 	descriptorBindingPartiallyBound = indexingFeatures.descriptorBindingPartiallyBound;
 	descriptorBindingVariableDescriptorCount = indexingFeatures.descriptorBindingVariableDescriptorCount;
+	bufferDeviceAddress = addressFeatures.bufferDeviceAddress;
+	multiDrawIndirect = features2.features.multiDrawIndirect;
+	drawIndirectFirstInstance = features2.features.drawIndirectFirstInstance;
 
 	supportsDescriptorIndexing =
 		runtimeDescriptorArray &&
@@ -34,6 +41,7 @@ void Capabilities::query(VkPhysicalDevice potentialDevice) {
 
 	vkGetPhysicalDeviceProperties2(potentialDevice, &props2);
 	maxUpdateAfterBindDescriptorsInAllPools = indexingProps.maxUpdateAfterBindDescriptorsInAllPools;
+	maxDrawIndirectCount = props2.properties.limits.maxDrawIndirectCount;
 }
 
 // ==Main functions==
@@ -86,6 +94,11 @@ void Devices::createLogicalDevice() {
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { queueFamilies.graphicsFamily.value(), queueFamilies.presentFamily.value() };
 
+	//Uploads get their own queue when there is a transfer family without graphics
+	if (queueFamilies.hasDedicatedTransfer()) {
+		uniqueQueueFamilies.insert(queueFamilies.transferFamily.value());
+	}
+
 	float queuePriority = 1.0f;
 
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -99,33 +112,51 @@ void Devices::createLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
-	//Specifies device features we will be using, 
-	// -> not used now 
+	//Specifies device features we will be using
 	VkPhysicalDeviceFeatures deviceFeatures{};
 
+	//Indirect draws -> per draw data is picked through firstInstance, batches go out in one call with multi draw
+	deviceFeatures.multiDrawIndirect = deviceCaps.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = deviceCaps.drawIndirectFirstInstance;
+
+	//Optional features are chained as their own structs -> valid on 1.1 devices with the extensions as well as on 1.2
 	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	VkPhysicalDeviceBufferDeviceAddressFeatures addressFeatures{};
+	addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+
 	VkDeviceCreateInfo createInfo{};
 	VkPhysicalDeviceFeatures2 deviceFeatures2{};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.features = deviceFeatures;
+
+	void** featureChainTail = &deviceFeatures2.pNext;
 
 	if (deviceCaps.supportsDescriptorIndexing) {
 		std::cout << " -- logical device is being created with descriptor indexing extensions" << std::endl;
 
-		//VULKAN 1.2 FEATURES
-		VkPhysicalDeviceVulkan12Features vulkan12Features{};
-		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
-		vulkan12Features.descriptorIndexing = VK_TRUE;
-		vulkan12Features.runtimeDescriptorArray = VK_TRUE;
-		vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
-		vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
-		vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+
+		*featureChainTail = &indexingFeatures;
+		featureChainTail = &indexingFeatures.pNext;
+	}
 
-		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-		deviceFeatures2.features = deviceFeatures; 
-		deviceFeatures2.pNext = &vulkan12Features; 
+	if (deviceCaps.supportsBufferDeviceAddress) {
+		std::cout << " -- logical device is being created with buffer device address" << std::endl;
 
+		addressFeatures.bufferDeviceAddress = VK_TRUE;
+
+		*featureChainTail = &addressFeatures;
+		featureChainTail = &addressFeatures.pNext;
+	}
+
+	if (deviceFeatures2.pNext != nullptr) {
 		createInfo.pNext = &deviceFeatures2;
 		createInfo.pEnabledFeatures = nullptr;
-
 	} else {
 		createInfo.pNext = nullptr;
 		createInfo.pEnabledFeatures = &deviceFeatures;
@@ -156,6 +187,14 @@ void Devices::createLogicalDevice() {
 	vkGetDeviceQueue(device, queueFamilies.graphicsFamily.value(), 0, &graphicsQueue);
 	//as well as our present queue
 	vkGetDeviceQueue(device, queueFamilies.presentFamily.value(), 0, &presentQueue);
+
+	if (queueFamilies.hasDedicatedTransfer()) {
+		vkGetDeviceQueue(device, queueFamilies.transferFamily.value(), 0, &transferQueue);
+		std::cout << "Using dedicated transfer queue family : " << queueFamilies.transferFamily.value() << std::endl;
+	} else {
+		transferQueue = graphicsQueue;
+		std::cout << "No dedicated transfer queue family, uploads run on the graphics queue" << std::endl;
+	}
 };
 
 //Destructor, destroys logical device
@@ -195,15 +234,31 @@ const bool Devices::checkDeviceExtensionSupport(VkPhysicalDevice potentialDevice
 	return requiredExtensions.empty();
 }
 
+const bool Devices::isDeviceExtensionAvailable(VkPhysicalDevice potentialDevice, const char* extensionName) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(potentialDevice, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(potentialDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) return true;
+	}
+
+	return false;
+}
+
 //This function modifies extensions and features in order to make a device suitable
 const bool Devices::rateDeviceSuitability(VkPhysicalDevice potentialDevice, int currentGreatestDeviceScore) {
 	int score = 0;
 	Capabilities caps;
 	caps.query(potentialDevice);
 
-	std::vector<const char*> requiredExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
+	//Headless renders into plain images -> software drivers without a swapchain(lavapipe on a display-less host) qualify
+	std::vector<const char*> requiredExtensions;
+	if (!dev_instance->isHeadless()) {
+		requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
 
 	deviceExtensions = requiredExtensions;
 	if (!checkDeviceExtensionSupport(potentialDevice)) {
@@ -231,9 +286,28 @@ const bool Devices::rateDeviceSuitability(VkPhysicalDevice potentialDevice, int
 		score += 1;
 	}
 
+	//Optional -> without it memory budgets fall back to heap sizes
+	caps.supportsMemoryBudget = isDeviceExtensionAvailable(potentialDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (caps.supportsMemoryBudget) {
+		deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
 	VkPhysicalDeviceProperties props;
 	vkGetPhysicalDeviceProperties(potentialDevice, &props);
 
+	//Optional -> core in 1.2, the extension is still enabled where it is listed
+	bool addressExtensionAvailable = isDeviceExtensionAvailable(potentialDevice, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+	caps.supportsBufferDeviceAddress = caps.bufferDeviceAddress && (addressExtensionAvailable || props.apiVersion >= VK_API_VERSION_1_2);
+	if (caps.supportsBufferDeviceAddress && addressExtensionAvailable) {
+		deviceExtensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+	}
+
+	//Optional -> only the extension is used, the 1.2 feature bit would need VkPhysicalDeviceVulkan12Features in the chain
+	caps.supportsDrawIndirectCount = isDeviceExtensionAvailable(potentialDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (caps.supportsDrawIndirectCount) {
+		deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 	if (props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
 		score += 1;
 	}
@@ -275,4 +349,13 @@ void Devices::logPhysicalDevice() const {
 		deviceProperties.limits.maxImageDimension2D);
 	printf("  Supports Bindless: %s\n",
 		deviceCaps.supportsDescriptorIndexing ? "Yes" : "No");
+	printf("  Supports Memory Budget: %s\n",
+		deviceCaps.supportsMemoryBudget ? "Yes" : "No");
+	printf("  Supports Buffer Device Address: %s\n",
+		deviceCaps.supportsBufferDeviceAddress ? "Yes" : "No");
+	printf("  Supports Draw Indirect Count: %s\n",
+		deviceCaps.supportsDrawIndirectCount ? "Yes" : "No");
+	printf("  Supports Multi Draw Indirect: %s (first instance: %s)\n",
+		deviceCaps.multiDrawIndirect ? "Yes" : "No",
+		deviceCaps.drawIndirectFirstInstance ? "Yes" : "No");
 };
\ No newline at end of file
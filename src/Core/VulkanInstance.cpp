@@ -12,7 +12,14 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
 
 // -- CLASS FUNCTIONS -- 
 //Create Window on class construction
-VulkanInstance::VulkanInstance(std::shared_ptr<DebugManager> debugManager) : instance_debugManager(debugManager) {
+VulkanInstance::VulkanInstance(std::shared_ptr<DebugManager> debugManager, bool headless)
+    : instance_debugManager(debugManager), headless(headless) {
+    //No display on the host -> glfwInit() would fail, and nothing needs a window
+    if (headless) {
+        std::cout << "[VulkanInstance] Headless, no window created" << std::endl;
+        return;
+    }
+
     glfwInit();
 
     //Set window hints
@@ -41,13 +48,16 @@ void VulkanInstance::createSurface() {
 void VulkanInstance::cleanup() {
     std::cout << "    Destroying `Instance` " << std::endl;
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
 
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
+    if (!headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 };
 
 //This function creates a VkInstance variable
@@ -80,7 +90,7 @@ void VulkanInstance::createInstance() {
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    auto extensions = getRequiredExtensions();
+    auto extensions = getRequiredExtensions(headless);
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
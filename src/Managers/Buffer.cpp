@@ -8,36 +8,34 @@ Buffer::Buffer(BufferType type,
 	VkDeviceSize size,
 	VkDevice logicalDevice,
 	VkPhysicalDevice physicalDevice,
-	std::optional<std::vector<Vertex>> vertices,
-	std::optional<std::vector<uint32_t>> indices) : buf_type(type), buf_name(name), buf_size(size), buf_logicalDevice(logicalDevice), buf_physicalDevice(physicalDevice)
+	std::shared_ptr<MemoryAllocator> allocator,
+	const std::optional<std::vector<Vertex>>& vertices,
+	const std::optional<std::vector<uint32_t>>& indices) : buf_type(type), buf_name(name), buf_size(size), buf_logicalDevice(logicalDevice), buf_physicalDevice(physicalDevice), buf_allocator(allocator)
 {
+	//Only staging buffers hold on to the data, and only until it is mapped -> everything else keeps a count
 	if ((type == BufferType::VERTEX || type == BufferType::VERTEX_STAGING) && vertices.has_value()) {
-		buf_vertices = vertices;
+		buf_elementCount = static_cast<uint32_t>(vertices->size());
+		if (type == BufferType::VERTEX_STAGING) buf_vertices = vertices;
 	}
 	else if (type == BufferType::VERTEX || type == BufferType::VERTEX_STAGING && (vertices.has_value() == false)) {
 		buf_errors |= BUF_ERROR_TYPE;
 	}
-	else {
-		buf_vertices = std::nullopt;
-	}
 
 	if ((type == BufferType::INDEX || type == BufferType::INDEX_STAGING) && indices.has_value()) {
-		buf_indices = indices;
+		buf_elementCount = static_cast<uint32_t>(indices->size());
+		if (type == BufferType::INDEX_STAGING) buf_indices = indices;
 	}
 	else if (type == BufferType::INDEX || type == BufferType::INDEX_STAGING && (indices.has_value() == false)) {
 		buf_errors |= BUF_ERROR_TYPE;
 	}
-	else {
-		buf_indices = std::nullopt;
-	}
 };
 
 void Buffer::createBuffer(
 	VkDevice logicalDevice, VkPhysicalDevice physicalDevice,
 	VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-	VkDeviceSize size
+	VkDeviceSize size, MemoryUsage memoryUsage
 ) {
-	allocateAndBindBuffer(logicalDevice, physicalDevice, size, usage, properties);
+	allocateAndBindBuffer(logicalDevice, physicalDevice, size, usage, properties, memoryUsage);
 	mapData(logicalDevice, usage, properties);
 };
 
@@ -46,10 +44,16 @@ void Buffer::allocateAndBindBuffer(
 	VkPhysicalDevice physicalDevice,
 	VkDeviceSize size,
 	VkBufferUsageFlags usage,
-	VkMemoryPropertyFlags properties
+	VkMemoryPropertyFlags properties,
+	MemoryUsage memoryUsage
 ) {
 	std::cout << "Allocating buffer of size : [" << size << "]" << std::endl;
 
+	//Kept so the buffer can be recreated elsewhere(defragmentation)
+	buf_usage = usage;
+	buf_properties = properties;
+	buf_memoryUsage = memoryUsage;
+
 	// Create buffer
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -57,23 +61,27 @@ void Buffer::allocateAndBindBuffer(
 	bufferInfo.usage = usage;
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+	if (buf_queueFamilies.size() > 1) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(buf_queueFamilies.size());
+		bufferInfo.pQueueFamilyIndices = buf_queueFamilies.data();
+	}
+
 	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buf_handle) != VK_SUCCESS) {
 		buf_errors |= BUF_ERROR_CREATION;
 	};
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(device, buf_handle, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &buf_memory) != VK_SUCCESS) {
+	//Sub-allocate from the shared memory blocks
+	try {
+		buf_allocation = buf_allocator->allocateForBuffer(buf_handle, properties, memoryUsage);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "[" << buf_name << "] " << e.what() << std::endl;
 		buf_errors |= BUF_ERROR_ALLOCATION;
+		return;
 	}
 
-	if (vkBindBufferMemory(device, buf_handle, buf_memory, 0) != VK_SUCCESS) {
+	if (vkBindBufferMemory(device, buf_handle, buf_allocation.memory, buf_allocation.offset) != VK_SUCCESS) {
 		buf_errors |= BUF_ERROR_BIND;
 	};
 
@@ -89,8 +97,14 @@ void Buffer::mapData(VkDevice logicalDevice, VkBufferUsageFlags usage, VkMemoryP
 		return;
 	};
 
-	void* data;
-	vkMapMemory(logicalDevice, buf_memory, 0, buf_size, 0, &data);
+	if (buf_type != BufferType::VERTEX_STAGING && buf_type != BufferType::INDEX_STAGING) return;
+
+	//Staging memory is persistently mapped by the allocator
+	void* data = buf_allocation.mappedPtr;
+	if (data == nullptr) {
+		buf_errors |= BUF_ERROR_COPY;
+		return;
+	}
 		
 	//Map data to buffer depending on type: 
 	if (buf_type == BufferType::VERTEX_STAGING) {
@@ -98,34 +112,12 @@ void Buffer::mapData(VkDevice logicalDevice, VkBufferUsageFlags usage, VkMemoryP
 	} else if (buf_type == BufferType::INDEX_STAGING) {
 		memcpy(data, buf_indices.value().data(), (size_t)buf_size);
 	}
-		
-	vkUnmapMemory(logicalDevice, buf_memory);
-};
-
 
-template<>
-std::vector<Vertex> Buffer::getData<Vertex>() const {
-	// for now we are only using staging buffers for vertex data, 
-	// so we can safely assume any staging buffer holds some vertex data
-	if (buf_type == BufferType::VERTEX_STAGING || buf_type == BufferType::VERTEX) {
-		if (buf_vertices.has_value()) {
-			return buf_vertices.value();
-		}
-	}
-
-	throw std::runtime_error("No Index Data in " + buf_name);
-}
+	//The mapped memory is the copy now
+	buf_vertices.reset();
+	buf_indices.reset();
+};
 
-template<>
-std::vector<uint32_t> Buffer::getData<uint32_t>() const {
-	if (buf_type == BufferType::INDEX_STAGING || buf_type == BufferType::INDEX) {
-		if (buf_indices.has_value()) {
-			return buf_indices.value();
-		}
-	}
-
-	throw std::runtime_error("No Vertex Data in " + buf_name);
-}
 
 void Buffer::printErrors() const {
 	if (buf_errors == BUF_ERROR_NONE) {
@@ -152,6 +144,3 @@ void Buffer::printErrors() const {
 		std::cout << "  - Buffer Type and data does not match" << std::endl;
 	}
 };
-
-template std::vector<Vertex> Buffer::getData<Vertex>() const;
-template std::vector<uint32_t> Buffer::getData<uint32_t>() const;
\ No newline at end of file
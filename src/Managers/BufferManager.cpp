@@ -5,30 +5,126 @@
 BufferManager::BufferManager(
 	VkDevice logicalDevice,
 	VkPhysicalDevice physicalDevice,
-	VkQueue graphicsQueue
+	VkQueue graphicsQueue,
+	std::shared_ptr<MemoryAllocator> memoryAllocator,
+	VkDeviceSize stagingRingSize
 ) {
 	std::cout << "Creating [bufferManager]: " << std::endl;
 	bufferManager_logicalDevice = logicalDevice;
 	bufferManager_physicalDevice = physicalDevice;
 	bufferManager_graphicsQueue = graphicsQueue;
+	bufferManager_memoryAllocator = memoryAllocator;
 
 	std::cout << "       with logical device: " << bufferManager_logicalDevice << std::endl;
+
+	//One persistently mapped staging buffer shared by every upload
+	createBuffer(
+		BufferType::GENERIC_STAGING,
+		"staging_ring",
+		stagingRingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::STAGING
+	);
+
+	std::shared_ptr<Buffer> ringBuffer = getBuffer("staging_ring");
+	if (ringBuffer->getMappedPtr() == nullptr) {
+		throw std::runtime_error("Staging ring memory is not host visible");
+	}
+
+	stagingRing.init(ringBuffer->getHandle(), ringBuffer->getMappedPtr(), stagingRingSize);
+	std::cout << "       with staging ring of " << stagingRingSize / (1024 * 1024) << "MB" << std::endl;
 };
 
+void BufferManager::setTransferQueue(VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily) {
+	if (transferFamily == graphicsFamily) return;
+
+	//Nothing recorded so far may end up on the wrong queue
+	waitForUploads(flushUploads());
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	poolInfo.queueFamilyIndex = transferFamily;
+	if (vkCreateCommandPool(bufferManager_logicalDevice, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create transfer command pool");
+	}
+
+	poolInfo.queueFamilyIndex = graphicsFamily;
+	if (vkCreateCommandPool(bufferManager_logicalDevice, &poolInfo, nullptr, &acquireCommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create ownership acquire command pool");
+	}
+
+	bufferManager_transferQueue = transferQueue;
+	bufferManager_transferFamily = transferFamily;
+	bufferManager_graphicsFamily = graphicsFamily;
+	sharedQueueFamilies = { graphicsFamily, transferFamily };
+	useTransferQueue = true;
+
+	std::cout << "[BufferManager] Uploads run on transfer queue family " << transferFamily << std::endl;
+}
+
+
+// == Buffer device address ==
+void BufferManager::setBufferDeviceAddressEnabled(bool enabled) {
+	bufferDeviceAddressEnabled = false;
+	getBufferDeviceAddressFunc = nullptr;
+	if (!enabled) return;
+
+	//Blocks allocated without VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT can not back addressable buffers
+	if (!bufferManager_memoryAllocator->isBufferDeviceAddressEnabled()) {
+		std::cerr << "[BufferManager] Buffer device address needs to be enabled on the MemoryAllocator before any allocation" << std::endl;
+		return;
+	}
+
+	//Core on 1.2 devices, only the KHR name exists when it was enabled as an extension on 1.1
+	getBufferDeviceAddressFunc = reinterpret_cast<PFN_vkGetBufferDeviceAddress>(
+		vkGetDeviceProcAddr(bufferManager_logicalDevice, "vkGetBufferDeviceAddress"));
+	if (getBufferDeviceAddressFunc == nullptr) {
+		getBufferDeviceAddressFunc = reinterpret_cast<PFN_vkGetBufferDeviceAddress>(
+			vkGetDeviceProcAddr(bufferManager_logicalDevice, "vkGetBufferDeviceAddressKHR"));
+	}
+
+	if (getBufferDeviceAddressFunc == nullptr) {
+		std::cerr << "[BufferManager] Buffer device address enabled but vkGetBufferDeviceAddress could not be loaded" << std::endl;
+		return;
+	}
+
+	bufferDeviceAddressEnabled = true;
+	std::cout << "[BufferManager] Buffer device addresses enabled" << std::endl;
+}
+
+VkBufferUsageFlags BufferManager::getDeviceAddressUsage() const {
+	return bufferDeviceAddressEnabled ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0;
+}
+
+VkDeviceAddress BufferManager::getDeviceAddress(BufferHandle handle) const {
+	Buffer* buffer = getBuffer(handle);
+	return buffer != nullptr ? buffer->getDeviceAddress() : 0;
+}
 
 // == Buffer Operation functions == 
-void BufferManager::createBuffer(
+BufferHandle BufferManager::createBuffer(
 	BufferType type,
 	const std::string& name,
 	VkDeviceSize bufferSize, 
 	VkBufferUsageFlags usage,
 	VkMemoryPropertyFlags properties,
-	std::optional<std::vector<Vertex>> vertices,
-	std::optional<std::vector<uint32_t>> indices
+	const std::optional<std::vector<Vertex>>& vertices,
+	const std::optional<std::vector<uint32_t>>& indices,
+	MemoryUsage memoryUsage
 ) 
 {
 	std::cout << "Creating buffer :[" << name << "]" << std::endl;
 
+	if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) && !bufferDeviceAddressEnabled) {
+		std::cerr << "[BufferManager] [" << name << "] asked for a device address, but the device has none -> creating it without" << std::endl;
+		usage &= ~VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	}
+
 	//Create a new buffer instance
 	auto newBuffer = std::make_shared<Buffer>(
 		type,
@@ -36,13 +132,34 @@ void BufferManager::createBuffer(
 		bufferSize,
 		bufferManager_logicalDevice,
 		bufferManager_physicalDevice,
+		bufferManager_memoryAllocator,
 		vertices, 
 		indices
 	);
 
-	newBuffer->createBuffer(bufferManager_logicalDevice, bufferManager_physicalDevice, usage, properties, bufferSize);
+	//Written by the transfer queue and read by the graphics queue without ownership transfers
+	if (useTransferQueue && (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT)) {
+		newBuffer->setSharedQueueFamilies(sharedQueueFamilies);
+	}
+
+	newBuffer->createBuffer(bufferManager_logicalDevice, bufferManager_physicalDevice, usage, properties, bufferSize, memoryUsage);
+
+	if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) && !newBuffer->hasErrors()) {
+		VkBufferDeviceAddressInfo addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = newBuffer->getHandle();
+		newBuffer->setDeviceAddress(getBufferDeviceAddressFunc(bufferManager_logicalDevice, &addressInfo));
+	}
+
+	//Same name -> the new buffer takes over the name, the old handle goes stale
+	auto existing = bufferNames.find(name);
+	if (existing != bufferNames.end()) {
+		removeBuffer(existing->second);
+	}
 
-	buffers[name] = std::move(newBuffer);
+	BufferHandle handle = buffers.insert(std::move(newBuffer));
+	bufferNames[name] = handle;
+	return handle;
 };
 
 VkCommandBuffer BufferManager::beginOneTimeCommands(VkCommandPool commandPool) {
@@ -91,31 +208,236 @@ void BufferManager::endOneTimeCommands(VkCommandBuffer commandBuffer, VkCommandP
 		std::cout << "[BufferManager] vkEndCommandBuffer succeeded." << std::endl;
 	}
 
+	//Copies recorded in the open batch have to land before anything submitted after them
+	flushUploads();
+
+	PendingUpload upload{};
+	upload.fenceValue = nextUploadValue++;
+	upload.commandBuffer = commandBuffer;
+	upload.commandPool = commandPool;
+
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	result = vkQueueSubmit(bufferManager_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	if (result != VK_SUCCESS) {
-		std::cerr << "[BufferManager] vkQueueSubmit failed: " << result << std::endl;
-		throw std::runtime_error("Failed to submit command buffer");
+	submitUpload(upload, submitInfo);
+
+	//Only waits on this submit's fence instead of draining the whole queue
+	UploadToken token{};
+	token.value = upload.fenceValue;
+	waitForUploads(token);
+}
+
+// == Upload batching ==
+VkCommandBuffer BufferManager::getUploadCommandBuffer(VkCommandPool commandPool) {
+	if (useTransferQueue) commandPool = transferCommandPool;
+
+	if (uploadBatchCommandBuffer != VK_NULL_HANDLE && uploadBatchCommandPool != commandPool) {
+		flushUploads();
 	}
-	else {
-		std::cout << "[BufferManager] vkQueueSubmit succeeded." << std::endl;
+
+	if (uploadBatchCommandBuffer == VK_NULL_HANDLE) {
+		uploadBatchCommandBuffer = beginOneTimeCommands(commandPool);
+		uploadBatchCommandPool = commandPool;
+		uploadBatchValue = nextUploadValue++;
 	}
 
-	result = vkQueueWaitIdle(bufferManager_graphicsQueue);
+	return uploadBatchCommandBuffer;
+}
+
+// Destination buffers are VK_SHARING_MODE_CONCURRENT when a transfer queue is used -> a partial write
+// needs no ownership transfer(which would leave the rest of an exclusive buffer undefined), the semaphore orders it
+void BufferManager::recordBufferCopy(VkCommandPool commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region) {
+	vkCmdCopyBuffer(getUploadCommandBuffer(commandPool), srcBuffer, dstBuffer, 1, &region);
+}
+
+void BufferManager::releaseImageToGraphics(
+	VkCommandPool commandPool,
+	VkImage image,
+	const VkImageSubresourceRange& subresourceRange,
+	VkImageLayout oldLayout,
+	VkImageLayout newLayout
+) {
+	VkCommandBuffer commandBuffer = getUploadCommandBuffer(commandPool);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.image = image;
+	barrier.subresourceRange = subresourceRange;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (!useTransferQueue) {
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier
+		);
+		return;
+	}
+
+	//Release half -> the transfer queue has no fragment stage, the acquire on the graphics queue makes it visible
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = bufferManager_transferFamily;
+	barrier.dstQueueFamilyIndex = bufferManager_graphicsFamily;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier
+	);
+
+	//Acquire half has to repeat the exact same layout transition and queue families
+	VkImageMemoryBarrier acquire = barrier;
+	acquire.srcAccessMask = 0;
+	acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	pendingImageAcquires.push_back(acquire);
+}
+
+UploadToken BufferManager::getUploadBatchToken() const {
+	UploadToken token{};
+	token.value = uploadBatchCommandBuffer != VK_NULL_HANDLE ? uploadBatchValue : nextUploadValue - 1;
+	return token;
+}
+
+UploadToken BufferManager::flushUploads() {
+	UploadToken token = getUploadBatchToken();
+	if (uploadBatchCommandBuffer == VK_NULL_HANDLE) return token;
+
+	if (useTransferQueue) {
+		submitTransferBatch();
+		return token;
+	}
+
+	//One barrier for the whole batch -> every copy is visible to the frames submitted after it
+	// -> later copies(relocation, the next batch) and the cull compute pass read/overwrite the same ranges
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+		| VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+		| VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(uploadBatchCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr
+	);
+
+	VkResult result = vkEndCommandBuffer(uploadBatchCommandBuffer);
 	if (result != VK_SUCCESS) {
-		std::cerr << "[BufferManager] vkQueueWaitIdle failed: " << result << std::endl;
-		throw std::runtime_error("Failed to wait for queue idle");
+		std::cerr << "[BufferManager] vkEndCommandBuffer failed: " << result << std::endl;
+		throw std::runtime_error("Failed to end upload batch");
 	}
-	else {
-		std::cout << "[BufferManager] vkQueueWaitIdle succeeded." << std::endl;
+
+	PendingUpload upload{};
+	upload.fenceValue = uploadBatchValue;
+	upload.commandBuffer = uploadBatchCommandBuffer;
+	upload.commandPool = uploadBatchCommandPool;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadBatchCommandBuffer;
+
+	submitUpload(upload, submitInfo);
+	std::cout << "[BufferManager] Submitted upload batch " << uploadBatchValue << std::endl;
+
+	uploadBatchCommandBuffer = VK_NULL_HANDLE;
+	uploadBatchCommandPool = VK_NULL_HANDLE;
+	return token;
+}
+
+// Transfer queue: the batch(with the image releases) signals a semaphore, a graphics queue submit waits on it
+// and records the image acquires. The fence sits on the graphics submit, so it covers both.
+// Buffers are shared concurrently -> the semaphore wait alone makes their copies visible to the graphics queue.
+void BufferManager::submitTransferBatch() {
+	if (vkEndCommandBuffer(uploadBatchCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to end upload batch");
+	}
+
+	PendingUpload upload{};
+	upload.fenceValue = uploadBatchValue;
+	upload.commandBuffer = uploadBatchCommandBuffer;
+	upload.commandPool = uploadBatchCommandPool;
+	upload.semaphore = acquireUploadSemaphore();
+
+	VkSubmitInfo transferSubmit{};
+	transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	transferSubmit.commandBufferCount = 1;
+	transferSubmit.pCommandBuffers = &upload.commandBuffer;
+	transferSubmit.signalSemaphoreCount = 1;
+	transferSubmit.pSignalSemaphores = &upload.semaphore;
+
+	if (vkQueueSubmit(bufferManager_transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit upload batch to the transfer queue");
+	}
+
+	//Acquire on the graphics queue -> images only, anything that samples or copies from them comes after it
+	if (!pendingImageAcquires.empty()) {
+		upload.acquireCommandBuffer = beginOneTimeCommands(acquireCommandPool);
+
+		vkCmdPipelineBarrier(upload.acquireCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+			| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(pendingImageAcquires.size()), pendingImageAcquires.data()
+		);
+
+		if (vkEndCommandBuffer(upload.acquireCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to end ownership acquire command buffer");
+		}
 	}
 
-	vkFreeCommandBuffers(bufferManager_logicalDevice, commandPool, 1, &commandBuffer);
-	std::cout << "[BufferManager] Command buffer freed." << std::endl;
+	//Every later graphics queue command waits for the copies, whatever stage reads them
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo acquireSubmit{};
+	acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	acquireSubmit.waitSemaphoreCount = 1;
+	acquireSubmit.pWaitSemaphores = &upload.semaphore;
+	acquireSubmit.pWaitDstStageMask = &waitStage;
+	acquireSubmit.commandBufferCount = upload.acquireCommandBuffer != VK_NULL_HANDLE ? 1 : 0;
+	acquireSubmit.pCommandBuffers = &upload.acquireCommandBuffer;
+
+	submitUpload(upload, acquireSubmit);
+	std::cout << "[BufferManager] Submitted upload batch " << uploadBatchValue << " on the transfer queue ("
+		<< pendingImageAcquires.size() << " images)" << std::endl;
+
+	pendingImageAcquires.clear();
+	uploadBatchCommandBuffer = VK_NULL_HANDLE;
+	uploadBatchCommandPool = VK_NULL_HANDLE;
+}
+
+bool BufferManager::isUploadComplete(UploadToken token) {
+	if (uploadBatchCommandBuffer != VK_NULL_HANDLE && token.value >= uploadBatchValue) return false;
+
+	reclaimStaging();
+	return completedUploadValue >= token.value;
+}
+
+// Fences are handed out in submit order, so completing the queue front first keeps completedUploadValue monotonic
+void BufferManager::submitUpload(PendingUpload upload, const VkSubmitInfo& submitInfo) {
+	upload.fence = acquireUploadFence();
+
+	VkResult result = vkQueueSubmit(bufferManager_graphicsQueue, 1, &submitInfo, upload.fence);
+	if (result != VK_SUCCESS) {
+		std::cerr << "[BufferManager] vkQueueSubmit failed: " << result << std::endl;
+		throw std::runtime_error("Failed to submit command buffer");
+	}
+
+	//Everything staged so far is read by this submit
+	stagingRing.markSubmitted(upload.fenceValue);
+	for (auto it = overflowStaging.rbegin(); it != overflowStaging.rend() && it->fenceValue == 0; ++it) {
+		it->fenceValue = upload.fenceValue;
+	}
+	pendingUploads.push_back(upload);
 }
 
 
@@ -123,48 +445,376 @@ void BufferManager::copyBuffer(
 	std::shared_ptr<Buffer> srcBuffer, 
 	std::shared_ptr<Buffer> dstBuffer, 
 	VkDeviceSize size,
-	VkCommandPool commandPool
+	VkCommandPool commandPool,
+	VkDeviceSize srcOffset,
+	VkDeviceSize dstOffset
 ) {
 	std::cout << "Copy staging data into v/i buffer" << std::endl;
 	VkCommandBuffer commandBuffer = beginOneTimeCommands(commandPool);
 
 	//Copy buffer to dstBuffer
 	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer->getHandle(), dstBuffer->getHandle(), 1, &copyRegion);
 
 	endOneTimeCommands(commandBuffer, commandPool);
 };
 
+// == Staging functions ==
+StagingAllocation BufferManager::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+	if (size <= stagingRing.getCapacity()) {
+		std::optional<StagingAllocation> allocation = stagingRing.allocate(size, alignment);
+
+		//Ring is full -> submit the open batch, wait for everything in flight and try again
+		if (!allocation.has_value()) {
+			UploadToken token = flushUploads();
+			waitForUploads(token);
+			allocation = stagingRing.allocate(size, alignment);
+		}
+
+		if (allocation.has_value()) return allocation.value();
+	}
+
+	//Too large for the ring(or the ring is full of unsubmitted data) -> temporary buffer, destroyed once its submit completes
+	std::string name = "staging_overflow_" + std::to_string(overflowCounter++);
+	std::cout << "[BufferManager] Staging ring cannot fit " << size << " bytes, using temporary buffer [" << name << "]" << std::endl;
+
+	createBuffer(
+		BufferType::GENERIC_STAGING,
+		name,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::STAGING
+	);
+
+	std::shared_ptr<Buffer> overflowBuffer = getBuffer(name);
+
+	OverflowStaging overflow{};
+	overflow.name = name;
+	overflowStaging.push_back(overflow);
+
+	StagingAllocation allocation{};
+	allocation.buffer = overflowBuffer->getHandle();
+	allocation.offset = 0;
+	allocation.size = size;
+	allocation.mappedPtr = overflowBuffer->getMappedPtr();
+	return allocation;
+}
+
+UploadToken BufferManager::uploadToBuffer(
+	std::shared_ptr<Buffer> dstBuffer,
+	const void* data,
+	VkDeviceSize size,
+	VkCommandPool commandPool,
+	VkDeviceSize dstOffset
+) {
+	//Host visible destinations(uniform/storage buffers) skip the copy entirely
+	if (size == 0 || dstBuffer->getMappedPtr() != nullptr) {
+		if (size > 0) memcpy(static_cast<char*>(dstBuffer->getMappedPtr()) + dstOffset, data, (size_t)size);
+		return UploadToken{};
+	}
+
+	StagingAllocation staging = allocateStaging(size, 16);
+	memcpy(staging.mappedPtr, data, (size_t)size);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	recordBufferCopy(commandPool, staging.buffer, dstBuffer->getHandle(), copyRegion);
+
+	return getUploadBatchToken();
+}
+
+void BufferManager::reclaimStaging() {
+	while (!pendingUploads.empty()) {
+		PendingUpload& upload = pendingUploads.front();
+		if (vkGetFenceStatus(bufferManager_logicalDevice, upload.fence) != VK_SUCCESS) break;
+
+		retireUpload(upload);
+		pendingUploads.pop_front();
+	}
+
+	releaseCompletedStaging();
+}
+
+void BufferManager::waitForUploads(UploadToken token) {
+	if (uploadBatchCommandBuffer != VK_NULL_HANDLE && token.value >= uploadBatchValue) {
+		flushUploads();
+	}
+
+	while (!pendingUploads.empty() && pendingUploads.front().fenceValue <= token.value) {
+		PendingUpload& upload = pendingUploads.front();
+
+		VkResult result = vkWaitForFences(bufferManager_logicalDevice, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+		if (result != VK_SUCCESS) {
+			std::cerr << "[BufferManager] vkWaitForFences failed: " << result << std::endl;
+			throw std::runtime_error("Failed to wait for upload fence");
+		}
+
+		retireUpload(upload);
+		pendingUploads.pop_front();
+	}
+
+	releaseCompletedStaging();
+}
+
+VkFence BufferManager::acquireUploadFence() {
+	if (!freeUploadFences.empty()) {
+		VkFence fence = freeUploadFences.back();
+		freeUploadFences.pop_back();
+		return fence;
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (vkCreateFence(bufferManager_logicalDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create upload fence");
+	}
+
+	return fence;
+}
+
+// Submits complete in order on the queue, so the completed value only ever moves forward
+void BufferManager::retireUpload(const PendingUpload& upload) {
+	completedUploadValue = std::max(completedUploadValue, upload.fenceValue);
+
+	vkResetFences(bufferManager_logicalDevice, 1, &upload.fence);
+	freeUploadFences.push_back(upload.fence);
+
+	if (upload.commandBuffer != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(bufferManager_logicalDevice, upload.commandPool, 1, &upload.commandBuffer);
+	}
+	if (upload.acquireCommandBuffer != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(bufferManager_logicalDevice, acquireCommandPool, 1, &upload.acquireCommandBuffer);
+	}
+	if (upload.semaphore != VK_NULL_HANDLE) {
+		freeUploadSemaphores.push_back(upload.semaphore);
+	}
+}
+
+VkSemaphore BufferManager::acquireUploadSemaphore() {
+	if (!freeUploadSemaphores.empty()) {
+		VkSemaphore semaphore = freeUploadSemaphores.back();
+		freeUploadSemaphores.pop_back();
+		return semaphore;
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	if (vkCreateSemaphore(bufferManager_logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create upload semaphore");
+	}
+
+	return semaphore;
+}
+
+void BufferManager::releaseCompletedStaging() {
+	stagingRing.reclaim(completedUploadValue);
+
+	while (!overflowStaging.empty()
+		&& overflowStaging.front().fenceValue != 0
+		&& overflowStaging.front().fenceValue <= completedUploadValue) {
+		getBuffer(overflowStaging.front().name)->cleanup();
+		removeBufferByName(overflowStaging.front().name);
+		overflowStaging.pop_front();
+	}
+}
+
 // == Deletion function == 
+// == Defragmentation ==
+std::shared_ptr<Buffer> BufferManager::relocateBuffer(BufferHandle handle, VkCommandPool commandPool) {
+	std::shared_ptr<Buffer>* buffer = buffers.get(handle);
+	if (buffer == nullptr || !*buffer) return nullptr;
+
+	Buffer& live = **buffer;
+	const VkBufferUsageFlags transferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	if (live.getMappedPtr() != nullptr || (live.getUsage() & transferUsage) != transferUsage) return nullptr;
+
+	//Same usage and placement, the allocator skips blocks that are being emptied
+	auto storage = std::make_shared<Buffer>(
+		BufferType::GENERIC,
+		live.getName() + "_relocated",
+		live.getSize(),
+		bufferManager_logicalDevice,
+		bufferManager_physicalDevice,
+		bufferManager_memoryAllocator,
+		std::nullopt,
+		std::nullopt
+	);
+
+	storage->setSharedQueueFamilies(live.getSharedQueueFamilies());
+	storage->createBuffer(bufferManager_logicalDevice, bufferManager_physicalDevice,
+		live.getUsage(), live.getProperties(), live.getSize(), live.getMemoryUsage());
+
+	if (storage->hasErrors()) {
+		storage->printErrors();
+		storage->cleanup();
+		return nullptr;
+	}
+
+	VkBufferCopy region{};
+	region.size = live.getSize();
+
+	if (!useTransferQueue) {
+		//Uploads into `live` recorded earlier in the open batch have no barrier of their own yet
+		// -> order them before the relocation reads the buffer, submitted batches are covered by their closing barrier
+		VkMemoryBarrier pendingWrites{};
+		pendingWrites.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		pendingWrites.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		pendingWrites.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(getUploadCommandBuffer(commandPool),
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &pendingWrites, 0, nullptr, 0, nullptr
+		);
+
+		//Ordered before the next frame by the batch's closing barrier
+		recordBufferCopy(commandPool, live.getHandle(), storage->getHandle(), region);
+	}
+	else {
+		//Frames read the source on the graphics queue -> copy there, pending uploads into it run on the transfer queue
+		// -> wait for them first, the new storage would otherwise miss a copy that lands in the old memory
+		waitForUploads(getUploadBatchToken());
+
+		VkCommandBuffer commandBuffer = beginOneTimeCommands(commandPool);
+		vkCmdCopyBuffer(commandBuffer, live.getHandle(), storage->getHandle(), 1, &region);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+			| VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+			| VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+			| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr
+		);
+
+		endOneTimeCommands(commandBuffer, commandPool);
+	}
+
+	if (live.getUsage() & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+		VkBufferDeviceAddressInfo addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = storage->getHandle();
+		storage->setDeviceAddress(getBufferDeviceAddressFunc(bufferManager_logicalDevice, &addressInfo));
+	}
+
+	//Everyone keeps pointing at `live`, which now owns the new memory
+	live.swapStorage(*storage);
+	return storage;
+}
+
+void BufferManager::removeBuffer(BufferHandle handle) {
+	std::shared_ptr<Buffer>* buffer = buffers.get(handle);
+	if (buffer == nullptr) return;
+
+	std::cout << "Removing buffer : [" << (*buffer)->getName() << "]" << std::endl;
+
+	auto it = bufferNames.find((*buffer)->getName());
+	if (it != bufferNames.end() && it->second == handle) {
+		bufferNames.erase(it);
+	}
+
+	buffers.remove(handle);
+};
+
+void BufferManager::destroyBuffer(BufferHandle handle) {
+	std::shared_ptr<Buffer>* buffer = buffers.get(handle);
+	if (buffer == nullptr) return;
+
+	std::shared_ptr<Buffer> retired = *buffer;
+	removeBuffer(handle);
+
+	deletionQueue.push([retired]() {
+		retired->cleanup();
+	});
+}
+
 void BufferManager::removeBufferByName(const std::string name) {
-	auto it = buffers.find(name);
-	if (it != buffers.end()) {
-		std::cout << "Removing buffer : [" << name << "]" << std::endl;
-		buffers.erase(it);
+	auto it = bufferNames.find(name);
+	if (it != bufferNames.end()) {
+		removeBuffer(it->second);
 	} else {
 		std::cout << "Buffer [" << name << "] not found" << std::endl;
 	};
 };
 
 // == Retreival functions == 
+Buffer* BufferManager::getBuffer(BufferHandle handle) const {
+	const std::shared_ptr<Buffer>* buffer = buffers.get(handle);
+	return buffer != nullptr ? buffer->get() : nullptr;
+};
+
 std::shared_ptr<Buffer> BufferManager::getBuffer(const std::string& name) {
-	auto it = buffers.find(name);
-	if (it == buffers.end()) {
+	auto it = bufferNames.find(name);
+	if (it == bufferNames.end()) {
 		throw std::runtime_error("Buffer" + name + " not found BufferManager::getBuffer()");
 	}
 
-	return it->second;
+	return *buffers.get(it->second);
+};
+
+BufferHandle BufferManager::findBuffer(const std::string& name) const {
+	auto it = bufferNames.find(name);
+	return it != bufferNames.end() ? it->second : BufferHandle{};
 };
 
 // == Cleanup functions == 
 void BufferManager::cleanup() {
 	std::cout << "    Destroying `BufferManager` " << std::endl;
+
+	//Anything still waiting on a frame to retire goes now, the device is idle
+	deletionQueue.flushAll();
+
 	//Destroy all managed buffers - do the same for image manager and add .reset call to renderer cleanup
-	for (auto& pair : buffers) {
-		std::cout << "Cleaning buffer with key: " << pair.first << std::endl;
-		pair.second->cleanup();
-	}
+	buffers.forEach([](BufferHandle, std::shared_ptr<Buffer>& buffer) {
+		std::cout << "Cleaning buffer with key: " << buffer->getName() << std::endl;
+		buffer->cleanup();
+	});
 
 	buffers.clear();
+	bufferNames.clear();
+	overflowStaging.clear();
+
+	//Device is idle by now -> the command buffers go away with their pools
+	for (const PendingUpload& upload : pendingUploads) {
+		vkDestroyFence(bufferManager_logicalDevice, upload.fence, nullptr);
+		if (upload.semaphore != VK_NULL_HANDLE) vkDestroySemaphore(bufferManager_logicalDevice, upload.semaphore, nullptr);
+	}
+	for (VkFence fence : freeUploadFences) {
+		vkDestroyFence(bufferManager_logicalDevice, fence, nullptr);
+	}
+	for (VkSemaphore semaphore : freeUploadSemaphores) {
+		vkDestroySemaphore(bufferManager_logicalDevice, semaphore, nullptr);
+	}
+	freeUploadSemaphores.clear();
+
+	if (transferCommandPool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(bufferManager_logicalDevice, transferCommandPool, nullptr);
+		transferCommandPool = VK_NULL_HANDLE;
+	}
+	if (acquireCommandPool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(bufferManager_logicalDevice, acquireCommandPool, nullptr);
+		acquireCommandPool = VK_NULL_HANDLE;
+	}
+	pendingImageAcquires.clear();
+	pendingUploads.clear();
+	freeUploadFences.clear();
+	uploadBatchCommandBuffer = VK_NULL_HANDLE;
+	uploadBatchCommandPool = VK_NULL_HANDLE;
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "../include/Managers/Defragmenter.h"
+#include "../include/Managers/MemoryAllocator.h"
+#include "../include/Managers/BufferManager.h"
+#include "../include/Managers/ImageManager.h"
+#include "../include/Managers/Buffer.h"
+#include "../include/Managers/Image.h"
+
+Defragmenter::Defragmenter(
+	std::shared_ptr<MemoryAllocator> memoryAllocator,
+	std::shared_ptr<BufferManager> bufferManager,
+	std::shared_ptr<ImageManager> imageManager
+) : defrag_memoryAllocator(memoryAllocator), defrag_bufferManager(bufferManager), defrag_imageManager(imageManager) {};
+
+bool Defragmenter::begin(float maxBlockUsage) {
+	if (running) {
+		std::cout << "[Defragmenter] A pass is already running" << std::endl;
+		return false;
+	}
+
+	report = DefragmentationReport{};
+	reservedBefore = defrag_memoryAllocator->getReservedBytes();
+
+	if (defrag_memoryAllocator->beginDefragmentation(maxBlockUsage) == 0) {
+		defrag_memoryAllocator->endDefragmentation();
+		std::cout << "[Defragmenter] No sparse blocks, nothing to compact" << std::endl;
+		return false;
+	}
+
+	//Everything sitting in a source block has to move, whether it can is checked when it's its turn
+	defrag_bufferManager->forEachBuffer([&](BufferHandle handle, Buffer& buffer) {
+		if (defrag_memoryAllocator->isInDefragSource(buffer.getAllocation())) {
+			pendingMoves.push_back({ handle, ImageHandle{} });
+		}
+	});
+
+	if (defrag_imageManager) {
+		defrag_imageManager->forEachImage([&](ImageHandle handle, Image& image) {
+			if (defrag_memoryAllocator->isInDefragSource(image.getAllocation())) {
+				pendingMoves.push_back({ BufferHandle{}, handle });
+			}
+		});
+	}
+
+	running = true;
+	started = false;
+	lastRetireFrame = 0;
+
+	std::cout << "[Defragmenter] Started, " << pendingMoves.size() << " resources to move" << std::endl;
+	return true;
+}
+
+void Defragmenter::step(uint64_t frameNumber, VkCommandPool commandPool) {
+	if (!running) return;
+
+	if (!started) {
+		startFrame = frameNumber;
+		started = true;
+	}
+
+	VkDeviceSize bytesThisFrame = 0;
+	while (!pendingMoves.empty() && bytesThisFrame < maxBytesPerFrame) {
+		moveNext(commandPool, bytesThisFrame);
+	}
+
+	//Done once every move was made and every old allocation was given back
+	if (pendingMoves.empty() && frameNumber >= lastRetireFrame) {
+		finish(frameNumber);
+	}
+}
+
+void Defragmenter::moveNext(VkCommandPool commandPool, VkDeviceSize& bytesThisFrame) {
+	PendingMove move = pendingMoves.front();
+	pendingMoves.pop_front();
+
+	DeletionQueue& deletionQueue = defrag_bufferManager->getDeletionQueue();
+
+	if (move.buffer.isValid()) {
+		//Removed or recreated(ex. grown) since the pass started -> already out of the source block
+		Buffer* buffer = defrag_bufferManager->getBuffer(move.buffer);
+		if (buffer == nullptr || !defrag_memoryAllocator->isInDefragSource(buffer->getAllocation())) return;
+
+		std::shared_ptr<Buffer> retired = defrag_bufferManager->relocateBuffer(move.buffer, commandPool);
+		if (!retired) return;
+
+		report.buffersMoved++;
+		report.bytesMoved += retired->getSize();
+		bytesThisFrame += retired->getSize();
+
+		deletionQueue.push([retired]() { retired->cleanup(); });
+	}
+	else {
+		Image* image = defrag_imageManager->getImage(move.image);
+		if (image == nullptr || !defrag_memoryAllocator->isInDefragSource(image->getAllocation())) return;
+
+		std::shared_ptr<Image> retired = defrag_imageManager->relocateImage(move.image, commandPool);
+		if (!retired) return;
+
+		report.imagesMoved++;
+		report.bytesMoved += retired->getMemorySize();
+		bytesThisFrame += retired->getMemorySize();
+
+		deletionQueue.push([retired]() { retired->cleanup(); });
+	}
+
+	lastRetireFrame = deletionQueue.getRetireFrame();
+}
+
+void Defragmenter::finish(uint64_t frameNumber) {
+	defrag_memoryAllocator->endDefragmentation();
+	running = false;
+
+	VkDeviceSize reservedAfter = defrag_memoryAllocator->getReservedBytes();
+	report.bytesReclaimed = reservedBefore > reservedAfter ? reservedBefore - reservedAfter : 0;
+	report.framesTaken = frameNumber - startFrame;
+
+	std::cout << "[Defragmenter] Finished in " << report.framesTaken << " frames -> moved "
+		<< report.buffersMoved << " buffers and " << report.imagesMoved << " images ("
+		<< report.bytesMoved << " bytes), reclaimed " << report.bytesReclaimed << " bytes" << std::endl;
+}
+
+void Defragmenter::cleanup() {
+	pendingMoves.clear();
+
+	if (running) {
+		defrag_memoryAllocator->endDefragmentation();
+		running = false;
+	}
+}
@@ -0,0 +1,49 @@
+#include "../include/Managers/DeletionQueue.h"
+
+void DeletionQueue::push(std::function<void()> destroy) {
+	std::lock_guard<std::mutex> lock(queueMutex);
+
+	Entry entry{};
+	entry.retireFrame = currentFrame + MAX_FRAMES_IN_FLIGHT;
+	entry.destroy = std::move(destroy);
+	entries.push_back(std::move(entry));
+}
+
+void DeletionQueue::flush(uint64_t frameNumber) {
+	//Run outside the lock, destroying a resource may push another request
+	std::vector<std::function<void()>> retired;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		currentFrame = frameNumber;
+
+		while (!entries.empty() && entries.front().retireFrame <= frameNumber) {
+			retired.push_back(std::move(entries.front().destroy));
+			entries.pop_front();
+		}
+	}
+
+	for (auto& destroy : retired) {
+		destroy();
+	}
+}
+
+void DeletionQueue::flushAll() {
+	std::deque<Entry> retired;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		retired.swap(entries);
+	}
+
+	if (!retired.empty()) {
+		std::cout << "[DeletionQueue] Destroying " << retired.size() << " deferred resources" << std::endl;
+	}
+
+	for (auto& entry : retired) {
+		entry.destroy();
+	}
+}
+
+size_t DeletionQueue::size() const {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return entries.size();
+}
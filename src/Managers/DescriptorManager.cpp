@@ -3,39 +3,42 @@
 #include "../include/Managers/Buffer.h"
 #include "../include/System_Components/Camera.h"
 
-//EACH MESH SHOULD CREATE ITS OWN UNIFORM BUFFER
-void DescriptorManager::createUniformBuffers() {
-	VkDeviceSize bufferSize = sizeof(UBO);
-	std::cout << "Creating uniform buffers : [" << bufferSize << "]" << std::endl;
-
-	ubufInfo.resize(MAX_FRAMES_IN_FLIGHT);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		std::string ubufName = "ubuf" + std::to_string(i);
-
-		descManager_bufferManager->createBuffer(
-			BufferType::UNIFORM,
-			ubufName,
-			bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			std::nullopt,
-			std::nullopt
-		);
-
-		//FIX VERTEX AND INDEX BUFFER SETUP FOR NEW BUFFER AND BUFFERMANAGER
-		std::shared_ptr<Buffer> ubuf = descManager_bufferManager->getBuffer(ubufName);
-		void* mappedPtr = nullptr;
-
-		VkResult mapResult = vkMapMemory(descManager_logicalDevice, ubuf->getMemory(), 0, bufferSize, 0, &mappedPtr);
-		if (mapResult != VK_SUCCESS) {
-			throw std::runtime_error("Ubuf `vkMapMemory` operation failed");
-		} 
-		
-		ubufInfo[i] = { mappedPtr, ubuf };
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	if (alignment <= 1) return value;
+	return (value + alignment - 1) / alignment * alignment;
+}
 
-		std::cout << "Mapped [" << ubufName << "] to [ptr:" << i << "]- result: [" << mapResult << "]";
-	}
+void DescriptorManager::createUniformBuffers(uint32_t views) {
+	viewsPerFrame = std::max<uint32_t>(views, 1);
+
+	//Dynamic offsets have to be multiples of minUniformBufferOffsetAlignment
+	VkPhysicalDeviceProperties deviceProperties{};
+	vkGetPhysicalDeviceProperties(descManager_physicalDevice, &deviceProperties);
+	uniformSliceSize = alignUp(sizeof(UBO), deviceProperties.limits.minUniformBufferOffsetAlignment);
+
+	VkDeviceSize bufferSize = uniformSliceSize * viewsPerFrame * MAX_FRAMES_IN_FLIGHT;
+	std::cout << "Creating dynamic uniform buffer : [" << bufferSize << "] -> " << viewsPerFrame * MAX_FRAMES_IN_FLIGHT
+		<< " slices of " << uniformSliceSize << " bytes" << std::endl;
+
+	descManager_bufferManager->createBuffer(
+		BufferType::UNIFORM,
+		"ubuf_dynamic",
+		bufferSize,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::UPLOAD_PER_FRAME
+	);
+
+	std::shared_ptr<Buffer> ubuf = descManager_bufferManager->getBuffer("ubuf_dynamic");
+	//Host visible buffers are persistently mapped by the allocator
+	void* mappedPtr = ubuf->getMappedPtr();
+	if (mappedPtr == nullptr) {
+		throw std::runtime_error("Ubuf is not host visible, cannot map");
+	} 
+	
+	uniformBuffer = { mappedPtr, ubuf };
 }
 
 void DescriptorManager::createDescriptorPool(int meshCount, int materialCount) {
@@ -48,7 +51,7 @@ void DescriptorManager::createDescriptorPool(int meshCount, int materialCount) {
 	uint32_t materialDescriptorCount = totalMaterials * MAX_FRAMES_IN_FLIGHT;
 
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
 		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,        static_cast<uint32_t>(ssboSpace) },
 		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, materialDescriptorCount }
 	};
@@ -59,7 +62,7 @@ void DescriptorManager::createDescriptorPool(int meshCount, int materialCount) {
 	poolInfo.pPoolSizes = poolSizes.data();
 	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 	poolInfo.maxSets = static_cast<uint32_t>(
-		MAX_FRAMES_IN_FLIGHT * (1 + ssboSpace + totalMaterials)
+		1 + MAX_FRAMES_IN_FLIGHT * (ssboSpace + totalMaterials)
 		);
 
 
@@ -68,40 +71,32 @@ void DescriptorManager::createDescriptorPool(int meshCount, int materialCount) {
 	}
 }
 
+//Frames in flight and views share one set, they only differ in the dynamic offset bound with it
 void DescriptorManager::createPerFrameDescriptors() {
 	std::cout << "Creating descriptor sets" << std::endl;
 
-	bool layoutBuilt = false; 
-
-	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		DescriptorBuilder builder = DescriptorBuilder::begin(descManager_logicalDevice);
-		
-		std::string ubufName = "ubuf" + std::to_string(i);
-
-		std::cout << "---> BINDING BUFFER: [" << ubufName << "]" << std::endl;
-
-		std::shared_ptr<Buffer> ubuf = descManager_bufferManager->getBuffer(ubufName);
-		VkBuffer ubufHandle = ubuf->getHandle();
+	std::shared_ptr<Buffer> ubuf = uniformBuffer.buffer;
+	if (!ubuf || ubuf->getHandle() == VK_NULL_HANDLE) {
+		throw std::runtime_error("Failed to retrieve valid uniform buffer: ubuf_dynamic");
+	}
 
-		if (!ubuf || ubuf->getHandle() == VK_NULL_HANDLE) {
-			throw std::runtime_error("Failed to retrieve valid uniform buffer: " + ubufName);
-		}
+	std::cout << "---> BINDING BUFFER: [ubuf_dynamic]" << std::endl;
 
-		//Write the descriptor info to the buffer
-		builder.bindBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, ubufHandle, sizeof(UBO));
+	DescriptorBuilder builder = DescriptorBuilder::begin(descManager_logicalDevice);
 
-		if (!layoutBuilt) {
-			builder.buildLayout(descriptorSetLayout, false);
-			layoutBuilt = true;
-		};
+	//Range is a single slice, the offset is supplied at bind time
+	// -> compute reads the camera too(GPU culling binds this set at set 0)
+	builder.bindBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, ubuf->getHandle(), sizeof(UBO));
 
-		builder.buildSet(descriptorSetLayout, descriptorSets[i], descriptorPool, false);
-	};
+	builder.buildLayout(descriptorSetLayout, false);
+	builder.buildSet(descriptorSetLayout, descriptorSet, descriptorPool, false);
 };
 
-void DescriptorManager::updateUniformBuffer(uint32_t currentImage, VkExtent2D swapchainExtent) {
+uint32_t DescriptorManager::getUniformOffset(uint32_t currentFrame, uint32_t viewIndex) const {
+	return static_cast<uint32_t>((currentFrame * viewsPerFrame + viewIndex) * uniformSliceSize);
+}
+
+uint32_t DescriptorManager::updateUniformBuffer(uint32_t currentFrame, VkExtent2D swapchainExtent, uint32_t viewIndex) {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
@@ -128,10 +123,10 @@ void DescriptorManager::updateUniformBuffer(uint32_t currentImage, VkExtent2D sw
 		<< descManager_camera->front.y << ", "
 		<< descManager_camera->front.z << std::endl;
 
-	//ptrs should be map, perhaps even grouped into a struct `UBOInfo` *** 
-	void* & ptr = ubufInfo[currentImage].mappedPtr;
+	uint32_t offset = getUniformOffset(currentFrame, viewIndex);
+	memcpy(static_cast<char*>(uniformBuffer.mappedPtr) + offset, &ubo, sizeof(ubo));
 
-	memcpy(ptr, &ubo, sizeof(ubo));
+	return offset;
 };
 
 void DescriptorManager::cleanup() {
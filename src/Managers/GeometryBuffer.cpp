@@ -0,0 +1,310 @@
+#include "../include/Managers/GeometryBuffer.h"
+#include "../include/Managers/BufferManager.h"
+#include "../include/Managers/Buffer.h"
+
+// == FREE RANGE LIST ==
+void FreeRangeList::reset(uint32_t newCapacity) {
+	freeRanges.clear();
+	capacity = newCapacity;
+	used = 0;
+
+	if (capacity > 0) {
+		freeRanges[0] = capacity;
+	}
+}
+
+void FreeRangeList::grow(uint32_t newCapacity) {
+	if (newCapacity <= capacity) return;
+
+	insertFreeRange(capacity, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
+std::optional<uint32_t> FreeRangeList::allocate(uint32_t count) {
+	if (count == 0) return std::nullopt;
+
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second < count) continue;
+
+		uint32_t offset = it->first;
+		uint32_t remaining = it->second - count;
+		freeRanges.erase(it);
+
+		if (remaining > 0) {
+			freeRanges[offset + count] = remaining;
+		}
+
+		used += count;
+		return offset;
+	}
+
+	return std::nullopt;
+}
+
+void FreeRangeList::release(uint32_t offset, uint32_t count) {
+	if (count == 0) return;
+
+	insertFreeRange(offset, count);
+	used -= count;
+}
+
+void FreeRangeList::insertFreeRange(uint32_t offset, uint32_t count) {
+	auto next = freeRanges.lower_bound(offset);
+
+	//Merge with the range directly after
+	if (next != freeRanges.end() && offset + count == next->first) {
+		count += next->second;
+		next = freeRanges.erase(next);
+	}
+
+	//Merge with the range directly before
+	if (next != freeRanges.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			prev->second += count;
+			return;
+		}
+	}
+
+	freeRanges[offset] = count;
+}
+
+uint32_t FreeRangeList::getLargestFreeRange() const {
+	uint32_t largest = 0;
+	for (const auto& [offset, count] : freeRanges) {
+		largest = std::max(largest, count);
+	}
+	return largest;
+}
+
+// == GEOMETRY BUFFER ==
+GeometryBuffer::GeometryBuffer(
+	std::shared_ptr<BufferManager> bufferManager,
+	uint32_t initialVertexCapacity,
+	uint32_t initialIndexCapacity
+) : geometry_bufferManager(bufferManager), initialVertexCapacity(initialVertexCapacity), initialIndexCapacity(initialIndexCapacity)
+{
+	std::cout << "Constructed GeometryBuffer -> initial capacity : [" << initialVertexCapacity << " vertices, "
+		<< initialIndexCapacity << " indices]" << std::endl;
+}
+
+void GeometryBuffer::createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity) {
+	vertexBufferName = "geometry_vertices" + std::to_string(generation);
+	indexBufferName = "geometry_indices" + std::to_string(generation);
+
+	//TRANSFER_SRC is needed so the contents can be copied over when growing
+	geometry_bufferManager->createBuffer(
+		BufferType::GENERIC,
+		vertexBufferName,
+		static_cast<VkDeviceSize>(vertexCapacity) * sizeof(Vertex),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			| geometry_bufferManager->getDeviceAddressUsage(),
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::GPU_ONLY
+	);
+
+	geometry_bufferManager->createBuffer(
+		BufferType::GENERIC,
+		indexBufferName,
+		static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+			| geometry_bufferManager->getDeviceAddressUsage(),
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::GPU_ONLY
+	);
+
+	vertexBuffer = geometry_bufferManager->getBuffer(vertexBufferName);
+	indexBuffer = geometry_bufferManager->getBuffer(indexBufferName);
+
+	if (vertexBuffer->hasErrors()) vertexBuffer->printErrors();
+	if (indexBuffer->hasErrors()) indexBuffer->printErrors();
+
+	vertexRanges.reset(vertexCapacity);
+	indexRanges.reset(indexCapacity);
+}
+
+GeometryRange GeometryBuffer::upload(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, VkCommandPool commandPool) {
+	GeometryRange range{};
+
+	if (vertices.empty() || indices.empty()) {
+		std::cerr << "[GeometryBuffer] Skipping upload of empty primitive" << std::endl;
+		return range;
+	}
+
+	if (!isCreated()) {
+		createBuffers(
+			std::max(initialVertexCapacity, static_cast<uint32_t>(vertices.size())),
+			std::max(initialIndexCapacity, static_cast<uint32_t>(indices.size()))
+		);
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+	//Find free ranges -> grow if there is no room left
+	std::optional<uint32_t> vertexOffset = vertexRanges.allocate(vertexCount);
+	if (!vertexOffset.has_value()) {
+		growVertexBuffer(vertexRanges.getCapacity() + vertexCount, commandPool);
+		vertexOffset = vertexRanges.allocate(vertexCount);
+	}
+
+	std::optional<uint32_t> firstIndex = indexRanges.allocate(indexCount);
+	if (!firstIndex.has_value()) {
+		growIndexBuffer(indexRanges.getCapacity() + indexCount, commandPool);
+		firstIndex = indexRanges.allocate(indexCount);
+	}
+
+	if (!vertexOffset.has_value() || !firstIndex.has_value()) {
+		throw std::runtime_error("Failed to find room in the geometry buffers");
+	}
+
+	VkDeviceSize verticesSize = sizeof(Vertex) * vertices.size();
+	VkDeviceSize indicesSize = sizeof(uint32_t) * indices.size();
+
+	//Both halves go through the staging ring and are recorded into the open upload batch
+	// -> each copy is recorded before the next slice is allocated, a full ring may flush the batch in between
+	StagingAllocation vertexStaging = geometry_bufferManager->allocateStaging(verticesSize, sizeof(Vertex));
+	memcpy(vertexStaging.mappedPtr, vertices.data(), (size_t)verticesSize);
+
+	VkBufferCopy vertexCopy{};
+	vertexCopy.srcOffset = vertexStaging.offset;
+	vertexCopy.dstOffset = static_cast<VkDeviceSize>(vertexOffset.value()) * sizeof(Vertex);
+	vertexCopy.size = verticesSize;
+	geometry_bufferManager->recordBufferCopy(commandPool, vertexStaging.buffer, vertexBuffer->getHandle(), vertexCopy);
+
+	StagingAllocation indexStaging = geometry_bufferManager->allocateStaging(indicesSize, sizeof(uint32_t));
+	memcpy(indexStaging.mappedPtr, indices.data(), (size_t)indicesSize);
+
+	VkBufferCopy indexCopy{};
+	indexCopy.srcOffset = indexStaging.offset;
+	indexCopy.dstOffset = static_cast<VkDeviceSize>(firstIndex.value()) * sizeof(uint32_t);
+	indexCopy.size = indicesSize;
+	geometry_bufferManager->recordBufferCopy(commandPool, indexStaging.buffer, indexBuffer->getHandle(), indexCopy);
+
+	range.vertexOffset = vertexOffset.value();
+	range.vertexCount = vertexCount;
+	range.firstIndex = firstIndex.value();
+	range.indexCount = indexCount;
+	range.resident = true;
+
+	std::cout << "[GeometryBuffer] Uploaded primitive -> vertexOffset: " << range.vertexOffset
+		<< ", firstIndex: " << range.firstIndex << ", indexCount: " << range.indexCount << std::endl;
+
+	return range;
+}
+
+void GeometryBuffer::release(GeometryRange& range) {
+	if (!range.resident) return;
+
+	vertexRanges.release(range.vertexOffset, range.vertexCount);
+	indexRanges.release(range.firstIndex, range.indexCount);
+
+	range = GeometryRange{};
+}
+
+// == Growing ==
+// copyBuffer submits the open upload batch first and waits on its own fence, the old buffer is destroyed once the frames drawing from it retire
+void GeometryBuffer::growVertexBuffer(uint32_t minCapacity, VkCommandPool commandPool) {
+	uint32_t oldCapacity = vertexRanges.getCapacity();
+	uint32_t newCapacity = std::max(oldCapacity * 2, minCapacity);
+
+	std::cout << "[GeometryBuffer] Growing vertex buffer : [" << oldCapacity << " -> " << newCapacity << "]" << std::endl;
+
+	std::string oldName = vertexBufferName;
+	std::shared_ptr<Buffer> oldBuffer = vertexBuffer;
+
+	generation++;
+	vertexBufferName = "geometry_vertices" + std::to_string(generation);
+
+	geometry_bufferManager->createBuffer(
+		BufferType::GENERIC,
+		vertexBufferName,
+		static_cast<VkDeviceSize>(newCapacity) * sizeof(Vertex),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			| geometry_bufferManager->getDeviceAddressUsage(),
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::GPU_ONLY
+	);
+	vertexBuffer = geometry_bufferManager->getBuffer(vertexBufferName);
+
+	geometry_bufferManager->copyBuffer(oldBuffer, vertexBuffer, static_cast<VkDeviceSize>(oldCapacity) * sizeof(Vertex), commandPool);
+
+	//Frames in flight may still have the old buffer bound
+	geometry_bufferManager->destroyBuffer(geometry_bufferManager->findBuffer(oldName));
+
+	vertexRanges.grow(newCapacity);
+}
+
+void GeometryBuffer::growIndexBuffer(uint32_t minCapacity, VkCommandPool commandPool) {
+	uint32_t oldCapacity = indexRanges.getCapacity();
+	uint32_t newCapacity = std::max(oldCapacity * 2, minCapacity);
+
+	std::cout << "[GeometryBuffer] Growing index buffer : [" << oldCapacity << " -> " << newCapacity << "]" << std::endl;
+
+	std::string oldName = indexBufferName;
+	std::shared_ptr<Buffer> oldBuffer = indexBuffer;
+
+	generation++;
+	indexBufferName = "geometry_indices" + std::to_string(generation);
+
+	geometry_bufferManager->createBuffer(
+		BufferType::GENERIC,
+		indexBufferName,
+		static_cast<VkDeviceSize>(newCapacity) * sizeof(uint32_t),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+			| geometry_bufferManager->getDeviceAddressUsage(),
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		std::nullopt,
+		std::nullopt,
+		MemoryUsage::GPU_ONLY
+	);
+	indexBuffer = geometry_bufferManager->getBuffer(indexBufferName);
+
+	geometry_bufferManager->copyBuffer(oldBuffer, indexBuffer, static_cast<VkDeviceSize>(oldCapacity) * sizeof(uint32_t), commandPool);
+
+	//Frames in flight may still have the old buffer bound
+	geometry_bufferManager->destroyBuffer(geometry_bufferManager->findBuffer(oldName));
+
+	indexRanges.grow(newCapacity);
+}
+
+// == Draw helpers ==
+void GeometryBuffer::bind(VkCommandBuffer commandBuffer) const {
+	if (!isCreated()) return;
+
+	VkBuffer vertexBuffers[] = { vertexBuffer->getHandle() };
+	VkDeviceSize offsets[] = { 0 };
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getHandle(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+VkBuffer GeometryBuffer::getVertexBuffer() const {
+	return vertexBuffer ? vertexBuffer->getHandle() : VK_NULL_HANDLE;
+}
+
+VkBuffer GeometryBuffer::getIndexBuffer() const {
+	return indexBuffer ? indexBuffer->getHandle() : VK_NULL_HANDLE;
+}
+
+VkDeviceAddress GeometryBuffer::getVertexBufferAddress() const {
+	return vertexBuffer ? vertexBuffer->getDeviceAddress() : 0;
+}
+
+VkDeviceAddress GeometryBuffer::getIndexBufferAddress() const {
+	return indexBuffer ? indexBuffer->getDeviceAddress() : 0;
+}
+
+void GeometryBuffer::printStats() const {
+	std::cout << "=== GeometryBuffer stats ===" << std::endl;
+	std::cout << "  vertices: " << vertexRanges.getUsed() << " / " << vertexRanges.getCapacity()
+		<< " (free ranges: " << vertexRanges.getFreeRangeCount() << ", largest: " << vertexRanges.getLargestFreeRange() << ")" << std::endl;
+	std::cout << "  indices: " << indexRanges.getUsed() << " / " << indexRanges.getCapacity()
+		<< " (free ranges: " << indexRanges.getFreeRangeCount() << ", largest: " << indexRanges.getLargestFreeRange() << ")" << std::endl;
+}
@@ -12,9 +12,9 @@ bool hasStencilComponent(VkFormat format) {
 };
 
 Image::Image(
-	VkDevice logicalDevice, VkPhysicalDevice physicalDevice
+	VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<MemoryAllocator> allocator
 )
-	: imageLogicalDevice(logicalDevice), imagePhysicalDevice(physicalDevice) {
+	: imageLogicalDevice(logicalDevice), imagePhysicalDevice(physicalDevice), imageAllocator(allocator) {
 		std::cout << "Constructed image" << std::endl;
 };
 
@@ -23,7 +23,6 @@ void Image::createTextureImage(
 	int texWidth, 
 	int texHeight,
 	VkCommandPool commandPool, 
-	std::shared_ptr<Buffer> stagingBuf, 
 	std::shared_ptr<BufferManager> bufferManager
 ) {
 	//DEBUG
@@ -44,16 +43,16 @@ void Image::createTextureImage(
 		std::cout << "image size: " << imageSize << std::endl;
 	};
 
-	void* data;
-	vkMapMemory(imageLogicalDevice, stagingBuf->getMemory(), 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(imageLogicalDevice, stagingBuf->getMemory());
-
 	createImage(texWidth, texHeight, VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, commandPool, bufferManager);
-	copyBufferToImage(stagingBuf->getHandle(), commandPool, bufferManager);
+
+	//Stage right before the copy so the slice is tagged with the copy's submit
+	StagingAllocation staging = bufferManager->allocateStaging(imageSize, 16);
+	memcpy(staging.mappedPtr, pixels, static_cast<size_t>(imageSize));
+
+	copyBufferToImage(staging.buffer, commandPool, bufferManager, staging.offset);
 	transitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool, bufferManager);
 
 	createImageView();
@@ -82,6 +81,30 @@ void Image::createImage(uint32_t width, uint32_t height,
 	VkImageUsageFlags usage,
 	VkMemoryPropertyFlags properties
 ) {
+	createImageHandle(width, height, usage);
+
+	//Sub-allocate memory for image
+	try {
+		imageAllocation = imageAllocator->allocateForImage(image, properties, MemoryUsage::GPU_ONLY);
+		std::cout << "Allocated image memory successfully -> offset: [" << imageAllocation.offset << "]" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		imageErrors |= IMG_ERROR_ALLOCATION;
+		return;
+	};
+
+	//Bind image to memory
+	VkResult bindImageMemResult = vkBindImageMemory(imageLogicalDevice, image, imageAllocation.memory, imageAllocation.offset);
+
+	if (bindImageMemResult != VK_SUCCESS) {
+		imageErrors |= IMG_ERROR_BIND;
+	} else {
+		std::cout << "Successfully bound image memory" << std::endl;
+	}
+};
+
+void Image::createImageHandle(uint32_t width, uint32_t height, VkImageUsageFlags usage) {
 	imageDetails.imageWidth = width;
 	imageDetails.imageHeight = height;
 
@@ -109,31 +132,32 @@ void Image::createImage(uint32_t width, uint32_t height,
 	} else {
 		std::cout << "Image created -> size :[" << width * height * 4 << "], result: [" << createImageResult << "]" << std::endl;
 	};
+}
 
-	//Allocate memory for image
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(imageLogicalDevice, image, &memRequirements);
+void Image::createAttachmentImage(VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags) {
+	imageDetails.imageFormat = format;
+	imageDetails.imageAspectFlags = aspectFlags;
+	imageDetails.currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = verboseFindMemoryType(imagePhysicalDevice, memRequirements.memoryTypeBits, properties);
+	createImageHandle(extent.width, extent.height, usage);
+}
 
-	if (vkAllocateMemory(imageLogicalDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		imageErrors |= IMG_ERROR_ALLOCATION;
-	} else {
-		std::cout << "Allocated image memory successfully" << std::endl;
-	};
+VkMemoryRequirements Image::getMemoryRequirements() const {
+	VkMemoryRequirements memRequirements{};
+	vkGetImageMemoryRequirements(imageLogicalDevice, image, &memRequirements);
+	return memRequirements;
+}
 
-	//Bind image to memory
-	VkResult bindImageMemResult = vkBindImageMemory(imageLogicalDevice, image, imageMemory, 0);
+void Image::bindExternalMemory(VkDeviceMemory memory, VkDeviceSize offset) {
+	VkResult bindImageMemResult = vkBindImageMemory(imageLogicalDevice, image, memory, offset);
 
 	if (bindImageMemResult != VK_SUCCESS) {
 		imageErrors |= IMG_ERROR_BIND;
-	} else {
-		std::cout << "Successfully bound image memory" << std::endl;
+		throw std::runtime_error("Failed to bind attachment image memory");
 	}
-};
+
+	createImageView();
+}
 
 void Image::transitionImageLayout(VkImageLayout newLayout, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager) {
 	std::cout << "[Image::transitionImageLayout] Entering function\n";
@@ -142,7 +166,8 @@ void Image::transitionImageLayout(VkImageLayout newLayout, VkCommandPool command
 		<< ", New layout: " << newLayout << std::endl;
 	std::cout << "[Image::transitionImageLayout] commnadPool : [" << commandPool << "]" << std::endl;
 
-	VkCommandBuffer commandBuffer = bufferManager->beginOneTimeCommands(commandPool);
+	//Recorded into the open upload batch, submitted with the next flush
+	VkCommandBuffer commandBuffer = bufferManager->getUploadCommandBuffer(commandPool);
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -173,12 +198,14 @@ void Image::transitionImageLayout(VkImageLayout newLayout, VkCommandPool command
 	else if (imageDetails.currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
 		newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
 
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		std::cout << "[Image::transitionImageLayout] Transition: TRANSFER_DST_OPTIMAL → SHADER_READ_ONLY_OPTIMAL\n";
+
+		//The image leaves the upload batch here -> buffer manager handles the queue ownership transfer if there is one
+		bufferManager->releaseImageToGraphics(commandPool, image, barrier.subresourceRange, imageDetails.currentLayout, newLayout);
+
+		imageDetails.currentLayout = newLayout;
+		uploadToken = bufferManager->getUploadBatchToken();
+		return;
 	} else {
 		imageErrors |= IMG_ERROR_TYPE;
 		throw std::invalid_argument("Unsupported layout transition in `Image::transitionImageLayout()`");
@@ -189,12 +216,12 @@ void Image::transitionImageLayout(VkImageLayout newLayout, VkCommandPool command
 		0, 0, nullptr, 0, nullptr, 1, &barrier
 	);
 
-	bufferManager->endOneTimeCommands(commandBuffer, commandPool);
 	imageDetails.currentLayout = newLayout; // Update the layout state
-	std::cout << "[Image::transitionImageLayout] Layout transition completed.\n";
+	uploadToken = bufferManager->getUploadBatchToken();
+	std::cout << "[Image::transitionImageLayout] Layout transition recorded.\n";
 }
 
-void Image::copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager) {
+void Image::copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::shared_ptr<BufferManager> bufferManager, VkDeviceSize bufferOffset) {
 	std::cout << "[Image::copyBufferToImage] Copying buffer to image\n";
 	std::cout << "[Image::copyBufferToImage] VkBuffer: " << buffer << ", VkImage: " << image << std::endl;
 	std::cout << "[Image::copyBufferToImage] Dimensions: " << imageDetails.imageWidth << "x" << imageDetails.imageHeight << std::endl;
@@ -203,10 +230,10 @@ void Image::copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::s
 		imageErrors |= IMG_ERROR_COPY;
 	}
 
-	VkCommandBuffer commandBuffer = bufferManager->beginOneTimeCommands(commandPool);
+	VkCommandBuffer commandBuffer = bufferManager->getUploadCommandBuffer(commandPool);
 
 	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
+	region.bufferOffset = bufferOffset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 
@@ -222,8 +249,8 @@ void Image::copyBufferToImage(VkBuffer buffer, VkCommandPool commandPool, std::s
 
 	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-	bufferManager->endOneTimeCommands(commandBuffer, commandPool);
-	std::cout << "[Image::copyBufferToImage] Copy completed.\n";
+	uploadToken = bufferManager->getUploadBatchToken();
+	std::cout << "[Image::copyBufferToImage] Copy recorded.\n";
 }
 
 void Image::createImageView() {
@@ -6,8 +6,9 @@
 ImageManager::ImageManager(
 	VkDevice logicalDevice, 
 	VkPhysicalDevice physicalDevice, 
-	std::shared_ptr<BufferManager> bufferManager
-) : imageManager_logicalDevice(logicalDevice),imageManager_physicalDevice(physicalDevice), imageManager_bufferManager(bufferManager) 
+	std::shared_ptr<BufferManager> bufferManager,
+	std::shared_ptr<MemoryAllocator> memoryAllocator
+) : imageManager_logicalDevice(logicalDevice),imageManager_physicalDevice(physicalDevice), imageManager_bufferManager(bufferManager), imageManager_memoryAllocator(memoryAllocator) 
 {
 	std::cout << "Successfully constructed ImageManager" << std::endl;
 	std::cout << "     with logical device: " << imageManager_logicalDevice << std::endl;
@@ -15,13 +16,10 @@ ImageManager::ImageManager(
 }
 
 //Load a texture image from a relative path
-void ImageManager::createTextureImage(std::string name, std::string texturePath, VkCommandPool commandPool) {
+ImageHandle ImageManager::createTextureImage(std::string name, std::string texturePath, VkCommandPool commandPool) {
 	std::cout << "ImageManager::createTextureImage entered" << std::endl;
 
-	std::shared_ptr<Image> image = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice);
-	
-	//Create a staging buffer for the new image: 
-	std::string texImageStagingName = "texImage_staging";
+	std::shared_ptr<Image> image = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice, imageManager_memoryAllocator);
 
 	int texWidth, texHeight, texChannels;
 
@@ -31,28 +29,25 @@ void ImageManager::createTextureImage(std::string name, std::string texturePath,
 	std::cout << "Image color channels : " << texChannels << std::endl;
 	std::cout << "imageManager::createTextureImage imageSize: " << imageSize << std::endl;
 
-	imageManager_bufferManager->createBuffer(
-		BufferType::GENERIC_STAGING,
-		texImageStagingName,
-		imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	);
-
-	std::shared_ptr<Buffer> stagingBuf = imageManager_bufferManager->getBuffer("texImage_staging");
-
-	std::cout << "imageManager::createTextureImage stagingBuffer handle: " << stagingBuf->getHandle() << std::endl;
-
-	image->createTextureImage(pixels, texWidth, texHeight, commandPool, stagingBuf, imageManager_bufferManager);
+	//Pixels are staged through the buffer manager's staging ring
+	image->createTextureImage(pixels, texWidth, texHeight, commandPool, imageManager_bufferManager);
 	
 	std::cout << "[Created texture image] : " << name << std::endl;
 
 	stbi_image_free(pixels);
 
-	images[name] = std::move(image);
+	//Reloaded from disk if it ever gets evicted
+	ImageHandle handle = addImage(name, std::move(image));
+	TextureSource source{};
+	source.path = texturePath;
+	source.width = texWidth;
+	source.height = texHeight;
+	textureSources[handle.index] = std::move(source);
+
+	return handle;
 }
 
-void ImageManager::createTextureImage(
+ImageHandle ImageManager::createTextureImage(
 	std::string name, 
 	std::vector<unsigned char>& pixels, 
 	int texWidth, 
@@ -61,100 +56,377 @@ void ImageManager::createTextureImage(
 	) {
 	std::cout << "ImageManager::createTextureImage entered" << std::endl;
 
-	std::shared_ptr<Image> image = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice);
-
-	//Create a staging buffer for the new image: 
-	std::string texImageStagingName = "texImage_staging";
+	std::shared_ptr<Image> image = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice, imageManager_memoryAllocator);
 
 	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 	std::cout << "imageManager::createTextureImage imageSize: " << imageSize << std::endl;
 
-	imageManager_bufferManager->createBuffer(
-		BufferType::GENERIC_STAGING,
-		texImageStagingName,
-		imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	);
-
-	std::shared_ptr<Buffer> stagingBuf = imageManager_bufferManager->getBuffer("texImage_staging");
-
-	std::cout << " ---------- imageManager::createTextureImage stagingBuffer handle: " << stagingBuf->getHandle() << std::endl;
-
 	if (pixels.size() != texWidth * texHeight * 4) {
 		throw std::runtime_error("Mismatch in pixel data size and expected dimensions");
 	}
 
-	image->createTextureImage(pixels.data(), texWidth, texHeight, commandPool, stagingBuf, imageManager_bufferManager);
+	image->createTextureImage(pixels.data(), texWidth, texHeight, commandPool, imageManager_bufferManager);
 
 	std::cout << "[Created texture image] : " << name << std::endl;
 
-	images[name] = std::move(image);
+	//No file to go back to -> keep a CPU copy so the texture can be evicted and reloaded
+	ImageHandle handle = addImage(name, std::move(image));
+	TextureSource source{};
+	source.pixels = pixels;
+	source.width = texWidth;
+	source.height = texHeight;
+	textureSources[handle.index] = std::move(source);
+
+	return handle;
+}
+
+ImageHandle ImageManager::addImage(const std::string& name, std::shared_ptr<Image> image) {
+	//Same name -> the new image takes over the name, the old handle goes stale
+	// -> frames in flight may still sample the old one, it's destroyed once they retired
+	auto existing = imageNames.find(name);
+	if (existing != imageNames.end()) {
+		destroyImage(existing->second);
+	}
+
+	ImageHandle handle = images.insert(std::move(image));
+	imageNames[name] = handle;
+	return handle;
 }
 
+void ImageManager::removeImage(ImageHandle handle) {
+	if (!images.contains(handle)) return;
+
+	for (auto it = imageNames.begin(); it != imageNames.end(); ++it) {
+		if (it->second == handle) {
+			std::cout << "Removing image : [" << it->first << "]" << std::endl;
+			imageNames.erase(it);
+			break;
+		}
+	}
+
+	textureSources.erase(handle.index);
+	images.remove(handle);
+};
+
 void ImageManager::removeImage(std::string name) {
-	auto it = images.find(name);
-	if (it != images.end()) {
-		std::cout << "Removing image : [" << name << "]" << std::endl;
-		images.erase(it);
+	auto it = imageNames.find(name);
+	if (it != imageNames.end()) {
+		removeImage(it->second);
 	}
 	else {
 		std::cout << "Image [" << name << "] not found for removal" << std::endl;
 	};
 };
 
+void ImageManager::destroyImage(ImageHandle handle) {
+	std::shared_ptr<Image>* image = images.get(handle);
+	if (image == nullptr) return;
+
+	std::shared_ptr<Image> retired = *image;
+	removeImage(handle);
+
+	imageManager_bufferManager->getDeletionQueue().push([retired]() {
+		retired->cleanup();
+	});
+}
+
+Image* ImageManager::getImage(ImageHandle handle) const {
+	const std::shared_ptr<Image>* image = images.get(handle);
+	return image != nullptr ? image->get() : nullptr;
+}
+
+ImageHandle ImageManager::findImage(const std::string& name) const {
+	auto it = imageNames.find(name);
+	return it != imageNames.end() ? it->second : ImageHandle{};
+}
+
 //Getter functions -> these get Image attributes via an image name
 VkSampler ImageManager::getSampler(std::string name) {
-	auto it = images.find(name);
-	if (it != images.end()) {
-		std::shared_ptr<Image> image = it->second;
+	Image* image = getImage(findImage(name));
+	if (image != nullptr) {
 		return image->getSampler();
 	}
 	else {
 		std::cout << "Image [" << name << "Sampler not found" << std::endl;
+		return VK_NULL_HANDLE;
 	}
 }
 
 VkImage ImageManager::getImageHandle(std::string name) {
-	auto it = images.find(name);
-	if (it != images.end()) {
-		return it->second->getImage();
+	Image* image = getImage(findImage(name));
+	if (image != nullptr) {
+		return image->getImage();
 	}
 	else {
 		std::cout << "Image [" << name << "] not found for retreival" << std::endl;
+		return VK_NULL_HANDLE;
 	};
 };
 
 std::shared_ptr<Image> ImageManager::getImage(std::string name) {
-	auto it = images.find(name);
-	if (it != images.end()) {
-		return it->second;
+	auto it = imageNames.find(name);
+	if (it != imageNames.end()) {
+		return *images.get(it->second);
 	}
 	else {
 		std::cout << "Image [" << name << "] not found for retreival" << std::endl;
+		return nullptr;
 	};
 }
 
 void ImageManager::cleanup() {
 	std::cout << "    Destroying `ImageManager` " << std::endl;
-	for (auto& pair : images) {
-		if (pair.second) {
-			std::cout << "Calling cleanup on image handle: " << pair.first << std::endl;
-			pair.second->cleanup();
+	images.forEach([](ImageHandle, std::shared_ptr<Image>& image) {
+		if (image) {
+			std::cout << "Calling cleanup on image handle: " << image->getImage() << std::endl;
+			image->cleanup();
 		}
-	}
+	});
 
 	images.clear();
+	imageNames.clear();
+	textureSources.clear();
+	fallbackHandle = ImageHandle{};
 };
 
 ImageDetails ImageManager::getImageDetails(std::string name) {
-	auto it = images.find(name);
-	if (it != images.end()) {
-		std::shared_ptr<Image> image = it->second;
+	Image* image = getImage(findImage(name));
+	if (image != nullptr) {
 		return image->getImageDetails();
 	}
 	else {
 		std::cout << "Image Details not found for [" << name << "]" << std::endl;
+		return ImageDetails{};
+	}
+};
+
+// == Residency ==
+void ImageManager::markUsed(ImageHandle handle, uint64_t frameNumber) {
+	Image* image = getImage(handle);
+	if (image != nullptr) {
+		image->markUsed(frameNumber);
+	}
+}
+
+ArenaVector<ImageHandle> ImageManager::updateResidency(uint64_t frameNumber, VkCommandPool commandPool, LinearArena& arena) {
+	ArenaVector<ImageHandle> changed{ ArenaAllocator<ImageHandle>(arena) };
+	changed.reserve(images.size());
+
+	images.forEach([&](ImageHandle handle, std::shared_ptr<Image>& image) {
+		if (!image) return;
+
+		if (image->getResidency() == TextureResidency::EVICTING) {
+			if (image->isResidencyRequested()) {
+				//Drawn again before its memory was freed -> point the descriptors back at it
+				image->clearResidencyRequest();
+				image->setResidency(TextureResidency::RESIDENT);
+				changed.push_back(handle);
+			}
+			else if (frameNumber >= image->getEvictFrame() + MAX_FRAMES_IN_FLIGHT) {
+				//Every frame's descriptors were moved to the fallback and the frames still using it have retired
+				std::cout << "[ImageManager] Evicted texture [" << handle.index << "] -> freed " << image->getMemorySize() << " bytes" << std::endl;
+				image->evict();
+			}
+		}
+		else if (image->getResidency() == TextureResidency::EVICTED && image->isResidencyRequested()) {
+			image->clearResidencyRequest();
+			if (reloadTexture(handle, *image, commandPool)) {
+				changed.push_back(handle);
+			}
+		}
+	});
+
+	//Relocated textures kept their handle but not their view
+	for (ImageHandle handle : relocatedImages) {
+		if (images.contains(handle)) changed.push_back(handle);
+	}
+	relocatedImages.clear();
+
+	evictOverBudget(frameNumber, commandPool, changed);
+
+	return changed;
+}
+
+bool ImageManager::reloadTexture(ImageHandle handle, Image& image, VkCommandPool commandPool) {
+	if (!uploadFromSource(handle, image, commandPool)) {
+		//Stays evicted, materials keep drawing with the fallback
+		image.evict();
+		return false;
+	}
+
+	image.setResidency(TextureResidency::RESIDENT);
+	std::cout << "[ImageManager] Reloaded texture [" << handle.index << "]" << std::endl;
+	return true;
+}
+
+bool ImageManager::uploadFromSource(ImageHandle handle, Image& image, VkCommandPool commandPool) {
+	auto it = textureSources.find(handle.index);
+	if (it == textureSources.end()) {
+		std::cerr << "[ImageManager] No source to reload texture [" << handle.index << "] from" << std::endl;
+		return false;
+	}
+
+	TextureSource& source = it->second;
+
+	//Recorded into the upload batch, flushed ahead of the frame that first samples it
+	try {
+		if (!source.path.empty()) {
+			int texWidth, texHeight, texChannels;
+			stbi_uc* pixels = stbi_load(source.path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+			if (!pixels) {
+				std::cerr << "[ImageManager] Failed to reload texture from : " << source.path << std::endl;
+				return false;
+			}
+
+			image.createTextureImage(pixels, texWidth, texHeight, commandPool, imageManager_bufferManager);
+			stbi_image_free(pixels);
+		}
+		else {
+			image.createTextureImage(source.pixels.data(), source.width, source.height, commandPool, imageManager_bufferManager);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "[ImageManager] Failed to reload texture [" << handle.index << "] : " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// == Defragmentation ==
+std::shared_ptr<Image> ImageManager::relocateImage(ImageHandle handle, VkCommandPool commandPool) {
+	std::shared_ptr<Image>* live = images.get(handle);
+	if (live == nullptr || !*live) return nullptr;
+
+	//Only textures that can be rebuilt from their source, anything else(attachments, the fallback) stays put
+	Image& image = **live;
+	if (image.isPinned() || image.getResidency() != TextureResidency::RESIDENT) return nullptr;
+	if (textureSources.count(handle.index) == 0) return nullptr;
+
+	std::shared_ptr<Image> storage = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice, imageManager_memoryAllocator);
+	if (!uploadFromSource(handle, *storage, commandPool)) {
+		storage->cleanup();
+		return nullptr;
+	}
+
+	image.swapStorage(*storage);
+	relocatedImages.push_back(handle);
+	return storage;
+}
+
+void ImageManager::evictOverBudget(uint64_t frameNumber, VkCommandPool commandPool, ArenaVector<ImageHandle>& changed) {
+	ScratchScope scratch;
+
+	//Least recently used first, anything drawn by a frame still in flight is left alone
+	ArenaVector<std::pair<uint64_t, ImageHandle>> candidates{ ArenaAllocator<std::pair<uint64_t, ImageHandle>>(scratch.getArena()) };
+	candidates.reserve(images.size());
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> leavingBytes{};
+	VkDeviceSize residentBytes = 0;
+
+	images.forEach([&](ImageHandle handle, std::shared_ptr<Image>& image) {
+		if (!image) return;
+
+		if (image->getResidency() == TextureResidency::EVICTING) {
+			leavingBytes[imageManager_memoryAllocator->getHeapIndex(image->getMemoryTypeIndex())] += image->getMemorySize();
+			return;
+		}
+
+		if (image->getResidency() != TextureResidency::RESIDENT) return;
+		residentBytes += image->getMemorySize();
+
+		if (image->isPinned() || textureSources.count(handle.index) == 0) return;
+		if (image->getLastUsedFrame() + MAX_FRAMES_IN_FLIGHT > frameNumber) return;
+
+		candidates.push_back({ image->getLastUsedFrame(), handle });
+	});
+
+	if (candidates.empty()) return;
+
+	//Bytes over the limit per heap, not counting memory that is already on its way out
+	std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS> budgets;
+	uint32_t heapCount = imageManager_memoryAllocator->getHeapBudgets(budgets);
+	std::array<int64_t, VK_MAX_MEMORY_HEAPS> heapOverage{};
+	bool overBudget = false;
+
+	for (uint32_t i = 0; i < heapCount; i++) {
+		const MemoryHeapBudget& heap = budgets[i];
+		VkDeviceSize limit = static_cast<VkDeviceSize>(static_cast<double>(heap.budget) * budgetFraction);
+		heapOverage[heap.heapIndex] = static_cast<int64_t>(heap.getEffectiveUsage()) - static_cast<int64_t>(limit) - static_cast<int64_t>(leavingBytes[heap.heapIndex]);
+		overBudget |= heapOverage[heap.heapIndex] > 0;
 	}
-};
\ No newline at end of file
+
+	int64_t textureOverage = textureBudget > 0 ? static_cast<int64_t>(residentBytes) - static_cast<int64_t>(textureBudget) : 0;
+	overBudget |= textureOverage > 0;
+
+	if (!overBudget) return;
+
+	std::sort(candidates.begin(), candidates.end(),
+		[](const auto& a, const auto& b) { return a.first < b.first; });
+
+	//Evicted textures need something valid to be bound in their place
+	ensureFallbackTexture(commandPool);
+
+	for (const auto& [lastUsedFrame, handle] : candidates) {
+		Image* image = getImage(handle);
+		uint32_t heapIndex = imageManager_memoryAllocator->getHeapIndex(image->getMemoryTypeIndex());
+		if (heapOverage[heapIndex] <= 0 && textureOverage <= 0) continue;
+
+		VkDeviceSize size = image->getMemorySize();
+		image->setResidency(TextureResidency::EVICTING);
+		image->setEvictFrame(frameNumber);
+		changed.push_back(handle);
+
+		heapOverage[heapIndex] -= static_cast<int64_t>(size);
+		textureOverage -= static_cast<int64_t>(size);
+
+		std::cout << "[ImageManager] Over budget, evicting texture [" << handle.index << "] last used on frame " << lastUsedFrame << std::endl;
+	}
+}
+
+void ImageManager::ensureFallbackTexture(VkCommandPool commandPool) {
+	if (images.contains(fallbackHandle)) return;
+
+	std::shared_ptr<Image> image = std::make_shared<Image>(imageManager_logicalDevice, imageManager_physicalDevice, imageManager_memoryAllocator);
+
+	unsigned char white[4] = { 255, 255, 255, 255 };
+	image->createTextureImage(white, 1, 1, commandPool, imageManager_bufferManager);
+	image->setPinned(true);
+
+	fallbackHandle = addImage("fallback_texture", std::move(image));
+	std::cout << "[ImageManager] Created fallback texture" << std::endl;
+}
+
+VkDeviceSize ImageManager::getResidentTextureBytes() const {
+	VkDeviceSize residentBytes = 0;
+
+	//forEach is non-const, walk through the handles instead
+	for (const auto& [name, handle] : imageNames) {
+		Image* image = getImage(handle);
+		if (image != nullptr && image->getResidency() == TextureResidency::RESIDENT) {
+			residentBytes += image->getMemorySize();
+		}
+	}
+
+	return residentBytes;
+}
+
+void ImageManager::printResidency() const {
+	uint32_t resident = 0, evicting = 0, evicted = 0;
+
+	for (const auto& [name, handle] : imageNames) {
+		Image* image = getImage(handle);
+		if (image == nullptr) continue;
+
+		switch (image->getResidency()) {
+		case TextureResidency::RESIDENT: resident++; break;
+		case TextureResidency::EVICTING: evicting++; break;
+		case TextureResidency::EVICTED: evicted++; break;
+		}
+	}
+
+	std::cout << "=== Texture residency ===" << std::endl;
+	std::cout << "  resident: " << resident << ", evicting: " << evicting << ", evicted: " << evicted << std::endl;
+	std::cout << "  resident bytes: " << getResidentTextureBytes()
+		<< ", texture budget: " << (textureBudget > 0 ? std::to_string(textureBudget) : "heap budget only") << std::endl;
+}
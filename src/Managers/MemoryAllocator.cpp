@@ -0,0 +1,693 @@
+#include "../include/Managers/MemoryAllocator.h"
+#include "../include/Utils/MemoryUtils.h"
+
+// == HELPER FUNCTIONS ==
+
+static VkDeviceSize roundUpToPowerOfTwo(VkDeviceSize value) {
+	VkDeviceSize result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+static VkDeviceSize roundDownToPowerOfTwo(VkDeviceSize value) {
+	VkDeviceSize result = 1;
+	while ((result << 1) <= value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+MemoryAllocator::MemoryAllocator(
+	VkDevice logicalDevice,
+	VkPhysicalDevice physicalDevice,
+	VkDeviceSize preferredBlockSize
+) : allocator_logicalDevice(logicalDevice), allocator_physicalDevice(physicalDevice), preferredBlockSize(roundUpToPowerOfTwo(preferredBlockSize))
+{
+	vkGetPhysicalDeviceMemoryProperties(allocator_physicalDevice, &allocator_memProperties);
+
+	VkPhysicalDeviceProperties deviceProperties{};
+	vkGetPhysicalDeviceProperties(allocator_physicalDevice, &deviceProperties);
+	supportsDedicatedAllocation = deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+
+	pools.resize(VK_MAX_MEMORY_TYPES * 2);
+	for (uint32_t i = 0; i < allocator_memProperties.memoryTypeCount; i++) {
+		//Keep blocks small on small heaps(ex. 256MB BAR heaps) -> never more than 1/8th of the heap
+		VkDeviceSize heapSize = allocator_memProperties.memoryHeaps[allocator_memProperties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = std::min(this->preferredBlockSize, roundDownToPowerOfTwo(std::max<VkDeviceSize>(heapSize / 8, MIN_NODE_SIZE)));
+
+		for (uint32_t kind = 0; kind < 2; kind++) {
+			pools[i * 2 + kind].memoryTypeIndex = i;
+			pools[i * 2 + kind].kind = static_cast<AllocationKind>(kind);
+			pools[i * 2 + kind].blockSize = blockSize;
+		}
+	}
+
+	for (uint32_t i = 0; i < allocator_memProperties.memoryTypeCount; i++) {
+		const VkMemoryType& memoryType = allocator_memProperties.memoryTypes[i];
+		const VkMemoryPropertyFlags deviceLocalHostVisible = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+		if ((memoryType.propertyFlags & deviceLocalHostVisible) == deviceLocalHostVisible
+			&& allocator_memProperties.memoryHeaps[memoryType.heapIndex].size > LEGACY_BAR_SIZE) {
+			largeDeviceLocalHostVisible = true;
+		}
+	}
+
+	std::cout << "Created [MemoryAllocator] with block size: " << this->preferredBlockSize
+		<< " across " << allocator_memProperties.memoryTypeCount << " memory types" << std::endl;
+	std::cout << "       with device local host visible memory: " << (largeDeviceLocalHostVisible ? "large(ReBAR/UMA)" : "none or 256MB BAR") << std::endl;
+}
+
+// == Placement ==
+MemoryPlacement MemoryAllocator::getPlacement(MemoryUsage usage, VkMemoryPropertyFlags properties) {
+	MemoryPlacement placement{};
+
+	switch (usage) {
+	case MemoryUsage::GPU_ONLY:
+		placement.required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		placement.notPreferred = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		break;
+	case MemoryUsage::UPLOAD_PER_FRAME:
+		//Device local + host visible lets the GPU read straight out of VRAM, the CPU writes are sequential anyways
+		placement.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		placement.preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		placement.notPreferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		break;
+	case MemoryUsage::STAGING:
+		//Keep staging out of the(possibly tiny) BAR heap, it is only read by copies
+		placement.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		placement.notPreferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		break;
+	case MemoryUsage::READBACK:
+		//CPU reads from uncached memory are very slow
+		placement.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		placement.preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		placement.notPreferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		break;
+	case MemoryUsage::AUTO:
+	default:
+		break;
+	}
+
+	//Whatever the caller explicitly asked for is always required
+	placement.required |= properties;
+	placement.preferred &= ~placement.required;
+	placement.notPreferred &= ~placement.required;
+
+	//Never hand out lazily allocated or protected memory unless asked for
+	placement.notPreferred |= (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT) & ~properties;
+	return placement;
+}
+
+static uint32_t countBits(VkMemoryPropertyFlags flags) {
+	uint32_t count = 0;
+	while (flags) {
+		count += flags & 1u;
+		flags >>= 1;
+	}
+	return count;
+}
+
+uint32_t MemoryAllocator::selectMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, MemoryUsage usage) const {
+	MemoryPlacement placement = getPlacement(usage, properties);
+
+	uint32_t bestIndex = UINT32_MAX;
+	int64_t bestScore = INT64_MIN;
+	VkDeviceSize bestHeapSize = 0;
+
+	for (uint32_t i = 0; i < allocator_memProperties.memoryTypeCount; i++) {
+		if ((memoryTypeBits & (1u << i)) == 0) continue;
+
+		VkMemoryPropertyFlags flags = allocator_memProperties.memoryTypes[i].propertyFlags;
+		if ((flags & placement.required) != placement.required) continue;
+
+		//Each preferred flag outweighs any number of not preferred ones, heap size only breaks ties
+		int64_t score = static_cast<int64_t>(countBits(flags & placement.preferred)) * 16
+			- static_cast<int64_t>(countBits(flags & placement.notPreferred));
+		VkDeviceSize heapSize = allocator_memProperties.memoryHeaps[allocator_memProperties.memoryTypes[i].heapIndex].size;
+
+		if (score > bestScore || (score == bestScore && heapSize > bestHeapSize)) {
+			bestIndex = i;
+			bestScore = score;
+			bestHeapSize = heapSize;
+		}
+	}
+
+	if (bestIndex != UINT32_MAX) return bestIndex;
+
+	//Usage requirements can not be met(ex. no coherent memory) -> settle for what the caller asked for
+	return findMemoryType(allocator_physicalDevice, memoryTypeBits, properties);
+}
+
+// == Allocation functions ==
+MemoryAllocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryUsage usage) {
+	VkMemoryRequirements memRequirements{};
+	bool dedicated = false;
+
+	if (supportsDedicatedAllocation) {
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.buffer = buffer;
+
+		VkMemoryRequirements2 memRequirements2{};
+		memRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		memRequirements2.pNext = &dedicatedRequirements;
+
+		vkGetBufferMemoryRequirements2(allocator_logicalDevice, &requirementsInfo, &memRequirements2);
+		memRequirements = memRequirements2.memoryRequirements;
+		dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	} else {
+		vkGetBufferMemoryRequirements(allocator_logicalDevice, buffer, &memRequirements);
+	}
+
+	return allocate(memRequirements, properties, AllocationKind::LINEAR, dedicated, buffer, VK_NULL_HANDLE, usage);
+}
+
+MemoryAllocation MemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties, MemoryUsage usage) {
+	VkMemoryRequirements memRequirements{};
+	bool dedicated = false;
+
+	if (supportsDedicatedAllocation) {
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkImageMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.image = image;
+
+		VkMemoryRequirements2 memRequirements2{};
+		memRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		memRequirements2.pNext = &dedicatedRequirements;
+
+		vkGetImageMemoryRequirements2(allocator_logicalDevice, &requirementsInfo, &memRequirements2);
+		memRequirements = memRequirements2.memoryRequirements;
+		dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	} else {
+		vkGetImageMemoryRequirements(allocator_logicalDevice, image, &memRequirements);
+	}
+
+	return allocate(memRequirements, properties, AllocationKind::OPTIMAL, dedicated, VK_NULL_HANDLE, image, usage);
+}
+
+MemoryAllocation MemoryAllocator::allocate(
+	const VkMemoryRequirements& memRequirements,
+	VkMemoryPropertyFlags properties,
+	AllocationKind kind,
+	bool dedicated,
+	VkBuffer dedicatedBuffer,
+	VkImage dedicatedImage,
+	MemoryUsage usage
+) {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	uint32_t memoryTypeIndex = selectMemoryType(memRequirements.memoryTypeBits, properties, usage);
+	MemoryPool& pool = getPool(memoryTypeIndex, kind);
+
+	//Large requests go straight to the driver, they would waste most of a block anyways
+	if (dedicated || memRequirements.size > pool.blockSize / 2) {
+		MemoryAllocation allocation = allocateDedicated(pool, memRequirements.size, dedicatedBuffer, dedicatedImage);
+		allocation.kind = kind;
+		return allocation;
+	}
+
+	MemoryAllocation allocation{};
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.kind = kind;
+
+	for (auto& block : pool.blocks) {
+		if (block->defragSource) continue;
+		if (allocateFromBlock(*block, memRequirements.size, memRequirements.alignment, allocation)) {
+			return allocation;
+		}
+	}
+
+	//No room in any existing block, create a new one
+	MemoryBlock* newBlock = createBlock(pool);
+	if (!allocateFromBlock(*newBlock, memRequirements.size, memRequirements.alignment, allocation)) {
+		throw std::runtime_error("Failed to sub-allocate from a fresh memory block");
+	}
+
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::allocateDedicated(MemoryPool& pool, VkDeviceSize size, VkBuffer buffer, VkImage image) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	if (supportsDedicatedAllocation && (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE)) {
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = buffer;
+		dedicatedInfo.image = image;
+		allocInfo.pNext = &dedicatedInfo;
+	}
+
+	VkMemoryAllocateFlagsInfo flagsInfo{};
+	addAllocateFlags(pool, allocInfo, flagsInfo);
+
+	MemoryAllocation allocation{};
+	if (vkAllocateMemory(allocator_logicalDevice, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate dedicated device memory");
+	}
+
+	allocation.offset = 0;
+	allocation.size = size;
+	allocation.memoryTypeIndex = pool.memoryTypeIndex;
+	allocation.dedicated = true;
+	allocation.mappedPtr = mapIfHostVisible(allocation.memory, pool.memoryTypeIndex);
+
+	pool.dedicatedAllocations.push_back({ allocation.memory, size });
+
+	std::cout << "[MemoryAllocator] Dedicated allocation of size : [" << size << "] on memory type " << pool.memoryTypeIndex << std::endl;
+	return allocation;
+}
+
+// Buddy allocation -> find the smallest free node that fits, splitting larger nodes down as needed
+bool MemoryAllocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+	VkDeviceSize nodeSize = roundUpToPowerOfTwo(std::max({ size, alignment, MIN_NODE_SIZE }));
+	if (nodeSize > block.size) return false;
+
+	uint32_t order = 0;
+	while (block.nodeSize(order) < nodeSize) {
+		order++;
+	}
+
+	uint32_t freeOrder = order;
+	while (freeOrder <= block.maxOrder && block.freeLists[freeOrder].empty()) {
+		freeOrder++;
+	}
+	if (freeOrder > block.maxOrder) return false;
+
+	VkDeviceSize offset = *block.freeLists[freeOrder].begin();
+	block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+
+	//Split down, leaving the upper half of each split free
+	while (freeOrder > order) {
+		freeOrder--;
+		block.freeLists[freeOrder].insert(offset + block.nodeSize(freeOrder));
+	}
+
+	block.allocationCount++;
+	block.bytesAllocated += block.nodeSize(order);
+	block.bytesRequested += size;
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.blockId = block.id;
+	allocation.order = order;
+	allocation.dedicated = false;
+	allocation.mappedPtr = block.mappedPtr ? static_cast<char*>(block.mappedPtr) + offset : nullptr;
+
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(MemoryBlock& block, VkDeviceSize offset, uint32_t order) {
+	//Merge with the buddy node for as long as it is free
+	while (order < block.maxOrder) {
+		VkDeviceSize buddyOffset = offset ^ block.nodeSize(order);
+
+		auto buddy = block.freeLists[order].find(buddyOffset);
+		if (buddy == block.freeLists[order].end()) break;
+
+		block.freeLists[order].erase(buddy);
+		offset = std::min(offset, buddyOffset);
+		order++;
+	}
+
+	block.freeLists[order].insert(offset);
+}
+
+// == Deallocation ==
+void MemoryAllocator::free(MemoryAllocation& allocation) {
+	if (!allocation.isValid()) return;
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	MemoryPool& pool = getPool(allocation.memoryTypeIndex, allocation.kind);
+
+	if (allocation.dedicated) {
+		auto it = std::find_if(pool.dedicatedAllocations.begin(), pool.dedicatedAllocations.end(),
+			[&](const DedicatedAllocation& dedicated) { return dedicated.memory == allocation.memory; });
+
+		if (it != pool.dedicatedAllocations.end()) {
+			pool.dedicatedAllocations.erase(it);
+		}
+
+		// Freeing memory implicitly unmaps it
+		vkFreeMemory(allocator_logicalDevice, allocation.memory, nullptr);
+		allocation = MemoryAllocation{};
+		return;
+	}
+
+	for (size_t i = 0; i < pool.blocks.size(); i++) {
+		MemoryBlock& block = *pool.blocks[i];
+		if (block.id != allocation.blockId) continue;
+
+		freeToBlock(block, allocation.offset, allocation.order);
+		block.allocationCount--;
+		block.bytesAllocated -= block.nodeSize(allocation.order);
+		block.bytesRequested -= allocation.size;
+
+		//Release empty blocks, but keep the last one around to avoid thrashing on alloc/free patterns
+		if (block.allocationCount == 0 && pool.blocks.size() > 1) {
+			destroyBlock(pool, i);
+		}
+
+		allocation = MemoryAllocation{};
+		return;
+	}
+
+	std::cerr << "[MemoryAllocator] Tried to free an allocation from an unknown block : [" << allocation.blockId << "]" << std::endl;
+	allocation = MemoryAllocation{};
+}
+
+void MemoryAllocator::addAllocateFlags(const MemoryPool& pool, VkMemoryAllocateInfo& allocInfo, VkMemoryAllocateFlagsInfo& flagsInfo) const {
+	//Images never need an address, keep their memory plain
+	if (!bufferDeviceAddressEnabled || pool.kind != AllocationKind::LINEAR) return;
+
+	flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	flagsInfo.pNext = allocInfo.pNext;
+	allocInfo.pNext = &flagsInfo;
+}
+
+// == Pool and block management ==
+MemoryAllocator::MemoryPool& MemoryAllocator::getPool(uint32_t memoryTypeIndex, AllocationKind kind) {
+	return pools[memoryTypeIndex * 2 + static_cast<uint32_t>(kind)];
+}
+
+MemoryAllocator::MemoryBlock* MemoryAllocator::createBlock(MemoryPool& pool) {
+	auto block = std::make_unique<MemoryBlock>();
+	block->id = pool.nextBlockId++;
+	block->size = pool.blockSize;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = block->size;
+	allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+	VkMemoryAllocateFlagsInfo flagsInfo{};
+	addAllocateFlags(pool, allocInfo, flagsInfo);
+
+	if (vkAllocateMemory(allocator_logicalDevice, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate memory block");
+	}
+
+	block->mappedPtr = mapIfHostVisible(block->memory, pool.memoryTypeIndex);
+
+	while (block->nodeSize(block->maxOrder) < block->size) {
+		block->maxOrder++;
+	}
+	block->freeLists.resize(block->maxOrder + 1);
+	block->freeLists[block->maxOrder].insert(0);
+
+	std::cout << "[MemoryAllocator] Created block " << block->id << " of size : [" << block->size
+		<< "] on memory type " << pool.memoryTypeIndex << std::endl;
+
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryPool& pool, size_t blockIndex) {
+	MemoryBlock& block = *pool.blocks[blockIndex];
+	std::cout << "[MemoryAllocator] Releasing empty block " << block.id << " on memory type " << pool.memoryTypeIndex << std::endl;
+
+	vkFreeMemory(allocator_logicalDevice, block.memory, nullptr);
+	pool.blocks.erase(pool.blocks.begin() + blockIndex);
+}
+
+void* MemoryAllocator::mapIfHostVisible(VkDeviceMemory memory, uint32_t memoryTypeIndex) {
+	if (!(allocator_memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+		return nullptr;
+	}
+
+	void* mappedPtr = nullptr;
+	if (vkMapMemory(allocator_logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, &mappedPtr) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to persistently map host visible memory");
+	}
+
+	return mappedPtr;
+}
+
+// == Budget ==
+std::vector<MemoryHeapBudget> MemoryAllocator::getHeapBudgets() {
+	std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS> budgets;
+	uint32_t heapCount = getHeapBudgets(budgets);
+	return std::vector<MemoryHeapBudget>(budgets.begin(), budgets.begin() + heapCount);
+}
+
+uint32_t MemoryAllocator::getHeapBudgets(std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS>& budgets) {
+	const uint32_t heapCount = allocator_memProperties.memoryHeapCount;
+
+	for (uint32_t i = 0; i < heapCount; i++) {
+		budgets[i] = MemoryHeapBudget{};
+		budgets[i].heapIndex = i;
+		budgets[i].flags = allocator_memProperties.memoryHeaps[i].flags;
+		budgets[i].heapSize = allocator_memProperties.memoryHeaps[i].size;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(allocatorMutex);
+
+		for (uint32_t i = 0; i < allocator_memProperties.memoryTypeCount; i++) {
+			MemoryHeapBudget& heap = budgets[allocator_memProperties.memoryTypes[i].heapIndex];
+
+			for (uint32_t kind = 0; kind < 2; kind++) {
+				const MemoryPool& pool = pools[i * 2 + kind];
+
+				for (const auto& block : pool.blocks) {
+					heap.allocatorReserved += block->size;
+					heap.allocatorAllocated += block->bytesAllocated;
+				}
+
+				for (const auto& dedicated : pool.dedicatedAllocations) {
+					heap.allocatorReserved += dedicated.size;
+					heap.allocatorAllocated += dedicated.size;
+				}
+			}
+		}
+	}
+
+	if (memoryBudgetSupported) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memProperties2{};
+		memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memProperties2.pNext = &budgetProperties;
+
+		vkGetPhysicalDeviceMemoryProperties2(allocator_physicalDevice, &memProperties2);
+
+		for (uint32_t i = 0; i < heapCount; i++) {
+			MemoryHeapBudget& heap = budgets[i];
+			heap.budget = budgetProperties.heapBudget[heap.heapIndex];
+			heap.usage = budgetProperties.heapUsage[heap.heapIndex];
+			heap.fromDriver = true;
+		}
+	} else {
+		//Only sees our own allocations -> other processes and driver internals are not accounted for
+		for (uint32_t i = 0; i < heapCount; i++) {
+			MemoryHeapBudget& heap = budgets[i];
+			heap.budget = static_cast<VkDeviceSize>(static_cast<double>(heap.heapSize) * FALLBACK_BUDGET_FRACTION);
+			heap.usage = heap.allocatorReserved;
+		}
+	}
+
+	return heapCount;
+}
+
+// == Defragmentation ==
+uint32_t MemoryAllocator::beginDefragmentation(float maxBlockUsage) {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	uint32_t sourceCount = 0;
+	for (auto& pool : pools) {
+		if (pool.blocks.size() < 2) continue;
+
+		//Densest block stays as the destination
+		size_t densest = 0;
+		for (size_t i = 1; i < pool.blocks.size(); i++) {
+			if (pool.blocks[i]->bytesAllocated > pool.blocks[densest]->bytesAllocated) densest = i;
+		}
+
+		for (size_t i = 0; i < pool.blocks.size(); i++) {
+			MemoryBlock& block = *pool.blocks[i];
+			float usage = static_cast<float>(block.bytesAllocated) / static_cast<float>(block.size);
+
+			if (i == densest || usage >= maxBlockUsage) continue;
+
+			block.defragSource = true;
+			sourceCount++;
+		}
+	}
+
+	defragmenting = sourceCount > 0;
+	std::cout << "[MemoryAllocator] Defragmentation started with " << sourceCount << " source blocks" << std::endl;
+	return sourceCount;
+}
+
+void MemoryAllocator::endDefragmentation() {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks) {
+			block->defragSource = false;
+		}
+	}
+
+	defragmenting = false;
+}
+
+bool MemoryAllocator::isInDefragSource(const MemoryAllocation& allocation) {
+	if (!allocation.isValid() || allocation.dedicated) return false;
+
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	const MemoryPool& pool = getPool(allocation.memoryTypeIndex, allocation.kind);
+	for (const auto& block : pool.blocks) {
+		if (block->id == allocation.blockId) return block->defragSource;
+	}
+
+	return false;
+}
+
+VkDeviceSize MemoryAllocator::getReservedBytes() {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	VkDeviceSize reserved = 0;
+	for (const auto& pool : pools) {
+		for (const auto& block : pool.blocks) {
+			reserved += block->size;
+		}
+		for (const auto& dedicated : pool.dedicatedAllocations) {
+			reserved += dedicated.size;
+		}
+	}
+
+	return reserved;
+}
+
+// == Stats ==
+MemoryAllocatorStats MemoryAllocator::getStats() {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	MemoryAllocatorStats stats{};
+
+	for (uint32_t i = 0; i < allocator_memProperties.memoryTypeCount; i++) {
+		MemoryTypeStats typeStats{};
+		typeStats.memoryTypeIndex = i;
+		typeStats.heapIndex = allocator_memProperties.memoryTypes[i].heapIndex;
+		typeStats.propertyFlags = allocator_memProperties.memoryTypes[i].propertyFlags;
+
+		for (uint32_t kind = 0; kind < 2; kind++) {
+			const MemoryPool& pool = pools[i * 2 + kind];
+
+			for (const auto& block : pool.blocks) {
+				typeStats.blockCount++;
+				typeStats.allocationCount += block->allocationCount;
+				typeStats.bytesReserved += block->size;
+				typeStats.bytesAllocated += block->bytesAllocated;
+				typeStats.bytesRequested += block->bytesRequested;
+				typeStats.bytesFree += block->size - block->bytesAllocated;
+
+				//Free lists are ordered by size, so the highest non empty order holds the largest free range
+				for (uint32_t order = block->maxOrder + 1; order-- > 0;) {
+					if (!block->freeLists[order].empty()) {
+						typeStats.largestFreeRange = std::max(typeStats.largestFreeRange, block->nodeSize(order));
+						break;
+					}
+				}
+			}
+
+			for (const auto& dedicated : pool.dedicatedAllocations) {
+				typeStats.dedicatedCount++;
+				typeStats.allocationCount++;
+				typeStats.bytesReserved += dedicated.size;
+				typeStats.bytesAllocated += dedicated.size;
+				typeStats.bytesRequested += dedicated.size;
+			}
+		}
+
+		if (typeStats.bytesReserved == 0) continue;
+
+		if (typeStats.bytesFree > 0) {
+			typeStats.fragmentation = 1.0f - static_cast<float>(typeStats.largestFreeRange) / static_cast<float>(typeStats.bytesFree);
+		}
+
+		stats.deviceMemoryCount += typeStats.blockCount + typeStats.dedicatedCount;
+		stats.totalReserved += typeStats.bytesReserved;
+		stats.totalAllocated += typeStats.bytesAllocated;
+		stats.totalRequested += typeStats.bytesRequested;
+		stats.memoryTypes.push_back(typeStats);
+	}
+
+	return stats;
+}
+
+void MemoryAllocator::printStats() {
+	MemoryAllocatorStats stats = getStats();
+
+	std::cout << "=== MemoryAllocator stats ===" << std::endl;
+	std::cout << "  VkDeviceMemory objects: " << stats.deviceMemoryCount << std::endl;
+	std::cout << "  Reserved: " << stats.totalReserved
+		<< " | Allocated: " << stats.totalAllocated
+		<< " | Requested: " << stats.totalRequested << std::endl;
+
+	for (const auto& typeStats : stats.memoryTypes) {
+		std::cout << "  [Memory type " << typeStats.memoryTypeIndex << " | heap " << typeStats.heapIndex
+			<< " | flags " << typeStats.propertyFlags << "]" << std::endl;
+		std::cout << "    blocks: " << typeStats.blockCount
+			<< ", dedicated: " << typeStats.dedicatedCount
+			<< ", allocations: " << typeStats.allocationCount << std::endl;
+		std::cout << "    reserved: " << typeStats.bytesReserved
+			<< ", allocated: " << typeStats.bytesAllocated
+			<< ", requested: " << typeStats.bytesRequested
+			<< ", free: " << typeStats.bytesFree
+			<< ", largest free range: " << typeStats.largestFreeRange
+			<< ", fragmentation: " << typeStats.fragmentation << std::endl;
+	}
+}
+
+void MemoryAllocator::printBudgets() {
+	std::vector<MemoryHeapBudget> budgets = getHeapBudgets();
+
+	std::cout << "=== Memory budgets (" << (memoryBudgetSupported ? "VK_EXT_memory_budget" : "heap size fallback") << ") ===" << std::endl;
+
+	for (const auto& heap : budgets) {
+		std::cout << "  [Heap " << heap.heapIndex << (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " | device local" : "") << "]"
+			<< " size: " << heap.heapSize
+			<< ", budget: " << heap.budget
+			<< ", usage: " << heap.usage
+			<< ", allocator reserved: " << heap.allocatorReserved
+			<< ", allocated: " << heap.allocatorAllocated << std::endl;
+	}
+}
+
+// == Cleanup ==
+void MemoryAllocator::cleanup() {
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+	std::cout << "    Destroying `MemoryAllocator` " << std::endl;
+
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks) {
+			if (block->allocationCount > 0) {
+				std::cerr << "[MemoryAllocator] Block " << block->id << " on memory type " << pool.memoryTypeIndex
+					<< " still has " << block->allocationCount << " live allocations" << std::endl;
+			}
+			vkFreeMemory(allocator_logicalDevice, block->memory, nullptr);
+		}
+		pool.blocks.clear();
+
+		for (auto& dedicated : pool.dedicatedAllocations) {
+			vkFreeMemory(allocator_logicalDevice, dedicated.memory, nullptr);
+		}
+		pool.dedicatedAllocations.clear();
+	}
+}
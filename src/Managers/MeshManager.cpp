@@ -15,8 +15,9 @@ auto getFloats = [&](const tinygltf::Model& model, const tinygltf::Accessor& acc
 };
 
 // == MESH MANAGER == 
-MeshManager::MeshManager(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<BufferManager> bufferManager)
-    : meshManager_logicalDevice(logicalDevice), meshManager_physicalDevice(physicalDevice), meshManager_bufferManager(bufferManager), meshCount(0) {
+MeshManager::MeshManager(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, std::shared_ptr<BufferManager> bufferManager, std::shared_ptr<ImageManager> imageManager)
+    : meshManager_logicalDevice(logicalDevice), meshManager_physicalDevice(physicalDevice), meshManager_bufferManager(bufferManager), meshManager_imageManager(imageManager), meshCount(0) {
+    geometryBuffer = std::make_shared<GeometryBuffer>(bufferManager);
 }
 
 // == MODEL LOADING FUNCTIONS == 
@@ -206,11 +207,11 @@ void MeshManager::loadModel_gLTF(
                             }
                         }
 
-                        imageManager->createTextureImage(albedoName, imageSource, w, h, commandPool);
+                        ImageHandle albedoHandle = imageManager->createTextureImage(albedoName, imageSource, w, h, commandPool);
                     
                         std::shared_ptr<Image> albedoImage = imageManager->getImage(albedoName);
 
-                        createMaterial(albedoName, albedoImage);
+                        createMaterial(albedoName, albedoImage, albedoHandle);
 
                         albedo = getMaterial(albedoName);                    
                     }
@@ -345,7 +346,8 @@ void MeshManager::loadModel_gLTF(
 
 // == MESH, PRIMITIVE AND MATERIAL CREATION == 
 void MeshManager::createMaterial(std::string name,
-    std::shared_ptr<Image> textureImage) {
+    std::shared_ptr<Image> textureImage,
+    ImageHandle textureHandle) {
     std::cout << "Creating material : [" << name << "] with image: [" << textureImage->getImage() << "]" << std::endl;
 
     ShaderSet shaders{};
@@ -358,6 +360,8 @@ void MeshManager::createMaterial(std::string name,
         std::make_shared<ShaderSet>(shaders),
         meshManager_logicalDevice
     );
+    mat->setTextureHandle(textureHandle);
+    mat->setSortID(nextMaterialSortID++);
 
     materials[name] = std::move(mat);
 }
@@ -378,8 +382,8 @@ std::shared_ptr<Primitive> MeshManager::createPrimitive(
     std::cout << "CREATING PRIMATIVE AT INDEX " << primitiveIndex << std::endl; 
 
     std::shared_ptr<Primitive> primitive = std::make_shared<Primitive>(
-        vertices, 
-        indices, 
+        std::move(vertices), 
+        std::move(indices), 
         material, 
         blendModeID, 
         cullModeID, 
@@ -388,6 +392,8 @@ std::shared_ptr<Primitive> MeshManager::createPrimitive(
         topologyTypeID,
         primitiveIndex
     );
+    primitive->setKeepCpuGeometry(keepCpuGeometry);
+    primitive->setBoundsIndex(primitiveBounds.push(primitive->getBoundingSphere(), primitive->getBoundsMin(), primitive->getBoundsMax()));
 
     primitivesByPipelineKey[primitive->getPipelineKey()].push_back(primitive);
     
@@ -407,7 +413,8 @@ std::shared_ptr<Mesh> MeshManager::createMesh(std::string meshName, std::vector<
 
     meshes[meshName] = mesh;
 
-    int meshIndex = static_cast<int>(meshes.size() - 1);
+    //Index of the slot just pushed -> instances share the matrix array, so the mesh count can't be used
+    int meshIndex = static_cast<int>(modelMatrices.size() - 1);
     mesh->setMeshIndex(meshIndex);
 
     std::cout << "[DEBUG] modelMatrices.size() = " << modelMatrices.size() << std::endl;
@@ -429,12 +436,160 @@ std::shared_ptr<Mesh> MeshManager::createMesh(std::string meshName, std::vector<
     return mesh;
 }
 
+int MeshManager::createMeshInstance(const std::string& instanceName, const std::string& sourceMeshName, const glm::mat4& transform) {
+    auto source = meshes.find(sourceMeshName);
+    if (source == meshes.end()) {
+        std::cerr << "Cannot instance mesh [" << sourceMeshName << "], it does not exist" << std::endl;
+        return -1;
+    }
+
+    if (meshes.count(instanceName) != 0 || meshInstances.count(instanceName) != 0) {
+        std::cerr << "Mesh instance name [" << instanceName << "] is already taken" << std::endl;
+        return -1;
+    }
+
+    int transformIndex = static_cast<int>(modelMatrices.size());
+    modelMatrices.push_back(transform);
+
+    //Storage buffers already exist -> frames in flight may still read them, each picks the slot up(growing if needed) on its own turn
+    markTransformDirty(transformIndex);
+
+    for (const auto& primitive : source->second->getPrimitives()) {
+        primitive->addInstanceTransform(transformIndex);
+    }
+
+    meshInstances[instanceName] = MeshInstance{ sourceMeshName, transformIndex };
+    return transformIndex;
+}
+
+void MeshManager::removeMeshInstance(const std::string& instanceName) {
+    auto it = meshInstances.find(instanceName);
+    if (it == meshInstances.end()) {
+        std::cout << "Mesh instance [" << instanceName << "] not found for removal" << std::endl;
+        return;
+    }
+
+    auto source = meshes.find(it->second.sourceMesh);
+    if (source != meshes.end()) {
+        for (const auto& primitive : source->second->getPrimitives()) {
+            primitive->removeInstanceTransform(it->second.transformIndex);
+        }
+    }
+
+    // Model matrix slot is left in place, same as removed meshes
+    meshInstances.erase(it);
+}
+
+bool MeshManager::setMeshInstanceTransform(const std::string& instanceName, const glm::mat4& transform) {
+    auto it = meshInstances.find(instanceName);
+    if (it == meshInstances.end()) {
+        std::cerr << "Mesh instance [" << instanceName << "] not found, transform not set" << std::endl;
+        return false;
+    }
+
+    modelMatrices[it->second.transformIndex] = transform;
+    markTransformDirty(it->second.transformIndex);
+    return true;
+}
+
+void MeshManager::markTransformDirty(int transformIndex) {
+    //Before createStorageBuffers() the whole array is copied anyway
+    if (storageBufferHandles.empty()) return;
+
+    for (std::vector<int>& dirty : dirtyTransforms) {
+        dirty.push_back(transformIndex);
+    }
+}
+
+void MeshManager::uploadPrimitiveGeometry(std::shared_ptr<Primitive> primitive, VkCommandPool commandPool) {
+    if (primitive->getGeometryRange().resident) {
+        std::cout << "Primitive " << primitive->getPrimitiveIndex() << " already uploaded" << std::endl;
+        return;
+    }
+
+    primitive->setGeometryRange(
+        geometryBuffer->upload(primitive->getVertices(), primitive->getIndices(), commandPool)
+    );
+
+    //The data was copied into the staging ring, the GPU copy is the only one needed from here on
+    if (primitive->getGeometryRange().resident) {
+        primitive->releaseCpuGeometry();
+    }
+}
+
+void MeshManager::removeMesh(const std::string& meshName) {
+    auto it = meshes.find(meshName);
+    if (it == meshes.end()) {
+        std::cout << "Mesh [" << meshName << "] not found for removal" << std::endl;
+        return;
+    }
+
+    std::cout << "Removing mesh : [" << meshName << "]" << std::endl;
+
+    DeletionQueue& deletionQueue = meshManager_bufferManager->getDeletionQueue();
+
+    for (const auto& primitive : it->second->getPrimitives()) {
+        //In flight frames may still draw from the range -> only reuse it once they retired
+        deletionQueue.push([geometry = geometryBuffer, primitive]() {
+            geometry->release(primitive->getGeometryRange());
+        });
+
+        // Remove from the draw batches
+        auto batch = primitivesByPipelineKey.find(primitive->getPipelineKey());
+        if (batch != primitivesByPipelineKey.end()) {
+            auto& batchPrimitives = batch->second;
+            batchPrimitives.erase(std::remove(batchPrimitives.begin(), batchPrimitives.end(), primitive), batchPrimitives.end());
+
+            if (batchPrimitives.empty()) {
+                primitivesByPipelineKey.erase(batch);
+            }
+        }
+
+        primitives.erase(std::remove(primitives.begin(), primitives.end(), primitive), primitives.end());
+    }
+
+    // Instances only referenced the removed primitives
+    for (auto instance = meshInstances.begin(); instance != meshInstances.end();) {
+        instance = instance->second.sourceMesh == meshName ? meshInstances.erase(instance) : std::next(instance);
+    }
+
+    // Model matrix slot is left in place so other meshes keep their indices
+    meshIndices.erase(meshName);
+    meshes.erase(it);
+    meshCount--;
+}
+
+bool MeshManager::removeMaterial(const std::string& materialName) {
+    auto it = materials.find(materialName);
+    if (it == materials.end()) {
+        std::cout << "Material [" << materialName << "] not found for removal" << std::endl;
+        return false;
+    }
+
+    for (const auto& primitive : primitives) {
+        if (primitive->getMaterial() == it->second) {
+            std::cerr << "Material [" << materialName << "] is still used by a primitive, not removing it" << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << "Removing material : [" << materialName << "]" << std::endl;
+
+    //Texture outlives the material until the frames sampling it retire
+    if (meshManager_imageManager && it->second->getTextureHandle().isValid()) {
+        meshManager_imageManager->destroyImage(it->second->getTextureHandle());
+    }
+
+    materials.erase(it);
+    return true;
+}
+
 // == MESH DESCRRIPTOR SET UP == 
 void MeshManager::createStorageBuffers() {
     std::cout << "==> Entered MeshManager::createStorageBuffers" << std::endl;
 
-    //[DEBUG - 256 BYTES ALLOCATED(4 MAT4s)]
-    VkDeviceSize storageBufSize = 4 * sizeof(glm::mat4);
+    //Every mesh and instance slot, at least 4 MAT4s
+    VkDeviceSize storageBufSize = std::max<size_t>(modelMatrices.size(), 4) * sizeof(glm::mat4);
     std::cout << "Creating SSBO for " << modelMatrices.size() << " matrices ("
         << storageBufSize << " bytes total)" << std::endl;
 
@@ -443,39 +598,38 @@ void MeshManager::createStorageBuffers() {
 
         std::cout << "  [Frame " << i << "] Creating buffer: " << bufName << std::endl;
 
-        meshManager_bufferManager->createBuffer(
+        BufferHandle storageHandle = meshManager_bufferManager->createBuffer(
             BufferType::STORAGE,
             bufName,
             storageBufSize,
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | meshManager_bufferManager->getDeviceAddressUsage(),
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            std::nullopt,
+            std::nullopt,
+            MemoryUsage::UPLOAD_PER_FRAME
         );
 
-        std::shared_ptr<Buffer> meshStorageBuffer = meshManager_bufferManager->getBuffer(bufName);
+        Buffer* meshStorageBuffer = meshManager_bufferManager->getBuffer(storageHandle);
 
         if (!meshStorageBuffer) {
             std::cerr << "  [ERROR] Failed to retrieve buffer: " << bufName << std::endl;
             continue;
         }
 
+        storageBufferHandles.push_back(storageHandle);
+
         std::cout << "  [Frame " << i << "] Buffer handle: " << meshStorageBuffer->getHandle()
             << ", memory: " << meshStorageBuffer->getMemory() << std::endl;
 
-        void* meshStorageBufferPtr = nullptr;
-        VkResult result = vkMapMemory(meshManager_logicalDevice,
-            meshStorageBuffer->getMemory(),
-            0,
-            storageBufSize,
-            0,
-            &meshStorageBufferPtr);
-        if (result != VK_SUCCESS) {
-            std::cerr << "  [ERROR] vkMapMemory failed with code: " << result << std::endl;
+        //SSBO memory stays mapped for the lifetime of the buffer
+        void* meshStorageBufferPtr = meshStorageBuffer->getMappedPtr();
+        if (meshStorageBufferPtr == nullptr) {
+            std::cerr << "  [ERROR] SSBO " << bufName << " is not host visible" << std::endl;
         }
         else {
             std::cout << "  [Frame " << i << "] Mapped memory at: " << meshStorageBufferPtr << std::endl;
-            memcpy(meshStorageBufferPtr, modelMatrices.data(), storageBufSize);
-            vkUnmapMemory(meshManager_logicalDevice, meshStorageBuffer->getMemory());
-            std::cout << "  [Frame " << i << "] SSBO data copied and unmapped." << std::endl;
+            memcpy(meshStorageBufferPtr, modelMatrices.data(), std::min<VkDeviceSize>(storageBufSize, modelMatrices.size() * sizeof(glm::mat4)));
+            std::cout << "  [Frame " << i << "] SSBO data copied." << std::endl;
         }
 
         mappedStorageBufferPtrs.push_back(meshStorageBufferPtr);
@@ -492,7 +646,9 @@ void MeshManager::createSSBODescriptors(VkDescriptorPool descriptorPool) {
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         std::string bufName = "meshStorage" + std::to_string(i);
-        std::shared_ptr<Buffer> meshStorageBuffer = meshManager_bufferManager->getBuffer(bufName);
+        Buffer* meshStorageBuffer = i < storageBufferHandles.size()
+            ? meshManager_bufferManager->getBuffer(storageBufferHandles[i])
+            : nullptr;
 
         if (!meshStorageBuffer) {
             std::cerr << "  [ERROR] Buffer " << bufName << " not found!" << std::endl;
@@ -504,8 +660,8 @@ void MeshManager::createSSBODescriptors(VkDescriptorPool descriptorPool) {
 
         VkBuffer bufferHandle = meshStorageBuffer->getHandle();
 
-        //[DEBUG -> AGAIN, ALLOCATING 256 BYTES TO DESCRIPTOR RANGE]
-        VkDeviceSize bufferRange = 4 * sizeof(glm::mat4);
+        //Whole buffer -> modelMatrices.length() in the shaders has to cover every slot
+        VkDeviceSize bufferRange = meshStorageBuffer->getSize();
 
         std::cout << "Buffer range size: " << bufferRange << std::endl;
 
@@ -538,15 +694,106 @@ void MeshManager::createSSBODescriptors(VkDescriptorPool descriptorPool) {
         }
     }
 
+    descriptorVersion++;
     std::cout << "<== Finished MeshManager::createSSBODescriptors\n" << std::endl;
 }
 
+void MeshManager::updateStorageBuffers(uint32_t currentFrame) {
+    if (currentFrame >= storageBufferHandles.size()) return;
+
+    Buffer* storageBuffer = meshManager_bufferManager->getBuffer(storageBufferHandles[currentFrame]);
+    if (storageBuffer == nullptr) return;
+
+    //Grown storage already holds every slot, only slots changed since are left
+    if (modelMatrices.size() * sizeof(glm::mat4) > storageBuffer->getSize()) {
+        growStorageBuffer(currentFrame);
+    }
+
+    glm::mat4* matrices = static_cast<glm::mat4*>(mappedStorageBufferPtrs[currentFrame]);
+    if (matrices != nullptr) {
+        for (int transformIndex : dirtyTransforms[currentFrame]) {
+            matrices[transformIndex] = modelMatrices[transformIndex];
+        }
+    }
+    dirtyTransforms[currentFrame].clear();
+}
+
+// Only this frame slot reads its SSBO, and it retired with the fence wait -> the old buffer goes through the
+// deletion queue just to be safe, its memory stays mapped until then so the contents can be carried over
+void MeshManager::growStorageBuffer(uint32_t frame) {
+    Buffer* oldBuffer = meshManager_bufferManager->getBuffer(storageBufferHandles[frame]);
+    const VkDeviceSize oldSize = oldBuffer->getSize();
+    const size_t oldCapacity = static_cast<size_t>(oldSize / sizeof(glm::mat4));
+    const void* oldData = mappedStorageBufferPtrs[frame];
+
+    //Doubling -> adding instances one by one doesn't reallocate every frame
+    const size_t newCapacity = std::max(modelMatrices.size(), oldCapacity * 2);
+    std::string bufName = "meshStorage" + std::to_string(frame);
+
+    std::cout << "[MeshManager] Growing " << bufName << " to " << newCapacity << " matrices" << std::endl;
+
+    meshManager_bufferManager->destroyBuffer(storageBufferHandles[frame]);
+
+    BufferHandle storageHandle = meshManager_bufferManager->createBuffer(
+        BufferType::STORAGE,
+        bufName,
+        static_cast<VkDeviceSize>(newCapacity) * sizeof(glm::mat4),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | meshManager_bufferManager->getDeviceAddressUsage(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        std::nullopt,
+        std::nullopt,
+        MemoryUsage::UPLOAD_PER_FRAME
+    );
+
+    Buffer* storageBuffer = meshManager_bufferManager->getBuffer(storageHandle);
+    if (storageBuffer == nullptr || storageBuffer->getMappedPtr() == nullptr) {
+        throw std::runtime_error("Failed to grow model matrix SSBO " + bufName);
+    }
+
+    //Old slots keep what was written into the SSBO(see transform()), new ones come from modelMatrices
+    glm::mat4* matrices = static_cast<glm::mat4*>(storageBuffer->getMappedPtr());
+    if (oldData != nullptr) {
+        memcpy(matrices, oldData, oldCapacity * sizeof(glm::mat4));
+    }
+    std::copy(modelMatrices.begin() + oldCapacity, modelMatrices.end(), matrices + oldCapacity);
+
+    storageBufferHandles[frame] = storageHandle;
+    mappedStorageBufferPtrs[frame] = matrices;
+
+    writeStorageDescriptor(frame);
+}
+
+void MeshManager::writeStorageDescriptor(uint32_t frame) {
+    if (frame >= meshDescriptorSets.size() || meshDescriptorSets[frame] == VK_NULL_HANDLE) return;
+
+    Buffer* storageBuffer = meshManager_bufferManager->getBuffer(storageBufferHandles[frame]);
+    if (storageBuffer == nullptr) return;
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = storageBuffer->getHandle();
+    bufferInfo.offset = 0;
+    bufferInfo.range = storageBuffer->getSize();
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = meshDescriptorSets[frame];
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(meshManager_logicalDevice, 1, &write, 0, nullptr);
+    descriptorVersion++;
+}
+
 // == MATERIAL DESCRIPTOR SET UP == 
 void MeshManager::createMaterialDescriptors(VkDescriptorPool descriptorPool, Capabilities &deviceCaps) {
     std::cout << " ===> Creating material descriptor set layout <=== " << std::endl;
     std::cout << " - with bindless? " << deviceCaps.supportsDescriptorIndexing;
 
     //Determine whether to use bindless or individual texture samplers based on device caps
+    deviceSupportsBindless = deviceCaps.supportsDescriptorIndexing;
+
     if (deviceCaps.supportsDescriptorIndexing) {
         std::cout << "    with bindless indexing!" << std::endl;
 
@@ -559,6 +806,7 @@ void MeshManager::createMaterialDescriptors(VkDescriptorPool descriptorPool, Cap
 
         for (const auto& [name, material] : materials) {
             std::shared_ptr<Image> albedo = material->getTextureImage();
+            material->setTextureSlot(static_cast<uint32_t>(views.size()));
             views.push_back(albedo->getImageDetails().imageView);
             samplers.push_back(albedo->getSampler());
         }
@@ -622,6 +870,81 @@ void MeshManager::createMaterialDescriptors(VkDescriptorPool descriptorPool, Cap
             material->setDescriptorSets(matSets);
         }
     }
+
+    descriptorVersion++;
+}
+
+// == TEXTURE RESIDENCY ==
+void MeshManager::markMaterialUsed(const Material* material, uint64_t frameNumber) {
+    if (meshManager_imageManager && material) {
+        meshManager_imageManager->markUsed(material->getTextureHandle(), frameNumber);
+    }
+}
+
+void MeshManager::updateTextureResidency(uint32_t currentFrame, uint64_t frameNumber, VkCommandPool commandPool, LinearArena& frameArena) {
+    if (!meshManager_imageManager) return;
+
+    ArenaVector<ImageHandle> changed = meshManager_imageManager->updateResidency(frameNumber, commandPool, frameArena);
+
+    for (const auto& handle : changed) {
+        for (const auto& [name, material] : materials) {
+            if (material->getTextureHandle() == handle) {
+                material->markTextureDirty();
+            }
+        }
+    }
+
+    //Only this frame's sets are safe to touch -> its previous submit has retired, the other frames catch up on their turn
+    for (const auto& [name, material] : materials) {
+        if (material->isTextureDirty(currentFrame)) {
+            writeMaterialTexture(material, currentFrame);
+            material->clearTextureDirty(currentFrame);
+        }
+    }
+}
+
+void MeshManager::writeMaterialTexture(const std::shared_ptr<Material>& material, uint32_t currentFrame) {
+    Image* texture = material->getTextureImage().get();
+    if (texture == nullptr || texture->getResidency() != TextureResidency::RESIDENT) {
+        texture = meshManager_imageManager->getFallbackTexture();
+    }
+    if (texture == nullptr) return;
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = texture->getImageDetails().imageView;
+    imageInfo.sampler = texture->getSampler();
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+
+    if (deviceSupportsBindless) {
+        if (currentFrame >= materialDescriptorSets.size()) return;
+        write.dstSet = materialDescriptorSets[currentFrame];
+        write.dstArrayElement = material->getTextureSlot();
+    } else {
+        const std::vector<VkDescriptorSet>& sets = material->getDescriptorSets();
+        if (currentFrame >= sets.size()) return;
+        write.dstSet = sets[currentFrame];
+    }
+
+    vkUpdateDescriptorSets(meshManager_logicalDevice, 1, &write, 0, nullptr);
+    descriptorVersion++;
+}
+
+const glm::mat4* MeshManager::getFrameModelMatrices(uint32_t frame, size_t& count) const {
+    count = 0;
+    if (frame >= storageBufferHandles.size() || mappedStorageBufferPtrs[frame] == nullptr) return nullptr;
+
+    Buffer* storageBuffer = meshManager_bufferManager->getBuffer(storageBufferHandles[frame]);
+    if (storageBuffer == nullptr) return nullptr;
+
+    count = std::min<size_t>(modelMatrices.size(), storageBuffer->getSize() / sizeof(glm::mat4));
+    return static_cast<const glm::mat4*>(mappedStorageBufferPtrs[frame]);
 }
 
 // == ACTUAL GRAPHICAL OUTPUT SHIT == 
@@ -0,0 +1,90 @@
+#include "../include/Managers/StagingRing.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	if (alignment <= 1) return value;
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void StagingRing::init(VkBuffer buffer, void* mappedPtr, VkDeviceSize ringCapacity) {
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	ringBuffer = buffer;
+	ringMappedPtr = static_cast<char*>(mappedPtr);
+	capacity = ringCapacity;
+	head = 0;
+	entries.clear();
+}
+
+// Live slices always sit between the oldest entry(tail) and head, possibly wrapping past the end of the buffer
+std::optional<StagingAllocation> StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	size = std::max<VkDeviceSize>(size, 1);
+	if (ringBuffer == VK_NULL_HANDLE || size > capacity) return std::nullopt;
+
+	VkDeviceSize begin = 0;
+	if (entries.empty()) {
+		//Nothing in flight -> start over at the beginning of the buffer
+		head = 0;
+		begin = 0;
+	}
+	else {
+		VkDeviceSize tail = entries.front().begin;
+		begin = alignUp(head, alignment);
+
+		if (head > tail) {
+			//Free space is [head, capacity) and [0, tail)
+			if (begin + size > capacity) {
+				if (size > tail) return std::nullopt;
+				begin = 0;
+			}
+		}
+		else {
+			//Already wrapped, free space is [head, tail)
+			if (begin + size > tail) return std::nullopt;
+		}
+	}
+
+	RingEntry entry{};
+	entry.begin = begin;
+	entry.end = begin + size;
+	entries.push_back(entry);
+	head = entry.end;
+
+	StagingAllocation allocation{};
+	allocation.buffer = ringBuffer;
+	allocation.offset = begin;
+	allocation.size = size;
+	allocation.mappedPtr = ringMappedPtr + begin;
+	return allocation;
+}
+
+void StagingRing::markSubmitted(uint64_t fenceValue) {
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	for (auto it = entries.rbegin(); it != entries.rend() && it->fenceValue == 0; ++it) {
+		it->fenceValue = fenceValue;
+	}
+}
+
+void StagingRing::reclaim(uint64_t completedFenceValue) {
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	while (!entries.empty() && entries.front().fenceValue != 0 && entries.front().fenceValue <= completedFenceValue) {
+		entries.pop_front();
+	}
+}
+
+bool StagingRing::hasUnsubmitted() const {
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return !entries.empty() && entries.back().fenceValue == 0;
+}
+
+VkDeviceSize StagingRing::getBytesInFlight() const {
+	std::lock_guard<std::mutex> lock(ringMutex);
+
+	if (entries.empty()) return 0;
+
+	VkDeviceSize tail = entries.front().begin;
+	return head > tail ? head - tail : capacity - tail + head;
+}
@@ -1,5 +1,6 @@
 #include "../include/System_Components/Renderer.h"
 #include "../include/External/tiny_obj_loader.h"
+#include "../include/External/stb_image_write.h"
 #include "../include/System_Components/IO.h"
 #include "../include/System_Components/GUI.h"
 
@@ -15,13 +16,17 @@
 #include "../include/Managers/BufferManager.h"
 #include "../include/Managers/DescriptorManager.h"
 #include "../include/Managers/ImageManager.h"
+#include "../include/Managers/MemoryAllocator.h"
 #include "../include/Utils/ThreadPool.h"
 #include "../include/Managers/DebugManager.h"
+#include "../include/Managers/Defragmenter.h"
 
 //Resources
 #include "../include/Managers/Buffer.h"
 #include "../include/Managers/Image.h"
 
+#include <filesystem>
+
 //Other systems
 #include "../include/System_Components/ECS.h"
 #include "../include/System_Components/Camera.h"
@@ -34,6 +39,7 @@ void Renderer::createRenderer() {
     initDevices();
 
     //GPU resource managers
+    initMemoryAllocator();
     initBufferManager();
     initImageManager();
     initUniformBuffer();
@@ -51,8 +57,18 @@ void Renderer::createRenderer() {
     initSyncObjects();
 };
 
+void Renderer::setHeadless(const HeadlessSettings& settings) {
+    headless = true;
+    headlessSettings = settings;
+}
+
 //Runs the draw loop
 void Renderer::draw() {
+    if (headless) {
+        drawHeadless();
+        return;
+    }
+
     //Keep track of current frame
     std::cout << "Entering draw loop: " << std::endl;
 
@@ -95,6 +111,103 @@ void Renderer::draw() {
     }
 }
 
+//Renders the configured number of frames without a window, then logs where the CPU time went
+const DrawStats& Renderer::getLastDrawStats() const {
+    return graphicsPipeline->getLastDrawStats();
+}
+
+void Renderer::drawHeadless() {
+    const uint32_t frameCount = headlessSettings.frameCount;
+    std::cout << "Entering headless draw loop: " << frameCount << " frames at "
+        << headlessSettings.width << "x" << headlessSettings.height << std::endl;
+
+    if (headlessSettings.dumpInterval > 0) {
+        std::filesystem::create_directories(headlessSettings.dumpDirectory);
+    }
+
+    std::vector<double> cpuTimes;
+    std::vector<double> waitTimes;
+    cpuTimes.reserve(frameCount);
+    waitTimes.reserve(frameCount);
+    uint32_t reusedFrames = 0;
+
+    auto runStart = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        checkMaterialQueue();
+        checkMeshQueue();
+
+        FrameTiming timing{};
+        uint32_t imageIndex = graphicsPipeline->drawHeadless(
+            descriptorManager,
+            bufferManager,
+            meshManager,
+            gui,
+            renderTargeter,
+            timing
+        );
+
+        cpuTimes.push_back(timing.cpuMs);
+        waitTimes.push_back(timing.fenceWaitMs);
+        if (timing.commandBufferReused) reusedFrames++;
+
+        //Outside the timed part, but the readback drains the queue -> the next frame's fence wait comes out shorter
+        if (headlessSettings.dumpInterval > 0 && frame % headlessSettings.dumpInterval == 0) {
+            dumpFrame(imageIndex, frame);
+        }
+    }
+
+    //Last frames still in flight count towards the wall time
+    vkDeviceWaitIdle(devices->getLogicalDevice());
+    auto runEnd = std::chrono::high_resolution_clock::now();
+
+    if (frameCount == 0) return;
+
+    double wallMs = std::chrono::duration<double, std::milli>(runEnd - runStart).count();
+    const DrawStats& drawStats = getLastDrawStats();
+
+    std::vector<double> sorted = cpuTimes;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5))];
+    };
+
+    double cpuTotal = 0.0;
+    for (double ms : cpuTimes) cpuTotal += ms;
+    double waitTotal = 0.0;
+    for (double ms : waitTimes) waitTotal += ms;
+
+    std::cout << "[Renderer] Headless: " << frameCount << " frames at " << headlessSettings.width << "x" << headlessSettings.height << "\n"
+        << "  cpu: avg " << cpuTotal / frameCount << " ms, min " << sorted.front() << " ms, p50 " << percentile(0.5)
+        << " ms, p95 " << percentile(0.95) << " ms, max " << sorted.back() << " ms\n"
+        << "  fence wait: avg " << waitTotal / frameCount << " ms\n"
+        << "  wall: " << wallMs << " ms (" << (wallMs > 0.0 ? frameCount * 1000.0 / wallMs : 0.0) << " fps)\n"
+        << "  command buffers reused: " << reusedFrames << "/" << frameCount << "\n"
+        << "  last frame: " << drawStats.draws << " draws, " << drawStats.pipelineBinds << " pipeline binds (saved "
+        << drawStats.getPipelineBindsSaved() << "), " << drawStats.materialBinds << " material binds (saved "
+        << drawStats.getMaterialBindsSaved() << ")" << std::endl;
+}
+
+//Writes the image `frame` rendered into as <dumpDirectory>/frame_<frame>.png
+void Renderer::dumpFrame(uint32_t imageIndex, uint32_t frame) {
+    std::vector<uint8_t> pixels;
+    graphicsPipeline->readbackImage(imageIndex, bufferManager, renderTargeter, pixels);
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "frame_%05u.png", frame);
+    std::string path = (std::filesystem::path(headlessSettings.dumpDirectory) / fileName).string();
+
+    VkExtent2D extent = renderTargeter->getRenderTarget().extent;
+    int width = static_cast<int>(extent.width);
+    int height = static_cast<int>(extent.height);
+
+    if (stbi_write_png(path.c_str(), width, height, 4, pixels.data(), width * 4) == 0) {
+        std::cerr << "[Renderer] Failed to write frame [" << path << "]" << std::endl;
+    } else {
+        std::cout << "[Renderer] Wrote frame [" << path << "]" << std::endl;
+    }
+}
+
 // ================================
 //    INITIALIZATION FUNCTIONS
 // ================================
@@ -109,14 +222,19 @@ void Renderer::initInstance() {
     //   -> DEBUG MESSENGER
     //   -> SURFACE
     debugManager = std::make_shared<DebugManager>();
-    instance = std::make_shared <VulkanInstance>(debugManager);
+    instance = std::make_shared <VulkanInstance>(debugManager, headless);
     instance->createInstance();
     debugManager->setupDebugMessenger(instance->getInstance());
-    instance->createSurface();
 
     // == CREATE IO == 
     io = std::make_shared<IO>(camera);
     io->setStandardBinds();
+
+    //No window -> no surface, and no input to poll
+    if (headless) return;
+
+    instance->createSurface();
+
     glfwSetKeyCallback(instance->getWindowPtr(), IO::keyCallback);
     glfwSetCursorPosCallback(instance->getWindowPtr(), IO::mouseCallback);
 
@@ -131,12 +249,34 @@ void Renderer::initDevices() {
 // ================================
 //      GPU RESOURCE MANAGERS INIT
 // ================================
+void Renderer::initMemoryAllocator() {
+    memoryAllocator = std::make_shared<MemoryAllocator>(
+        devices->getLogicalDevice(),
+        devices->getPhysicalDevice()
+    );
+    memoryAllocator->setMemoryBudgetSupported(devices->getDeviceCaps().supportsMemoryBudget);
+    memoryAllocator->setBufferDeviceAddressEnabled(devices->getDeviceCaps().supportsBufferDeviceAddress);
+}
+
 void Renderer::initBufferManager() {
     bufferManager = std::make_shared<BufferManager>(
         devices->getLogicalDevice(),
         devices->getPhysicalDevice(),
-        devices->getGraphicsQueue()
+        devices->getGraphicsQueue(),
+        memoryAllocator
     );
+
+    //Geometry and per object buffers get a device address when the allocator was set up for it
+    bufferManager->setBufferDeviceAddressEnabled(memoryAllocator->isBufferDeviceAddressEnabled());
+
+    if (devices->hasDedicatedTransferQueue()) {
+        QueueFamilyIndices queueFamilies = devices->getQueueFamilies();
+        bufferManager->setTransferQueue(
+            devices->getTransferQueue(),
+            queueFamilies.transferFamily.value(),
+            queueFamilies.graphicsFamily.value()
+        );
+    }
 }
 
 void Renderer::initImageManager() {
@@ -144,8 +284,11 @@ void Renderer::initImageManager() {
     imageManager = std::make_shared<ImageManager>(
         devices->getLogicalDevice(),
         devices->getPhysicalDevice(),
-        bufferManager
+        bufferManager,
+        memoryAllocator
     );
+
+    defragmenter = std::make_shared<Defragmenter>(memoryAllocator, bufferManager, imageManager);
 }
 
 void Renderer::initUniformBuffer() {
@@ -165,15 +308,24 @@ void Renderer::initUniformBuffer() {
 void Renderer::createRenderTargetResources() {
     std::cout << "Entering createRenderTargetResources()" << std::endl;
 
-    renderTargeter = std::make_shared<RenderTargeter>(instance, devices);
+    renderTargeter = std::make_shared<RenderTargeter>(instance, devices, memoryAllocator);
 
     //Get extent and format
-    renderTargeter->getFramebufferDetails();
+    if (headless) {
+        renderTargeter->setHeadlessDetails({ headlessSettings.width, headlessSettings.height });
+    } else {
+        renderTargeter->getFramebufferDetails();
+    }
 }
 
 void Renderer::initRenderpassAndCommandPool() {
     std::cout << "Entering initRenderpassAndCommandPool()" << std::endl;
     graphicsPipeline = std::make_shared<GraphicsPipeline>(instance, devices);
+    graphicsPipeline->setDefragmenter(defragmenter);
+
+    //Shared with the mesh/material queues -> also compiles pipeline permutations off the render thread
+    threadPool = std::make_shared<ThreadPool>(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    graphicsPipeline->setThreadPool(threadPool);
 
     renderTargeter->createMainRenderpass(inGame);
     if (!inGame) {
@@ -192,6 +344,18 @@ void Renderer::initFramebuffers() {
     //Create depth image
     renderTargeter->createDepthImage();
 
+    if (headless) {
+        //Stands in for the swapchain, one image per frame in flight
+        renderTargeter->createHeadlessResources(MAX_FRAMES_IN_FLIGHT);
+        renderTargeter->createFramebuffers(
+            renderTargeter->getMainPass(),
+            false
+        );
+
+        //Nothing to resize
+        return;
+    }
+
     if (inGame) {
         std::cout << "Creating SWAPCHAIN <====" << std::endl;
         //Create swapchain 
@@ -249,7 +413,7 @@ void Renderer::linkImGui() {
     gui = std::make_shared<GUI>();
 
     //[TESTING: THIS SHOULD BE SET FALSE, GUI WILL OVERLAY OTHERWISE]
-    if (inGame) {
+    if (inGame && !headless) {
         gui->linkToApp(
             inGame,
             instance->getWindowPtr(),
@@ -269,7 +433,7 @@ void Renderer::linkImGui() {
 void Renderer::initCommandBuffers() {
     std::cout << "Entering initCommandBuffers" << std::endl;
 
-    meshManager = std::make_shared<MeshManager>(devices->getLogicalDevice(), devices->getPhysicalDevice(), bufferManager);
+    meshManager = std::make_shared<MeshManager>(devices->getLogicalDevice(), devices->getPhysicalDevice(), bufferManager, imageManager);
 
     //Creates meshes and materials
     createMeshesAndMaterials();
@@ -290,6 +454,7 @@ void Renderer::initCommandBuffers() {
     };
 
     graphicsPipeline->createGraphicsPipeline(renderTargeter, setLayouts);
+    graphicsPipeline->preparePipelines(meshManager);
 
     graphicsPipeline->createCommandBuffer();
 };
@@ -329,128 +494,20 @@ void Renderer::createMeshesAndMaterials() {
     meshManager->createStorageBuffers();
 };
 
-//Creates a vertex buffer and index buffer for each mesh
+//Packs every primitive into the shared geometry buffers
 void Renderer::loadMeshesToVertexBufferManager() {
     std::cout << "Entered [loadMeshesToVertexBufferManager]" << std::endl;
-    
-    for (const auto& [pipelineKey, primitives] : meshManager->getPrimitiveByPipelineKey()) {
-        std::cout << "Load a total of " << meshManager->getAllMeshes().size() << "meshes" << std::endl;
-
-        for (const auto& primitive : primitives) {
-            const int primitiveIndex = primitive->getPrimitiveIndex();
-
-
-            std::vector<Vertex> vertices = primitive->getVertices();
-            std::vector<uint32_t> indices = primitive->getIndices();
-            VkDeviceSize verticesSize = sizeof(vertices[0]) * vertices.size();
-            VkDeviceSize indicesSize = sizeof(indices[0]) * indices.size();
-
-            //Create staging buffer for vertex buffer
-            bufferManager->createBuffer(
-                BufferType::VERTEX_STAGING,
-                "v_staging_prim" + std::to_string(primitiveIndex),
-                verticesSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                vertices
-            );
-
-            std::shared_ptr<Buffer> vertexStagingBuffer = bufferManager->getBuffer("v_staging_prim" + std::to_string(primitiveIndex));
-
-            if (!vertexStagingBuffer) {
-                std::cerr << "Error: Staging buffer creation failed for primitive : " << std::to_string(primitiveIndex);
-                continue; //Skip if staging buffer creation failed
-            }
-
-            //Create actual vbuf
-            bufferManager->createBuffer(
-                BufferType::VERTEX,
-                "vbuf" + std::to_string(primitiveIndex),
-                verticesSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                vertices
-            );
+    std::cout << "Load a total of " << meshManager->getAllMeshes().size() << "meshes" << std::endl;
 
-            std::shared_ptr<Buffer> vertexBuffer = bufferManager->getBuffer("vbuf" + std::to_string(primitiveIndex));
-
-            if (!vertexBuffer) {
-                std::cerr << "Error: Vertex buffer creation failed for mesh: " << "vbuf" + std::to_string(primitiveIndex) << std::endl;
-                continue; // Skip this mesh if the vertex buffer creation failed
-            }
-
-            //Check for errors
-            if (vertexStagingBuffer && vertexStagingBuffer->hasErrors()) {
-                vertexStagingBuffer->printErrors();
-            }
-
-            if (vertexBuffer && vertexBuffer->hasErrors()) {
-                vertexBuffer->printErrors();
-            }
-
-            //Copy data from staging buffer to vertex buffer
-            if (vertexStagingBuffer && vertexBuffer) {
-                bufferManager->copyBuffer(vertexStagingBuffer, vertexBuffer, verticesSize, graphicsPipeline->getCommandPool());
-            };
-
-            //Now we delete the staging buffer
-            vertexStagingBuffer->cleanup();
-            if (vertexStagingBuffer->getHandle() == VK_NULL_HANDLE) {
-                bufferManager->removeBufferByName("v_staging_prim" + std::to_string(primitiveIndex));
-            }
-            else {
-                std::cout << "**UNABLE TO RESET VERTEX STAGING BUFFER POINTER" << std::endl;
-            };
-
-            // Now repeat for ibuf
-            bufferManager->createBuffer(
-                BufferType::INDEX_STAGING,
-                "i_staging_prim" + std::to_string(primitiveIndex),
-                indicesSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                std::nullopt,
-                indices
-            );
+    for (const auto& primitive : meshManager->getAllPrimitives()) {
+        meshManager->uploadPrimitiveGeometry(primitive, graphicsPipeline->getCommandPool());
+    }
 
-            std::shared_ptr<Buffer> indexStagingBuffer = bufferManager->getBuffer("i_staging_prim" + std::to_string(primitiveIndex));
+    //Every primitive goes out in one submit, the first frame is queued behind it
+    UploadToken uploadToken = bufferManager->flushUploads();
+    std::cout << "Submitted geometry uploads with token : " << uploadToken.value << std::endl;
 
-            bufferManager->createBuffer(
-                BufferType::INDEX,
-                "ibuf" + std::to_string(primitiveIndex),
-                indicesSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                std::nullopt,
-                indices
-            );
-
-            std::shared_ptr<Buffer> indexBuffer = bufferManager->getBuffer("ibuf" + std::to_string(primitiveIndex));
-
-            //Check for errors
-            if (indexStagingBuffer && indexStagingBuffer->hasErrors()) {
-                indexStagingBuffer->printErrors();
-            }
-
-            if (indexBuffer && indexBuffer->hasErrors()) {
-                indexBuffer->printErrors();
-            }
-
-            //Copy data from staging buffer to vertex buffer
-            if (indexStagingBuffer && indexBuffer) {
-                bufferManager->copyBuffer(indexStagingBuffer, indexBuffer, indicesSize, graphicsPipeline->getCommandPool());
-            };
-
-            //Delete index staging buffer
-            indexStagingBuffer->cleanup();
-            if (indexStagingBuffer->getHandle() == VK_NULL_HANDLE) {
-                bufferManager->removeBufferByName("i_staging_prim" + std::to_string(primitiveIndex));
-            }
-            else {
-                std::cout << "**UNABLE TO RESET INDEX STAGING BUFFER TO NULLPTR" << std::endl;
-            };
-        }
-    }
+    meshManager->getGeometryBuffer()->printStats();
 };
 
 void Renderer::createDescriptorResources() {
@@ -483,6 +540,11 @@ void Renderer::cleanup() {
     renderTargeter->cleanup(true);
     renderTargeter.reset();
 
+    //All buffers and images are gone, release the memory blocks
+    memoryAllocator->printStats();
+    memoryAllocator->cleanup();
+    memoryAllocator.reset();
+
     swapchainRecreater.reset();
 
     devices->cleanup();
@@ -498,14 +560,14 @@ void Renderer::createMaterial(std::string materialName, std::string pathToImage)
 
     std::cout << "[CREATING IMAGE FOR MATERIAL] : " << imageName << std::endl;
 
-    imageManager->createTextureImage(imageName, pathToImage, graphicsPipeline->getCommandPool());
+    ImageHandle texHandle = imageManager->createTextureImage(imageName, pathToImage, graphicsPipeline->getCommandPool());
     std::shared_ptr<Image> texImage1 = imageManager->getImage(imageName);
 
     std::cout << "Found image << " << texImage1->getImageDetails().imageFormat << std::endl;
 
     std::cout << "Properly Created Image for material : [" << materialName << "]" << std::endl;
 
-    meshManager->createMaterial(materialName, texImage1);
+    meshManager->createMaterial(materialName, texImage1, texHandle);
 }
 
 //Prefab objects are passed in with "pf" prefix: ex: "pf_Cube"
@@ -572,6 +634,16 @@ void Renderer::createMesh(std::string meshName, std::string materialName, std::s
     }
 }
 
+void Renderer::createMeshInstance(std::string instanceName, std::string sourceMeshName, glm::mat4 transform) {
+    if (meshManager->createMeshInstance(instanceName, sourceMeshName, transform) < 0) {
+        std::cerr << "Failed to create mesh instance : [" << instanceName << "]" << std::endl;
+    }
+}
+
+void Renderer::setMeshInstanceTransform(std::string instanceName, glm::mat4 transform) {
+    meshManager->setMeshInstanceTransform(instanceName, transform);
+}
+
 // ======================================
 // IN-FLIGHT MATERIAL/MESH QUEUE HANDLING
 // ====================================== 
@@ -615,8 +687,13 @@ void Renderer::checkMaterialQueue() {
     }
 }
 
+void Renderer::defragmentMemory(float maxBlockUsage) {
+    defragmenter->begin(maxBlockUsage);
+}
+
 //Cleans up user allocated resources, like buffers and images - then signals to destroy managers and core components
 void Renderer::cleanupResources() {
+    defragmenter->cleanup();
     descriptorManager->cleanup();
     imageManager->cleanup();
     bufferManager->cleanup();
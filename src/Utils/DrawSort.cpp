@@ -0,0 +1,82 @@
+#include "../include/Utils/DrawSort.h"
+
+namespace DrawSort {
+
+uint16_t quantizeDepth(float depth) {
+	//Positive floats order the same as their bit patterns -> keep sign, exponent and 7 mantissa bits
+	depth = std::max(depth, 0.0f);
+	uint32_t bits = 0;
+	memcpy(&bits, &depth, sizeof(bits));
+	return static_cast<uint16_t>(bits >> 16);
+}
+
+uint8_t quantizeDepthCoarse(float depth) {
+	depth = std::clamp(depth, 1.0f / 16.0f, 4095.0f);
+	uint32_t bits = 0;
+	memcpy(&bits, &depth, sizeof(bits));
+
+	//Biased exponent 123..138 -> 0..15, followed by the top 4 mantissa bits
+	const uint32_t exponent = ((bits >> 23) & 0xFFu) - 123u;
+	const uint32_t mantissa = (bits >> 19) & 0xFu;
+	return static_cast<uint8_t>((exponent << 4) | mantissa);
+}
+
+uint64_t makeKey(Pass pass, uint32_t pipelineKey, uint32_t materialID, uint32_t primitiveID, float depth) {
+	const uint64_t pipeline = pipelineKey & 0x0FFFFFFFu;
+
+	if (pass == PASS_BLENDED) {
+		//Inverted -> farthest first
+		const uint64_t material = materialID & 0x3FFFFu;
+		const uint64_t farFirst = 0xFFFFu - quantizeDepth(depth);
+		return (static_cast<uint64_t>(pass) << 62) | (farFirst << 46) | (pipeline << 18) | material;
+	}
+
+	const uint64_t material = materialID & 0x3FFFu;
+	const uint64_t primitive = primitiveID & 0xFFFu;
+	const uint64_t quantized = quantizeDepthCoarse(depth);
+	return (static_cast<uint64_t>(pass) << 62) | (pipeline << 34) | (material << 20) | (primitive << 8) | quantized;
+}
+
+void radixSort(DrawSortEntry* entries, size_t count, LinearArena& arena) {
+	if (count < 2) return;
+
+	//All 8 histograms in one read of the keys
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = entries[i].key;
+		for (int digit = 0; digit < 8; digit++) {
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	DrawSortEntry* scratch = arena.allocateArray<DrawSortEntry>(count);
+	DrawSortEntry* source = entries;
+	DrawSortEntry* destination = scratch;
+
+	for (int digit = 0; digit < 8; digit++) {
+		uint32_t* histogram = histograms[digit];
+
+		//Every key has the same byte here -> the pass wouldn't move anything
+		if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count) continue;
+
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			destination[histogram[(source[i].key >> (digit * 8)) & 0xFF]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	//Odd number of passes ran -> the result sits in the scratch array
+	if (source != entries) {
+		memcpy(entries, source, sizeof(DrawSortEntry) * count);
+	}
+}
+
+}
@@ -0,0 +1,214 @@
+#include "../include/Utils/FrustumCulling.h"
+
+#include <random>
+
+//MSVC only defines __AVX2__(/arch:AVX2), SSE2 is implied by x64
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define XENON_CULL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define XENON_CULL_SSE
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+	//glm is column major -> row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::mat4 m = glm::transpose(viewProjection);
+
+	Frustum frustum{};
+	frustum.planes[0] = m[3] + m[0]; // left
+	frustum.planes[1] = m[3] - m[0]; // right
+	frustum.planes[2] = m[3] + m[1]; // bottom
+	frustum.planes[3] = m[3] - m[1]; // top
+	frustum.planes[4] = m[2];        // near
+	frustum.planes[5] = m[3] - m[2]; // far
+
+	for (glm::vec4& plane : frustum.planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) plane /= length;
+	}
+
+	return frustum;
+}
+
+size_t BoundsSoA::push(const glm::vec4& sphere, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	centerX.push_back(sphere.x);
+	centerY.push_back(sphere.y);
+	centerZ.push_back(sphere.z);
+	radius.push_back(sphere.w);
+
+	minX.push_back(boundsMin.x);
+	minY.push_back(boundsMin.y);
+	minZ.push_back(boundsMin.z);
+	maxX.push_back(boundsMax.x);
+	maxY.push_back(boundsMax.y);
+	maxZ.push_back(boundsMax.z);
+
+	return radius.size() - 1;
+}
+
+void BoundsSoA::clear() {
+	for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+		component->clear();
+	}
+}
+
+namespace FrustumCulling {
+
+const char* getKernelName() {
+#if defined(XENON_CULL_AVX2)
+	return "AVX2";
+#elif defined(XENON_CULL_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+void cullSpheresScalar(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+	const float* radius, size_t count, uint8_t* visible) {
+	for (size_t i = 0; i < count; i++) {
+		bool inside = true;
+
+		for (const glm::vec4& plane : frustum.planes) {
+			//Same summation order as the SIMD kernels -> both agree on spheres touching a plane
+			float distance = (plane.x * centerX[i] + plane.y * centerY[i]) + (plane.z * centerZ[i] + plane.w);
+			if (distance < -radius[i]) {
+				inside = false;
+				break;
+			}
+		}
+
+		visible[i] = inside ? 1 : 0;
+	}
+}
+
+void cullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+	const float* radius, size_t count, uint8_t* visible) {
+	size_t i = 0;
+
+#if defined(XENON_CULL_AVX2)
+	//Plane components splatted once, each iteration tests 8 spheres against all 6 planes without branching
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(centerX + i);
+		__m256 y = _mm256_loadu_ps(centerY + i);
+		__m256 z = _mm256_loadu_ps(centerZ + i);
+		__m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(radius + i), signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++) {
+			visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+		}
+	}
+#elif defined(XENON_CULL_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	//Two groups of 4 per iteration -> same 8 objects per step as the AVX2 kernel
+	for (; i + 8 <= count; i += 8) {
+		int mask = 0;
+
+		for (size_t half = 0; half < 8; half += 4) {
+			__m128 x = _mm_loadu_ps(centerX + i + half);
+			__m128 y = _mm_loadu_ps(centerY + i + half);
+			__m128 z = _mm_loadu_ps(centerZ + i + half);
+			__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(radius + i + half), signMask);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+
+			mask |= _mm_movemask_ps(inside) << half;
+		}
+
+		for (int lane = 0; lane < 8; lane++) {
+			visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+		}
+	}
+#endif
+
+	//Tail(or everything without SIMD)
+	cullSpheresScalar(frustum, centerX + i, centerY + i, centerZ + i, radius + i, count - i, visible + i);
+}
+
+CullBenchmarkResult benchmarkFrustumCulling(size_t objectCount, uint32_t iterations) {
+	CullBenchmarkResult result{};
+	result.objectCount = objectCount;
+	result.iterations = std::max(iterations, 1u);
+
+	//Camera at the origin looking down -Z, objects spread around it so roughly a quarter ends up visible
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromMatrix(proj * view);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+	BoundsSoA bounds;
+	for (size_t i = 0; i < objectCount; i++) {
+		glm::vec3 center(position(rng), position(rng), position(rng));
+		float radius = size(rng);
+		bounds.push(glm::vec4(center, radius), center - glm::vec3(radius), center + glm::vec3(radius));
+	}
+
+	std::vector<uint8_t> scalarVisible(objectCount);
+	std::vector<uint8_t> simdVisible(objectCount);
+
+	auto scalarStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < result.iterations; i++) {
+		cullSpheresScalar(frustum, bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data(),
+			bounds.radius.data(), objectCount, scalarVisible.data());
+	}
+	auto scalarEnd = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < result.iterations; i++) {
+		cullSpheres(frustum, bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data(),
+			bounds.radius.data(), objectCount, simdVisible.data());
+	}
+	auto simdEnd = std::chrono::high_resolution_clock::now();
+
+	result.scalarMs = std::chrono::duration<double, std::milli>(scalarEnd - scalarStart).count() / result.iterations;
+	result.simdMs = std::chrono::duration<double, std::milli>(simdEnd - scalarEnd).count() / result.iterations;
+	result.resultsMatch = scalarVisible == simdVisible;
+	result.visibleCount = static_cast<size_t>(std::count(simdVisible.begin(), simdVisible.end(), uint8_t(1)));
+
+	std::cout << "[FrustumCulling] Benchmark: " << objectCount << " spheres x " << result.iterations << " iterations\n"
+		<< "  scalar: " << result.scalarMs << " ms\n"
+		<< "  " << getKernelName() << ": " << result.simdMs << " ms"
+		<< " (x" << (result.simdMs > 0.0 ? result.scalarMs / result.simdMs : 0.0) << ")\n"
+		<< "  visible: " << result.visibleCount << ", kernels match: " << (result.resultsMatch ? "yes" : "NO") << std::endl;
+
+	return result;
+}
+
+}
@@ -0,0 +1,90 @@
+#include "../include/Utils/LinearArena.h"
+
+static size_t alignOffset(size_t offset, size_t alignment) {
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t initialCapacity) {
+	addChunk(std::max<size_t>(initialCapacity, 1024));
+}
+
+void LinearArena::addChunk(size_t minSize) {
+	//Grow geometrically so a frame that keeps outgrowing the arena only adds a handful of chunks
+	size_t size = chunks.empty() ? minSize : std::max(minSize, chunks.back().size * 2);
+
+	Chunk chunk{};
+	chunk.memory = std::make_unique<char[]>(size);
+	chunk.size = size;
+	chunks.push_back(std::move(chunk));
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+	size = std::max<size_t>(size, 1);
+
+	while (true) {
+		Chunk& chunk = chunks[currentChunk];
+
+		//Align the address, not the offset -> chunk memory is only guaranteed to be max_align_t aligned
+		uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memory.get());
+		size_t begin = alignOffset(base + chunk.offset, alignment) - base;
+
+		if (begin + size <= chunk.size) {
+			chunk.offset = begin + size;
+			return chunk.memory.get() + begin;
+		}
+
+		//Current chunk is full -> move on to the next one, adding it if this is the last
+		if (currentChunk + 1 == chunks.size()) {
+			addChunk(size + alignment);
+		}
+
+		currentChunk++;
+		chunks[currentChunk].offset = 0;
+	}
+}
+
+void LinearArena::reset() {
+	peakBytesUsed = std::max(peakBytesUsed, getBytesUsed());
+
+	//Grew since the last reset -> replace every chunk with one that fits the whole frame
+	if (chunks.size() > 1) {
+		size_t total = getCapacity();
+		chunks.clear();
+		addChunk(total);
+	}
+
+	currentChunk = 0;
+	chunks[0].offset = 0;
+}
+
+void LinearArena::rewind(Marker marker) {
+	peakBytesUsed = std::max(peakBytesUsed, getBytesUsed());
+
+	for (size_t i = marker.chunkIndex + 1; i <= currentChunk && i < chunks.size(); i++) {
+		chunks[i].offset = 0;
+	}
+
+	currentChunk = marker.chunkIndex;
+	chunks[currentChunk].offset = marker.offset;
+}
+
+size_t LinearArena::getCapacity() const {
+	size_t capacity = 0;
+	for (const auto& chunk : chunks) {
+		capacity += chunk.size;
+	}
+	return capacity;
+}
+
+size_t LinearArena::getBytesUsed() const {
+	size_t used = 0;
+	for (size_t i = 0; i <= currentChunk && i < chunks.size(); i++) {
+		used += chunks[i].offset;
+	}
+	return used;
+}
+
+LinearArena& getScratchArena() {
+	thread_local LinearArena scratchArena(256 * 1024);
+	return scratchArena;
+}
@@ -22,4 +22,15 @@ ThreadPool::ThreadPool(size_t numThreads) {
             }
             });
     }
-}
\ No newline at end of file
+}
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        running = false;
+    }
+
+    condition.notify_all();
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
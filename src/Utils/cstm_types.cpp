@@ -45,7 +45,12 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceK
 		};
 
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+		if (surface != VK_NULL_HANDLE) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+		} else {
+			//Headless -> nothing is presented, the graphics family stands in so the present queue stays valid
+			presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
 
 		if (presentSupport) {
 			indices.presentFamily = i;
@@ -58,5 +63,20 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceK
 		i++;
 	};
 
+	//Look for a family that can transfer without graphics -> transfer only families(DMA engines) first, then compute ones
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+		if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+			indices.transferFamily = family;
+			break;
+		}
+
+		if (!indices.transferFamily.has_value()) {
+			indices.transferFamily = family;
+		}
+	};
+
 	return indices;
 };
\ No newline at end of file
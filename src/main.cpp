@@ -1,8 +1,13 @@
 #include "../include/System_Components/Renderer.h"
 #include "../include/System_Components/Physics.h"
+#include "../include/Utils/FrustumCulling.h"
 
 class Application {
-public: void run() {
+public: 
+    //Headless when settings are given -> no window, renders the configured frames and returns
+    explicit Application(std::optional<HeadlessSettings> headless = std::nullopt) : headlessSettings(headless) {};
+
+    void run() {
     init();
     mainLoop();
     cleanup();
@@ -11,9 +16,13 @@ public: void run() {
 private:
     std::shared_ptr<Renderer> renderer;
     std::shared_ptr<Physics> physics; 
+    std::optional<HeadlessSettings> headlessSettings;
 
     void init() {
         renderer = std::make_shared<Renderer>();
+        if (headlessSettings) {
+            renderer->setHeadless(*headlessSettings);
+        }
         renderer->createRenderer();
 
         physics = std::make_shared<Physics>();
@@ -33,14 +42,82 @@ private:
     };
 };
 
-int main() {
-    Application app;
+//Command line options of a headless run(ex. benchmark hosts without a display, on lavapipe):
+//  --headless               render without a window
+//  --frames <n>             frames to render(300)
+//  --size <width>x<height>  resolution(1280x720)
+//  --dump <n> [directory]   write every n-th frame as a PNG(into headless_frames)
+static std::optional<HeadlessSettings> parseHeadlessArgs(int argc, char** argv) {
+    HeadlessSettings settings{};
+    bool headless = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            settings.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--size" && hasValue) {
+            if (sscanf(argv[++i], "%ux%u", &settings.width, &settings.height) != 2 || settings.width == 0 || settings.height == 0) {
+                throw std::invalid_argument("--size expects <width>x<height>");
+            }
+        } else if (arg == "--dump" && hasValue) {
+            settings.dumpInterval = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                settings.dumpDirectory = argv[++i];
+            }
+        } else {
+            std::cerr << "Unknown option : [" << arg << "]" << std::endl;
+        }
+    }
+
+    if (!headless) return std::nullopt;
+    return settings;
+}
+
+//Standalone CPU culling benchmark, no device needed:
+//  --bench-cull [n] [iterations]   scalar vs SIMD kernel on n random spheres(100000 x 100)
+static int runCullBenchmark(int argc, char** argv) {
+    size_t objectCount = 100000;
+    uint32_t iterations = 100;
+
+    try {
+        if (argc > 2) objectCount = static_cast<size_t>(std::stoull(argv[2]));
+        if (argc > 3) iterations = static_cast<uint32_t>(std::stoul(argv[3]));
+    } catch (const std::exception&) {
+        std::cerr << "Invalid arguments: --bench-cull expects [count] [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //A kernel that disagrees with the scalar reference is a failure, not just a slow run
+    CullBenchmarkResult result = FrustumCulling::benchmarkFrustumCulling(objectCount, iterations);
+    return result.resultsMatch ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--bench-cull") {
+        return runCullBenchmark(argc, argv);
+    }
+
+    std::optional<HeadlessSettings> headlessSettings;
+    try {
+        headlessSettings = parseHeadlessArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Application app(headlessSettings);
 
     try {
         app.run();
     } catch (const std::out_of_range& e) {
         std::cerr << "Caught std::out_of_range: " << e.what() << '\n';
     } catch (const std::exception& e) {
+        //Headless runs have no window to notice a failure in -> say why
+        std::cerr << "Fatal: " << e.what() << '\n';
         return EXIT_FAILURE;
     }
 